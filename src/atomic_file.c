@@ -0,0 +1,83 @@
+///@file
+///@brief	Replace files atomically through a temporary file
+///@copyright	Copyright (C) 2026  Andre Colomb
+///
+/// This file is part of elf-mangle.
+///
+/// This file is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU Lesser General Public License as
+/// published by the Free Software Foundation, either version 3 of the
+/// License, or (at your option) any later version.
+///
+/// elf-mangle is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+/// Lesser General Public License for more details.
+///
+/// You should have received a copy of the GNU Lesser General Public
+/// License along with this program.  If not, see
+/// <http://www.gnu.org/licenses/>.
+///
+///@author	Andre Colomb <src@andre.colomb.de>
+
+
+#include "config.h"
+
+#include "atomic_file.h"
+#include "intl.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+
+/// Compile diagnostic output messages?
+#define DEBUG 0
+
+
+
+int
+atomic_file_write(const char *filename, const char *description,
+		  atomic_file_write_f write, const void *arg)
+{
+    static const char temp_suffix[] = ".XXXXXX";
+    char *temp_name;
+    FILE *out = NULL;
+    int fd, status;
+
+    if (! filename || ! description || ! write) return -1;
+
+    temp_name = malloc(strlen(filename) + sizeof(temp_suffix));
+    if (! temp_name) {
+	fprintf(stderr, _("Could not allocate memory for file name: %s\n"), strerror(errno));
+	return -3;
+    }
+    strcpy(temp_name, filename);
+    strcat(temp_name, temp_suffix);
+
+    fd = mkstemp(temp_name);
+    if (fd != -1) {
+	fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	out = fdopen(fd, "wb");
+	if (! out) close(fd);
+    }
+    if (! out) {
+	fprintf(stderr, _("Cannot open %s \"%s\" (%s)\n"), description, filename, strerror(errno));
+	free(temp_name);
+	return -2;
+    }
+
+    status = write(out, arg);
+    if (fclose(out) != 0) status = -2;
+    if (status == 0 && rename(temp_name, filename) != 0) status = -2;
+    if (status != 0) {
+	fprintf(stderr, _("Cannot write %s \"%s\" (%s)\n"), description, filename, strerror(errno));
+	unlink(temp_name);
+    }
+    if (DEBUG) printf("%s: %s (%d)\n", __func__, filename, status);
+
+    free(temp_name);
+    return status;
+}
@@ -0,0 +1,49 @@
+///@file
+///@brief	Replace files atomically through a temporary file
+///@copyright	Copyright (C) 2026  Andre Colomb
+///
+/// This file is part of elf-mangle.
+///
+/// This file is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU Lesser General Public License as
+/// published by the Free Software Foundation, either version 3 of the
+/// License, or (at your option) any later version.
+///
+/// elf-mangle is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+/// Lesser General Public License for more details.
+///
+/// You should have received a copy of the GNU Lesser General Public
+/// License along with this program.  If not, see
+/// <http://www.gnu.org/licenses/>.
+///
+///@author	Andre Colomb <src@andre.colomb.de>
+
+
+#ifndef ATOMIC_FILE_H_
+#define ATOMIC_FILE_H_
+
+#include <stdio.h>
+
+
+///@brief Callback writing the contents of a file
+///@return Zero on success or negative error code
+typedef int (*atomic_file_write_f)(
+    FILE *out,			///< [in] Stream to the temporary file
+    const void *arg		///< [in] Data passed through from atomic_file_write()
+);
+
+///@brief Write a file under a temporary name in the same directory, then rename it
+///@details Readers therefore see either the old or the complete new file,
+///         never a partially written one.  The temporary file is removed
+///         again if anything fails.
+///@return Zero on success or negative error code
+int atomic_file_write(
+    const char *filename,	///< [in] Name of the file to replace
+    const char *description,	///< [in] Kind of file for error messages, translated
+    atomic_file_write_f write,	///< [in] Callback producing the contents
+    const void *arg		///< [in] Data passed to the callback
+);
+
+#endif //ATOMIC_FILE_H_
@@ -228,6 +228,13 @@ static const nvm_field known_fields[] = {
 /// Highest possible index in known field table
 #define NUM_KNOWN_FIELDS	(sizeof(known_fields) / sizeof(*known_fields))
 
+#if HAVE_KNOWN_FIELDS_HASH
+#include "custom_known_fields_hash.h"
+/// Refuse to compile with a perfect hash generated from an outdated table
+typedef char known_fields_hash_current[
+    KNOWN_FIELDS_HASH_SIZE == NUM_KNOWN_FIELDS ? 1 : -1] __attribute__((unused));
+#endif
+
 
 
 int
@@ -241,5 +248,9 @@ known_fields_expected(void)
 const nvm_field*
 find_known_field(const char *symbol)
 {
+#if HAVE_KNOWN_FIELDS_HASH
+    return find_field_hashed(symbol, known_fields, NUM_KNOWN_FIELDS, &known_fields_hash);
+#else
     return find_field(symbol, known_fields, NUM_KNOWN_FIELDS);
+#endif
 }
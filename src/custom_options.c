@@ -79,17 +79,16 @@ static const struct argp_option dummy_options[] =
 
 /// Translate serial number argument to a symbol override
 static inline int
-parse_serial(char **overrides, const char *arg)
+parse_serial(override_list **overrides, const char *arg)
 {
     int serial = 0;
 
     switch (sscanf(arg, "%d", &serial)) {
     case 1:
 	if (serial <= 0 || serial > UINT16_MAX) return -1;
-	*overrides = override_append(*overrides, "nvm_unique=%02x%02x",
-				     (serial >> 0) & 0xFFU,
-				     (serial >> 8) & 0xFFU);
-	return 0;
+	return override_list_add(overrides, "nvm_unique=%02x%02x",
+				 (serial >> 0) & 0xFFU,
+				 (serial >> 8) & 0xFFU);
 
     default:
 	return -1;
@@ -110,6 +109,14 @@ dummy_parse_opt(
     struct tool_config *tool = state->input;
 
     switch (key) {
+    case ARGP_KEY_INIT:
+	// Serial number ranges use the same field and encoding as --set-serial
+	if (! tool->serial.field) {
+	    tool->serial.field = "nvm_unique";
+	    tool->serial.width = 2;
+	}
+	break;
+
     case OPT_SET_SERIAL:
 	if (0 != parse_serial(&tool->overrides, arg)) {
 	    argp_error(state, _("Invalid serial number `%s' specified."), arg);
@@ -109,10 +109,13 @@ crc32(const unsigned char *message, const size_t size,
 
 
 
-/// Recalculate, verify, and optionally update stored CRC value
+///@brief Recalculate, verify, and optionally update stored CRC value
+///@details Images may be post-processed in parallel, so an unusable checksum
+///         field is only reported by the verification and skipped when
+///         updating, without changing the list of post-processors.
 static inline int
 check_crc_symbol(const char* blob, size_t blob_size,
-		 const nvm_symbol *list, const int size,
+		 const nvm_symbol *list, const int size, const symbol_index *index,
 		 int check_only)
 {
     typedef uint32_t nvm_crc_t;
@@ -121,16 +124,15 @@ check_crc_symbol(const char* blob, size_t blob_size,
     nvm_crc_t crc;
     size_t copied;
 
-    target = symbol_list_find_symbol(list, size, crc_symbol);
+    target = symbol_list_find_symbol(index, list, size, crc_symbol);
     if (! target) {
-	fprintf(stderr, _("Checksum field %s not found in map.\n"), crc_symbol);
-	post_process_disable_checksum_update();
+	if (check_only) fprintf(stderr, _("Checksum field %s not found in map.\n"),
+				crc_symbol);
 	return 0;
     }
     if (target->size != sizeof(nvm_crc_t)) {
-	fprintf(stderr, _("Checksum field %s has %zu bytes, expected %zu.\n"),
-		crc_symbol, target->size, sizeof(nvm_crc_t));
-	post_process_disable_checksum_update();
+	if (check_only) fprintf(stderr, _("Checksum field %s has %zu bytes, expected %zu.\n"),
+				crc_symbol, target->size, sizeof(nvm_crc_t));
 	return -1;
     }
 
@@ -174,9 +176,9 @@ check_crc_symbol(const char* blob, size_t blob_size,
 ///@see post_process_f
 static int
 verify_crc(const char* blob, size_t blob_size,
-	   const nvm_symbol *list, const int size)
+	   const nvm_symbol *list, const int size, const symbol_index *index)
 {
-    return check_crc_symbol(blob, blob_size, list, size, 1);
+    return check_crc_symbol(blob, blob_size, list, size, index, 1);
 }
 
 
@@ -185,9 +187,9 @@ verify_crc(const char* blob, size_t blob_size,
 ///@see post_process_f
 static int
 update_crc(const char* blob, size_t blob_size,
-	   const nvm_symbol *list, const int size)
+	   const nvm_symbol *list, const int size, const symbol_index *index)
 {
-    return check_crc_symbol(blob, blob_size, list, size, 0);
+    return check_crc_symbol(blob, blob_size, list, size, index, 0);
 }
 
 
@@ -212,7 +214,8 @@ get_custom_post_processors(void)
 
 
 
-/// Remove the CRC update post-processor from the list of functions to be called
+///@brief Remove the CRC update post-processor from the list of functions to be called
+///@note Only to be used while parsing options, before any image is processed
 void
 post_process_disable_checksum_update(void)
 {
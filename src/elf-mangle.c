@@ -1,6 +1,6 @@
 ///@file
 ///@brief	Main program logic
-///@copyright	Copyright (C) 2014, 2015, 2016, 2022, 2023  Andre Colomb
+///@copyright	Copyright (C) 2014, 2015, 2016, 2022, 2023, 2026  Andre Colomb
 ///
 /// This file is part of elf-mangle, a tool to analyze, transform and
 /// manipulate binary data based on ELF symbol tables.
@@ -27,89 +27,1021 @@
 #include "options.h"
 #include "post_process.h"
 #include "override.h"
+#include "provision.h"
+#include "serial_range.h"
 #include "transform.h"
+#include "image_ihex.h"
 #include "symbol_map.h"
 #include "symbol_list.h"
 #include "known_fields.h"
 #include "field_print.h"
 #include "nvm_field.h"
-#include "gettext.h"
+#include "intl.h"
 
 #include <locale.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <errno.h>
 #include <inttypes.h>
+#if HAVE_PTHREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+/// Compile diagnostic output messages?
+#define DEBUG 0
+
+/// Upper limit for parallel threads processing batch images
+#define MAX_BATCH_THREADS	64
+
+
+
+///@brief Substitute the section name for the placeholder in an image file name
+///@details For serial number templates, %% is reduced to a single percent
+///         sign only here, so it never forms a placeholder.
+///@return Allocated file name (must be free()d) or NULL on error
+static char*
+section_file_name(
+    const char *pattern,	///< [in] File name, possibly with a placeholder
+    const char *section_name,	///< [in] Section name to insert
+    int escaped)		///< [in] Whether %% stands for a literal percent sign
+{
+    const char *p;
+    char *name, *out;
+    int placed = 0;
+
+    // Section names usually start with a dot, skip it in the file name
+    if (*section_name == '.') ++section_name;
+    name = malloc(strlen(pattern) + strlen(section_name) + 1);
+    if (! name) {
+	fprintf(stderr, _("Could not allocate memory for file name: %s\n"), strerror(errno));
+	return NULL;
+    }
+
+    for (p = pattern, out = name; *p; ) {
+	if (! placed && strncmp(p, SECTION_PLACEHOLDER, strlen(SECTION_PLACEHOLDER)) == 0) {
+	    strcpy(out, section_name);
+	    out += strlen(section_name);
+	    p += strlen(SECTION_PLACEHOLDER);
+	    placed = 1;
+	} else {
+	    if (escaped && p[0] == '%' && p[1] == '%') ++p;
+	    *out++ = *p++;
+	}
+    }
+    *out = '\0';
+    return name;
+}
+
+
+
+/// Collect the binary data addresses of all examined sections in a map
+static inline void
+map_blobs(const nvm_symbol_map_source *map, char *blobs[])
+{
+    int section;
+
+    for (section = 0; section < symbol_map_sections(map); ++section) {
+	blobs[section] = symbol_map_blob_address(map, section);
+    }
+}
+
+
+
+///@brief Merge each section's data from an input image file
+///@return Zero on success or negative error code
+static int
+merge_images(
+    const tool_config* restrict config,		///< [in] Application configuration
+    const nvm_symbol_map_source* restrict map,	///< [in] Input map source
+    const nvm_symbol* restrict symbols,		///< [in] Symbol list pointing into the blobs
+    const char* restrict pattern)		///< [in] Image file name, possibly with placeholder
+{
+    int r, section, first, count;
+    char *filename;
+
+    for (section = 0; section < symbol_map_sections(map); ++section) {
+	filename = section_file_name(pattern, symbol_map_section_name(map, section), 0);
+	if (! filename) return -3;
+	count = symbol_map_section_symbols(map, section, &first);
+	r = image_merge_file(filename, symbols + first, count,
+			     symbol_map_blob_size(map, section),
+			     symbol_map_load_address(map, section), config->format_in);
+	free(filename);
+	if (r < 0) return r;
+    }
+    return 0;
+}
+
+
+
+/// Parsed map whose symbols are resolved on demand
+typedef struct field_resolver {
+    /// Handle of the parsed map source
+    nvm_symbol_map_source*	map;
+    /// Symbol list from parsing
+    nvm_symbol*			symbols;
+    /// Number of symbols in the list
+    int				num;
+} field_resolver;
+
+
+
+///@brief Resolve the symbols named by an override before compiling it
+///@see override_resolve_f
+static void
+resolve_field(
+    const char *name,		///< [in] Symbol name about to be looked up
+    void *arg)			///< [in] Parsed map, @sa field_resolver
+{
+    const field_resolver *resolver = arg;
+
+    symbol_map_resolve_symbol(resolver->map, resolver->symbols, resolver->num, name);
+}
+
+
+
+///@brief Compile overrides from application arguments for the final layout
+///@details Overrides from file come first, then binary files, so any given
+///         directly take precedence.  Only the symbols named by overrides are
+///         resolved, before their data is changed.
+///@return Zero on success or negative error code
+static int
+compile_overrides(
+    const tool_config* restrict config,		///< [in] Application configuration
+    nvm_symbol_map_source* restrict map,	///< [in,out] Final map source
+    nvm_symbol* restrict symbols,		///< [in,out] Symbol list of the final layout
+    const int num,				///< [in] Number of symbols in the list
+    override_program **program)			///< [out] Compiled overrides, NULL if none given
+{
+    field_resolver resolver = { map, symbols, num };
+    const symbol_index *index = symbol_map_index(map);
+    int r = 0, i;
+
+    *program = NULL;
+    if (! config->overrides_file && ! config->overrides
+	&& ! config->num_binary_overrides) return 0;
+    *program = override_program_new();
+    if (! *program) return -3;
+    override_program_resolver(*program, resolve_field, &resolver);
+
+    // Incorporate symbol overrides from file
+    if (config->overrides_file) {
+	r = override_program_add_file(*program, config->overrides_file,
+				      symbols, num, index);
+    }
+    // Incorporate binary file contents
+    for (i = 0; r >= 0 && i < config->num_binary_overrides; ++i) {
+	r = override_program_add_binary(*program, config->binary_overrides[i],
+					symbols, num, index);
+    }
+    // Incorporate other symbol overrides
+    if (r >= 0 && config->overrides) {
+	r = override_program_add_list(*program, config->overrides, symbols, num, index);
+    }
+    if (r < 0) {
+	override_program_free(*program);
+	*program = NULL;
+	return r;
+    }
+    return 0;
+}
+
+
+
+///@brief Apply overrides from application arguments to the final layout's data
+///@return Zero on success or negative error code
+static int
+apply_overrides(
+    const tool_config* restrict config,		///< [in] Application configuration
+    nvm_symbol_map_source* restrict map,	///< [in,out] Final map source
+    nvm_symbol* restrict symbols,		///< [in,out] Symbol list pointing into the blobs
+    const int num)				///< [in] Number of symbols in the list
+{
+    override_program *program;
+    int r;
+
+    r = compile_overrides(config, map, symbols, num, &program);
+    if (r < 0) return r;
+    if (program) override_program_apply(program, symbols);
+    override_program_free(program);
+    return 0;
+}
+
+
+
+///@brief Let any custom post-processors scan and manipulate each section's blob content
+///@return Zero on success or negative error code
+static int
+post_process_images(
+    const nvm_symbol_map_source* restrict map,	///< [in] Final map source
+    char *const blobs[],			///< [in,out] Binary data of each section
+    const nvm_symbol* restrict symbols,		///< [in] Symbol list pointing into the blobs
+    const symbol_index *index)			///< [in] Index of the symbol list or NULL
+{
+    int r, section, first, count;
+
+    for (section = 0; section < symbol_map_sections(map); ++section) {
+	count = symbol_map_section_symbols(map, section, &first);
+	r = post_process_image(blobs[section], symbol_map_blob_size(map, section),
+			       symbols + first, count, index);
+	if (r < 0) return r;
+    }
+    return 0;
+}
+
+
+
+///@brief Store each section's data to an output image file
+///@return Zero on success or negative error code
+static int
+write_images(
+    const tool_config* restrict config,		///< [in] Application configuration
+    const nvm_symbol_map_source* restrict map,	///< [in] Final map source
+    char *const blobs[],			///< [in] Binary data of each section
+    const char* restrict pattern,		///< [in] Image file name, possibly with placeholder
+    int escaped)				///< [in] Whether %% stands for a percent sign
+{
+    int r, section;
+    char *filename;
+
+    for (section = 0; section < symbol_map_sections(map); ++section) {
+	filename = section_file_name(pattern, symbol_map_section_name(map, section), escaped);
+	if (! filename) return -3;
+	r = image_write_file(filename, blobs[section],
+			     symbol_map_blob_size(map, section), config->format_out);
+	free(filename);
+	if (r < 0) return r;
+    }
+    return 0;
+}
 
 
 
 /// Carry out requested actions on final layout according to application arguments
 static inline int
 process_final_map(const tool_config* restrict config,
-		  const nvm_symbol_map_source* restrict map,
-		  const nvm_symbol* restrict symbols,
+		  nvm_symbol_map_source* restrict map,
+		  nvm_symbol* restrict symbols,
 		  const int num)
 {
-    int r;
-
-    // Incorporate symbol overrides from file
-    r = config->overrides_file ? parse_override_file(config->overrides_file, symbols, num) : 0;
-    if (r < 0) return r;
+    char *blobs[MAX_SECTIONS];
+    int r, section;
 
-    // Incorporate other symbol overrides
-    r = config->overrides ? parse_overrides(config->overrides, symbols, num) : 0;
+    map_blobs(map, blobs);
+    // Printing covers all fields, resolved before overrides change their data
+    if (config->show_fields != showNone || config->print_content != printNone) {
+	symbol_map_resolve(map, symbols, num);
+    }
+    r = apply_overrides(config, map, symbols, num);
     if (r < 0) return r;
-
-    // Let any custom post-processors scan and manipulate the blob content
-    r = post_process_image(symbol_map_blob_address(map), symbol_map_blob_size(map),
-			   symbols, num);
+    r = post_process_images(map, blobs, symbols, symbol_map_index(map));
     if (r < 0) return r;
 
     // Print out information if requested
-    if (config->show_size) symbol_map_print_size(map, config->show_fields & showSymbol);
+    for (section = 0; config->show_size && section < symbol_map_sections(map); ++section) {
+	symbol_map_print_size(map, section, config->show_fields & showSymbol);
+    }
     print_symbol_list(symbols, num, config->show_fields, config->print_content);
 
-    // Store output image to file
-    if (config->image_out) r = image_write_file(
-	config->image_out, symbol_map_blob_address(map), symbol_map_blob_size(map),
-	config->format_out);
-    if (r < 0) return r;
+    // Store output images to files
+    return config->image_out ? write_images(config, map, blobs, config->image_out, 0) : 0;
+}
+
+
+
+/// Print out the layout fingerprint of each examined section in a map
+static void
+print_fingerprints(
+    const nvm_symbol_map_source *map,	///< [in] Handle of the parsed map source
+    const char *filename)		///< [in] Map file name to show
+{
+    int section;
+
+    for (section = 0; section < symbol_map_sections(map); ++section) {
+	if (symbol_map_sections(map) > 1) {
+	    // Distinguish multiple sections by name
+	    printf("%016" PRIx64 "  %s %s\n", symbol_map_fingerprint(map, section),
+		   filename, symbol_map_section_name(map, section));
+	} else printf("%016" PRIx64 "  %s\n", symbol_map_fingerprint(map, section), filename);
+    }
+}
+
+
+
+///@brief Build the cache file name for a migration plan between two ELF files
+///@return Allocated file name (must be free()d) or NULL if not cacheable
+static char*
+plan_cache_name(
+    const tool_config* restrict config,			///< [in] Application configuration
+    const nvm_symbol_map_source* restrict map_in,	///< [in] Input map source
+    const nvm_symbol_map_source* restrict map_out)	///< [in] Output map source
+{
+    char id_in[SYMBOL_MAP_BUILD_ID_SIZE], id_out[SYMBOL_MAP_BUILD_ID_SIZE], *name, *end;
+    const char *section_name;
+    size_t length;
+    int i;
+
+    if (! config->layout_cache
+	|| ! symbol_map_build_id(map_in, id_in, sizeof(id_in))
+	|| ! symbol_map_build_id(map_out, id_out, sizeof(id_out))) return NULL;
+
+    length = strlen(config->layout_cache) + strlen(id_in) + strlen(id_out)
+	+ sizeof("/--.plan");
+    for (i = 0; i < config->num_sections; ++i) length += strlen(config->sections[i]) + 1;
+    name = malloc(length);
+    if (! name) return NULL;
+
+    end = name + sprintf(name, "%s/%s-%s", config->layout_cache, id_in, id_out);
+    for (i = 0; i < config->num_sections; ++i) {
+	section_name = config->sections[i];
+	// Section names usually start with a dot, skip it in the file name
+	if (*section_name == '.') ++section_name;
+	end += sprintf(end, "%c%s", i ? '+' : '-', section_name);
+    }
+    strcpy(end, ".plan");
+    return name;
+}
+
+
+
+///@brief Obtain the migration plan between input and output layout
+///@details Plans are cached next to the compiled layouts, keyed by both
+///         ELF files' build IDs and the section names.  Layouts with equal
+///         fingerprints are migrated by copying in place instead.
+///@return Compiled plan (must be released) or NULL on error
+static transfer_plan*
+prepare_plan(
+    const tool_config* restrict config,			///< [in] Application configuration
+    const nvm_symbol_map_source* restrict map_in,	///< [in] Input map source
+    const nvm_symbol* restrict symbols_in,		///< [in] Input symbol list
+    const nvm_symbol_map_source* restrict map_out,	///< [in] Output map source
+    const nvm_symbol* restrict symbols_out)		///< [in] Output symbol list
+{
+    transfer_plan *plan = NULL;
+    char *cache_name;
+    int section, first_in, first_out, count_in, count_out;
+
+    // Identical layouts need no symbol matching, nor caching
+    for (section = 0; section < config->num_sections; ++section) {
+	if (! symbol_map_plain_copy(map_in, section)
+	    || symbol_map_fingerprint(map_in, section)
+	    != symbol_map_fingerprint(map_out, section)) break;
+    }
+    if (section == config->num_sections && (plan = transfer_plan_new())) {
+	for (section = 0; section < config->num_sections; ++section) {
+	    count_in = symbol_map_section_symbols(map_in, section, &first_in);
+	    if (transfer_plan_add_identity(plan, symbols_in + first_in, count_in,
+					   symbol_map_blob_size(map_in, section)) < 0) {
+		transfer_plan_free(plan);
+		return NULL;
+	    }
+	}
+	return plan;
+    }
+
+    cache_name = plan_cache_name(config, map_in, map_out);
+    if (cache_name) plan = transfer_plan_read(cache_name);
+
+    // Discard plans not matching the current layouts
+    for (section = 0; plan && section < config->num_sections; ++section) {
+	if (transfer_plan_sections(plan) != config->num_sections
+	    || ! transfer_plan_matches(plan, section,
+				       symbol_map_blob_size(map_in, section),
+				       symbol_map_blob_size(map_out, section))) {
+	    transfer_plan_free(plan);
+	    plan = NULL;
+	}
+    }
+
+    if (! plan && (plan = transfer_plan_new())) {
+	// Fields are only transferred within the same section
+	for (section = 0; section < config->num_sections; ++section) {
+	    count_in = symbol_map_section_symbols(map_in, section, &first_in);
+	    count_out = symbol_map_section_symbols(map_out, section, &first_out);
+	    if (transfer_plan_add_section(
+		    plan, symbols_in + first_in, count_in, symbol_map_index(map_in),
+		    symbol_map_blob_size(map_in, section), symbols_out + first_out, count_out,
+		    symbol_map_blob_size(map_out, section)) < 0) {
+		transfer_plan_free(plan);
+		plan = NULL;
+		break;
+	    }
+	}
+	if (plan && cache_name) transfer_plan_write(plan, cache_name);
+    }
+
+    free(cache_name);
+    return plan;
+}
+
+
+
+///@brief Prepare a single migration plan along a chain of parsed maps
+///@details Plans for each hop are composed if there are intermediate maps.
+///@return Compiled plan (must be released) or NULL to transfer hop by hop
+static transfer_plan*
+prepare_chain(
+    const tool_config* restrict config,		///< [in] Application configuration
+    nvm_symbol_map_source *const maps[],	///< [in] Parsed maps, input first
+    nvm_symbol *const symbols[],		///< [in] Symbol lists of the parsed maps
+    int num_hops)				///< [in] Number of transfers between maps
+{
+    transfer_plan *hops[MAX_MAP_FILES - 1] = { NULL }, *plan = NULL;
+    int hop;
+
+    for (hop = 0; hop < num_hops; ++hop) {
+	hops[hop] = prepare_plan(config, maps[hop], symbols[hop], maps[hop + 1], symbols[hop + 1]);
+	if (! hops[hop]) break;
+    }
+    if (hop == num_hops && num_hops == 1) return hops[0];
+    if (hop == num_hops) plan = transfer_plan_compose(hops, num_hops);
+
+    while (hop-- > 0) transfer_plan_free(hops[hop]);
+    return plan;
+}
+
+
+
+///@brief Transfer data along a chain of maps into the last one
+///@details Without a plan, fields are transferred hop by hop through the
+///         intermediate blobs.
+static void
+transfer_chain(
+    const tool_config* restrict config,		///< [in] Application configuration
+    const transfer_plan *plan,			///< [in] Plan from prepare_chain() or NULL
+    nvm_symbol_map_source *const maps[],	///< [in] Parsed maps, input first
+    nvm_symbol *const symbols[],		///< [in] Symbol lists pointing into the blobs
+    const symbol_index *const indexes[],	///< [in] Index of each symbol list or NULL
+    char *const blobs[][MAX_SECTIONS],		///< [in,out] Binary data of each map and section
+    int num_hops)				///< [in] Number of transfers between maps
+{
+    char *chain[MAX_MAP_FILES];
+    size_t sizes[MAX_MAP_FILES];
+    int hop, section, first_in, first_out, count_in, count_out;
+
+    // Fields are only transferred within the same section
+    for (section = 0; section < config->num_sections; ++section) {
+	if (plan) {
+	    for (hop = 0; hop <= num_hops; ++hop) {
+		chain[hop] = blobs[hop][section];
+		sizes[hop] = symbol_map_blob_size(maps[hop], section);
+	    }
+	    transfer_plan_apply_chain(plan, section, chain, sizes);
+	} else for (hop = 0; hop < num_hops; ++hop) {
+	    count_in = symbol_map_section_symbols(maps[hop], section, &first_in);
+	    count_out = symbol_map_section_symbols(maps[hop + 1], section, &first_out);
+	    transfer_fields(symbols[hop] + first_in, count_in, indexes[hop],
+			    symbols[hop + 1] + first_out, count_out);
+	}
+    }
+}
+
+
+
+/// Input and output image file names for one image in batch mode
+typedef struct batch_job {
+    /// Image file to merge into the input map's data, NULL for none
+    char*		image_in;
+    /// Image file to write the final map's data to
+    char*		image_out;
+    /// Row of field values in provisioning mode, or serial number index
+    int			row;
+} batch_job;
+
+/// State shared by all batch workers
+typedef struct batch_context {
+    /// Application configuration
+    const tool_config*	config;
+    /// Parsed maps along the chain, input first, holding the default data
+    nvm_symbol_map_source *const *maps;
+    /// Symbol lists of the parsed maps
+    nvm_symbol *const *symbols;
+    /// Number of symbols in each list
+    const int*		nums;
+    /// Number of transfers between maps
+    int			num_hops;
+    /// Migration plan from input to final map, NULL to transfer hop by hop
+    const transfer_plan* plan;
+    /// Per-device field values in provisioning mode, NULL otherwise
+    const provision_table* provision;
+    /// Counter values to write to each image, NULL for none
+    const serial_range*	serial;
+    /// Index of the counter field's symbol in the final map
+    int			serial_symbol;
+    /// Overrides to apply to each image, NULL for none
+    const override_program* overrides;
+    /// Images to process
+    const batch_job*	jobs;
+    /// Number of images to process
+    int			num_jobs;
+    /// Index of the next image to process
+    int			next_job;
+    /// Number of images not processed successfully
+    int			failed;
+#if HAVE_PTHREADS
+    /// Serialize access to the job counters
+    pthread_mutex_t	lock;
+#endif
+} batch_context;
+
+/// Private copies of all maps' data for one batch worker
+typedef struct batch_workspace {
+    /// Symbol lists pointing into the private blobs
+    nvm_symbol*		symbols[MAX_MAP_FILES];
+    /// Index of each private symbol list
+    symbol_index*	indexes[MAX_MAP_FILES];
+    /// Binary data of each map and section
+    char*		blobs[MAX_MAP_FILES][MAX_SECTIONS];
+} batch_workspace;
 
+
+
+///@brief Read the list of image file pairs for batch mode
+///@return Number of images listed or negative error code
+static int
+read_batch_file(
+    const tool_config* restrict config,	///< [in] Application configuration
+    batch_job **jobs)			///< [out] Allocated list of images (must be free()d)
+{
+    static const char separators[] = " \t\r\n";
+    batch_job *list = NULL, *resized;
+    char *line = NULL, *image_in, *image_out, *rest;
+    size_t length = 0;
+    int num = 0, size = 0, line_number = 0, ret = 0;
+    FILE *in;
+
+    if (strcmp(config->batch_file, "-") == 0) in = stdin;
+    else in = fopen(config->batch_file, "r");
+    if (! in) {
+	fprintf(stderr, _("Cannot open batch file \"%s\" (%s)\n"),
+		config->batch_file, strerror(errno));
+	return -3;
+    }
+
+    while (ret == 0 && getline(&line, &length, in) != -1) {
+	++line_number;
+	image_in = strtok_r(line, separators, &rest);
+	if (! image_in || *image_in == '#') continue;	//skip empty lines and comments
+	image_out = strtok_r(NULL, separators, &rest);
+	if (! image_out || strtok_r(NULL, separators, &rest)) {
+	    fprintf(stderr, _("%s:%d: Expected input and output image file names\n"),
+		    config->batch_file, line_number);
+	    ret = -2;
+	} else if (config->num_sections > 1
+		   && (! strstr(image_in, SECTION_PLACEHOLDER)
+		       || ! strstr(image_out, SECTION_PLACEHOLDER))) {
+	    fprintf(stderr, _("%s:%d: Image file names must contain a %s placeholder"
+			      " for multiple sections.\n"),
+		    config->batch_file, line_number, SECTION_PLACEHOLDER);
+	    ret = -2;
+	} else {
+	    if (num >= size) {
+		size = size < 8 ? 16 : size * 2;
+		resized = realloc(list, size * sizeof(*list));
+		if (! resized) {
+		    ret = -3;
+		    break;
+		}
+		list = resized;
+	    }
+	    list[num].image_in = strdup(image_in);
+	    list[num].image_out = strdup(image_out);
+	    if (! list[num].image_in || ! list[num].image_out) ret = -3;
+	    ++num;
+	}
+    }
+    free(line);
+    if (in != stdin) fclose(in);
+
+    if (ret < 0) {
+	while (num-- > 0) {
+	    free(list[num].image_in);
+	    free(list[num].image_out);
+	}
+	free(list);
+	return ret;
+    }
+    *jobs = list;
+    return num;
+}
+
+
+
+///@brief Set up a worker's private copies of all maps' data
+///@return Zero on success or negative error code
+static int
+setup_workspace(
+    const batch_context *ctx,	///< [in] Shared batch state
+    batch_workspace *ws)	///< [out] Private data to set up
+{
+    const char *blob;
+    nvm_symbol *symbol;
+    size_t size;
+    int map, section, first, count;
+
+    memset(ws, 0, sizeof(*ws));
+    for (map = 0; map <= ctx->num_hops; ++map) {
+	// Never zero-sized, as maps without symbols are valid
+	ws->symbols[map] = malloc((ctx->nums[map] ? ctx->nums[map] : 1) * sizeof(nvm_symbol));
+	if (! ws->symbols[map]) return -3;
+	memcpy(ws->symbols[map], ctx->symbols[map], ctx->nums[map] * sizeof(nvm_symbol));
+	// Original values remain owned by the parsed lists
+	for (symbol = ws->symbols[map]; symbol < ws->symbols[map] + ctx->nums[map]; ++symbol) {
+	    symbol->original_value = NULL;
+	}
+
+	for (section = 0; section < symbol_map_sections(ctx->maps[map]); ++section) {
+	    blob = symbol_map_blob_address(ctx->maps[map], section);
+	    size = symbol_map_blob_size(ctx->maps[map], section);
+	    ws->blobs[map][section] = malloc(size ? size : 1);
+	    if (! ws->blobs[map][section]) return -3;
+
+	    // Point the copied symbols to the private blob instead
+	    count = symbol_map_section_symbols(ctx->maps[map], section, &first);
+	    for (symbol = ws->symbols[map] + first;
+		 symbol < ws->symbols[map] + first + count; ++symbol) {
+		symbol->blob_address = ws->blobs[map][section] + (symbol->blob_address - blob);
+	    }
+	}
+	if (ctx->nums[map] > 0) {
+	    ws->indexes[map] = symbol_list_index(ws->symbols[map], ctx->nums[map]);
+	    if (! ws->indexes[map]) return -3;
+	}
+    }
     return 0;
 }
 
 
 
+/// Release a worker's private copies of all maps' data
+static void
+release_workspace(const batch_context *ctx, batch_workspace *ws)
+{
+    int map, section;
+
+    for (map = 0; map <= ctx->num_hops; ++map) {
+	for (section = 0; section < MAX_SECTIONS; ++section) free(ws->blobs[map][section]);
+	symbol_list_free_index(ws->indexes[map]);
+	symbol_list_free(ws->symbols[map], ctx->nums[map]);
+	free(ws->symbols[map]);
+    }
+}
+
+
+
+///@brief Run one image through merging, transfer, overrides and output
+///@details In provisioning mode, the device's row of field values replaces the
+///         overrides, which were already applied to the final map's data.
+///         Otherwise the compiled overrides are copied into each image.  Any
+///         serial number is written last.
+///@return Zero on success or negative error code
+static int
+process_batch_image(
+    const batch_context *ctx,	///< [in] Shared batch state
+    batch_workspace *ws,	///< [in,out] Worker's private data
+    const batch_job *job)	///< [in] Image files to process
+{
+    const int last = ctx->num_hops;
+    int map, section, r;
+
+    // Start from each map's default data
+    for (map = 0; map <= last; ++map) {
+	for (section = 0; section < symbol_map_sections(ctx->maps[map]); ++section) {
+	    memcpy(ws->blobs[map][section], symbol_map_blob_address(ctx->maps[map], section),
+		   symbol_map_blob_size(ctx->maps[map], section));
+	}
+    }
+
+    if (job->image_in) {
+	r = merge_images(ctx->config, ctx->maps[0], ws->symbols[0], job->image_in);
+	if (r < 0) return r;
+    }
+    if (last > 0) {
+	transfer_chain(ctx->config, ctx->plan, ctx->maps, ws->symbols,
+		       (const symbol_index *const*) ws->indexes, ws->blobs, last);
+    }
+    if (ctx->provision) r = provision_apply(ctx->provision, job->row, ws->symbols[last]);
+    else r = ctx->overrides ? override_program_apply(ctx->overrides, ws->symbols[last]) : 0;
+    if (r < 0) return r;
+    if (ctx->serial) {
+	serial_range_write(ctx->serial, job->row, &ws->symbols[last][ctx->serial_symbol]);
+    }
+    r = post_process_images(ctx->maps[last], ws->blobs[last], ws->symbols[last],
+			    ws->indexes[last]);
+    if (r < 0) return r;
+    // Serial number templates still hold escaped percent signs
+    return write_images(ctx->config, ctx->maps[last], ws->blobs[last], job->image_out,
+			ctx->serial != NULL);
+}
+
+
+
+///@brief Process batch images until none are left
+///@return Always NULL
+static void*
+batch_worker(
+    void *arg)			///< [in,out] Shared batch state
+{
+    batch_context *ctx = arg;
+    batch_workspace ws;
+    int job, r;
+
+    r = setup_workspace(ctx, &ws);
+    if (r < 0) fprintf(stderr, _("Could not allocate memory for batch processing.\n"));
+    for (;;) {
+#if HAVE_PTHREADS
+	pthread_mutex_lock(&ctx->lock);
+#endif
+	// Without a workspace, just count the remaining images as failed
+	if (r < 0 && ctx->next_job < ctx->num_jobs) ++ctx->failed;
+	job = ctx->next_job < ctx->num_jobs ? ctx->next_job++ : -1;
+#if HAVE_PTHREADS
+	pthread_mutex_unlock(&ctx->lock);
+#endif
+	if (job < 0) break;
+	if (r < 0) continue;
+
+	if (process_batch_image(ctx, &ws, &ctx->jobs[job]) < 0) {
+	    if (ctx->jobs[job].image_in) {
+		fprintf(stderr, _("Failed to process image \"%s\" into \"%s\"\n"),
+			ctx->jobs[job].image_in, ctx->jobs[job].image_out);
+	    } else fprintf(stderr, _("Failed to produce image \"%s\"\n"),
+			   ctx->jobs[job].image_out);
+#if HAVE_PTHREADS
+	    pthread_mutex_lock(&ctx->lock);
+#endif
+	    ++ctx->failed;
+#if HAVE_PTHREADS
+	    pthread_mutex_unlock(&ctx->lock);
+#endif
+	}
+    }
+    release_workspace(ctx, &ws);
+    return NULL;
+}
+
+
+
+///@brief Process all jobs of a batch using a pool of worker threads
+///@details The maps are only read from, each worker thread transforms images
+///         using its own copies of the blobs and symbol lists.  Without a
+///         thread limit, one worker per processor is used.  While several
+///         workers run, each image is decoded and encoded in a single thread.
+///@return Zero on success or negative error code
+static int
+run_batch(
+    batch_context *ctx)		///< [in,out] Shared batch state with jobs set up
+{
+    int num_threads = 1;	//the calling thread works as well
+#if HAVE_PTHREADS
+    pthread_t threads[MAX_BATCH_THREADS];
+    long max_threads = ctx->config->threads;
+    int i;
+
+    if (max_threads < 1) max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (max_threads > ctx->num_jobs) max_threads = ctx->num_jobs;
+    if (max_threads > MAX_BATCH_THREADS) max_threads = MAX_BATCH_THREADS;
+    // Workers already keep the processors busy, avoid spawning more threads per image
+    if (max_threads > 1) {
+	image_ihex_read_threads(1);
+	image_ihex_write_threads(1);
+    }
+
+    pthread_mutex_init(&ctx->lock, NULL);
+    for (; num_threads < max_threads; ++num_threads) {
+	if (pthread_create(&threads[num_threads - 1], NULL, batch_worker, ctx) != 0) break;
+    }
+#endif
+    batch_worker(ctx);
+#if HAVE_PTHREADS
+    for (i = 1; i < num_threads; ++i) pthread_join(threads[i - 1], NULL);
+    pthread_mutex_destroy(&ctx->lock);
+    image_ihex_read_threads(ctx->config->threads);
+    image_ihex_write_threads(ctx->config->threads);
+#endif
+    if (DEBUG) printf("%s: %d images, %d failed, %d threads\n", __func__,
+		      ctx->num_jobs, ctx->failed, num_threads);
+    return ctx->failed ? -2 : 0;
+}
+
+
+
+///@brief Process all images listed in the batch file with the parsed maps
+///@return Zero on success or negative error code
+static int
+process_batch(
+    const tool_config* restrict config,		///< [in] Application configuration
+    nvm_symbol_map_source *const maps[],	///< [in] Parsed maps, input first
+    nvm_symbol *const symbols[],		///< [in] Symbol lists of the parsed maps
+    const int nums[],				///< [in] Number of symbols in each list
+    int num_hops)				///< [in] Number of transfers between maps
+{
+    batch_job *jobs = NULL;
+    transfer_plan *plan;
+    override_program *overrides;
+    batch_context ctx = {
+	.config		= config,
+	.maps		= maps,
+	.symbols	= symbols,
+	.nums		= nums,
+	.num_hops	= num_hops,
+    };
+    int ret_code, i;
+
+    ctx.num_jobs = read_batch_file(config, &jobs);
+    if (ctx.num_jobs <= 0) return ctx.num_jobs;
+
+    // Images are merged and transferred according to all fields
+    for (i = 0; i <= num_hops; ++i) symbol_map_resolve(maps[i], symbols[i], nums[i]);
+    ret_code = compile_overrides(config, maps[num_hops], symbols[num_hops], nums[num_hops],
+				 &overrides);
+    if (ret_code >= 0) {
+	ctx.plan = plan = num_hops > 0 ? prepare_chain(config, maps, symbols, num_hops) : NULL;
+	ctx.overrides = overrides;
+	ctx.jobs = jobs;
+	ret_code = run_batch(&ctx);
+	transfer_plan_free(plan);
+	override_program_free(overrides);
+    }
+
+    for (i = 0; i < ctx.num_jobs; ++i) {
+	free(jobs[i].image_in);
+	free(jobs[i].image_out);
+    }
+    free(jobs);
+    return ret_code;
+}
+
+
+
+///@brief Write one output image per device listed in the provisioning file
+///@details Overrides from application arguments apply to all devices, before
+///         each device's own field values.
+///@return Zero on success or negative error code
+static int
+process_provision(
+    const tool_config* restrict config,		///< [in] Application configuration
+    nvm_symbol_map_source *map,			///< [in] Final map source
+    nvm_symbol *symbols,			///< [in] Symbol list of the final map
+    int num)					///< [in] Number of symbols in the list
+{
+    provision_table *table;
+    batch_job *jobs;
+    batch_context ctx = {
+	.config		= config,
+	.maps		= &map,
+	.symbols	= &symbols,
+	.nums		= &num,
+    };
+    int ret_code, row;
+
+    // Provisioning columns may name any field
+    symbol_map_resolve(map, symbols, num);
+    ret_code = apply_overrides(config, map, symbols, num);
+    if (ret_code < 0) return ret_code;
+
+    table = provision_read(config->provision_file, symbols, num,
+			   symbol_map_index(map));
+    if (! table) return -2;
+    ctx.provision = table;
+    ctx.num_jobs = provision_rows(table);
+    jobs = calloc(ctx.num_jobs + 1, sizeof(*jobs));
+    if (! jobs) ret_code = -3;
+    else {
+	for (row = 0; row < ctx.num_jobs; ++row) {
+	    jobs[row].image_out = (char*) provision_image_name(table, row);
+	    jobs[row].row = row;
+	}
+	ctx.jobs = jobs;
+	ret_code = run_batch(&ctx);
+    }
+
+    free(jobs);
+    provision_free(table);
+    return ret_code;
+}
+
+
+
+///@brief Write one output image per serial number in the configured range
+///@details Overrides from application arguments apply to all images and are
+///         written to the final map's data once.
+///@return Zero on success or negative error code
+static int
+process_serial_range(
+    const tool_config* restrict config,		///< [in] Application configuration
+    nvm_symbol_map_source *map,			///< [in] Final map source
+    nvm_symbol *symbols,			///< [in] Symbol list of the final map
+    int num)					///< [in] Number of symbols in the list
+{
+    batch_job *jobs;
+    batch_context ctx = {
+	.config		= config,
+	.maps		= &map,
+	.symbols	= &symbols,
+	.nums		= &num,
+	.serial		= &config->serial,
+	.num_jobs	= config->serial.count,
+    };
+    size_t length;
+    int ret_code, index;
+
+    if (config->serial.field) {
+	// Encoding options follow the field symbol name
+	length = strcspn(config->serial.field, ":");
+	char name[length + 1];
+	memcpy(name, config->serial.field, length);
+	name[length] = '\0';
+	symbol_map_resolve_symbol(map, symbols, num, name);
+    }
+    ret_code = apply_overrides(config, map, symbols, num);
+    if (ret_code < 0) return ret_code;
+    ctx.serial_symbol = serial_range_resolve(&config->serial, symbols, num,
+					     symbol_map_index(map));
+    if (ctx.serial_symbol < 0) return ctx.serial_symbol;
+
+    jobs = calloc(ctx.num_jobs + 1, sizeof(*jobs));
+    if (! jobs) return -3;
+    for (index = 0; index < ctx.num_jobs && ret_code >= 0; ++index) {
+	jobs[index].image_out = serial_range_file_name(
+	    config->image_out, serial_range_value(&config->serial, index));
+	jobs[index].row = index;
+	if (! jobs[index].image_out) ret_code = -3;
+    }
+    if (ret_code >= 0) {
+	ctx.jobs = jobs;
+	ret_code = run_batch(&ctx);
+    } else fprintf(stderr, _("Could not allocate memory for batch processing.\n"));
+
+    for (index = 0; index < ctx.num_jobs; ++index) free(jobs[index].image_out);
+    free(jobs);
+    return ret_code;
+}
+
+
+
 /// Adjust for output layout according to application arguments
 static inline int
 process_output_map(const tool_config* restrict config,
-		   const nvm_symbol_map_source* restrict map_in,
+		   nvm_symbol_map_source* restrict map_in,
 		   const int num_in,
-		   const nvm_symbol* restrict symbols_in)
+		   nvm_symbol* restrict symbols_in)
 {
-    nvm_symbol_map_source *map_out = NULL;
-    nvm_symbol *symbols_out = NULL;
-    int num_out, ret_code;
+    nvm_symbol_map_source *maps[MAX_MAP_FILES] = { map_in };
+    nvm_symbol *symbols[MAX_MAP_FILES] = { symbols_in };
+    const symbol_index *indexes[MAX_MAP_FILES];
+    char *blobs[MAX_MAP_FILES][MAX_SECTIONS];
+    int nums[MAX_MAP_FILES] = { num_in };
+    int ret_code = 0, last = config->num_map_files - 1, i, hop;
+    transfer_plan *plan;
 
-    if (! config->map_files[1]) {
+    if (last < 1) {
 	// No valid output map, use same as input
+	if (config->batch_file) return process_batch(config, maps, symbols, nums, 0);
+	if (config->provision_file) return process_provision(config, map_in, symbols_in, num_in);
+	if (config->serial.count) return process_serial_range(config, map_in, symbols_in, num_in);
 	return process_final_map(config, map_in, symbols_in, num_in);
     }
 
-    // Translate data from input to output layout if supplied
-    map_out = symbol_map_open_file(config->map_files[1]);
-    num_out = symbol_map_parse(map_out, config->section, &symbols_out,
-			       config->show_fields & showFilterChanged);
-    if (num_out < 0) return num_out;	//propagate error code
-
-    if (symbols_out) {
-	transfer_fields(symbols_in, num_in, symbols_out, num_out);
-	ret_code = process_final_map(config, map_out, symbols_out, num_out);
+    // Translate data from input via any intermediate to output layout
+    for (i = 1; i <= last && ret_code >= 0; ++i) {
+	maps[i] = symbol_map_open_file(config->map_files[i]);
+	nums[i] = symbol_map_parse(maps[i], config->sections, config->num_sections, &symbols[i],
+				   i == last && (config->show_fields & showFilterChanged));
+	if (nums[i] < 0) ret_code = nums[i];	//propagate error code
+	else if (! symbols[i]) last = -1;	//nothing to transfer
+	else {
+	    // Transfers match symbols by their field descriptors
+	    symbol_map_resolve(maps[i], symbols[i], nums[i]);
+	    if (config->show_fingerprint) print_fingerprints(maps[i], config->map_files[i]);
+	}
     }
+    if (ret_code >= 0 && last > 0) symbol_map_resolve(map_in, symbols_in, num_in);
 
-    symbol_list_free(symbols_out, num_out);
-    free(symbols_out);
+    if (ret_code >= 0 && last > 0 && config->batch_file) {
+	ret_code = process_batch(config, maps, symbols, nums, last);
+    } else if (ret_code >= 0 && last > 0) {
+	for (hop = 0; hop <= last; ++hop) {
+	    map_blobs(maps[hop], blobs[hop]);
+	    indexes[hop] = symbol_map_index(maps[hop]);
+	}
+	plan = prepare_chain(config, maps, symbols, last);
+	transfer_chain(config, plan, maps, symbols, indexes, blobs, last);
+	transfer_plan_free(plan);
+	if (config->provision_file) {
+	    ret_code = process_provision(config, maps[last], symbols[last], nums[last]);
+	} else if (config->serial.count) {
+	    ret_code = process_serial_range(config, maps[last], symbols[last], nums[last]);
+	} else ret_code = process_final_map(config, maps[last], symbols[last], nums[last]);
+    }
 
+    while (--i > 0) {
+	symbol_list_free(symbols[i], nums[i]);
+	free(symbols[i]);
+	symbol_map_close(maps[i]);
+    }
     return ret_code;
 }
 
@@ -118,23 +1050,27 @@ process_output_map(const tool_config* restrict config,
 /// Read and examine blob data from input image according to application arguments
 static inline int
 process_input_image(const tool_config* restrict config,
-		    const nvm_symbol_map_source* restrict map_in,
-		    const nvm_symbol* restrict symbols_in,
+		    nvm_symbol_map_source* restrict map_in,
+		    nvm_symbol* restrict symbols_in,
 		    const int num_in)
 {
-    int ret_code;
+    int ret_code = 0, section;
 
     if (config->image_in) {
-	ret_code = image_merge_file(config->image_in, symbols_in, num_in,
-				    symbol_map_blob_size(map_in), config->format_in);
-	if (ret_code < 0) return ret_code;
+	// Field sizes are adjusted according to the default data
+	symbol_map_resolve(map_in, symbols_in, num_in);
+	ret_code = merge_images(config, map_in, symbols_in, config->image_in);
     }
+    if (ret_code < 0) return ret_code;
 
     // Scan for strings if requested (no error potential)
-    if (config->lpstring_min >= 0) nvm_string_list(
-	symbol_map_blob_address(map_in), symbol_map_blob_size(map_in),
-	config->lpstring_min, config->show_fields & showSymbol,
-	NULL);
+    for (section = 0; config->lpstring_min >= 0 && section < symbol_map_sections(map_in);
+	 ++section) {
+	nvm_string_list(
+	    symbol_map_blob_address(map_in, section), symbol_map_blob_size(map_in, section), 0,
+	    config->lpstring_min, config->show_fields & showSymbol,
+	    NULL);
+    }
 
     ret_code = process_output_map(config, map_in, num_in, symbols_in);
 
@@ -153,11 +1089,29 @@ process_maps(const tool_config *config)
     int num_in, ret_code;
 
     // Read input symbol layout and associated image data
+    symbol_map_layout_cache(config->layout_cache);
+    symbol_map_scan_threads(config->threads);
+    image_ihex_record_length(config->record_length);
+    image_ihex_read_threads(config->threads);
+    image_ihex_read_index(config->ihex_index);
+    image_ihex_addressing(config->input_addressing);
+    image_ihex_write_threads(config->threads);
+    // Fields are resolved as far as needed by each action
+    symbol_map_lazy_resolution(1);
     map_in = symbol_map_open_file(config->map_files[0]);
-    num_in = symbol_map_parse(map_in, config->section, &symbols_in,
-			      config->show_fields & showFilterChanged);
+    num_in = symbol_map_parse(map_in, config->sections, config->num_sections,
+			      &symbols_in, config->show_fields & showFilterChanged);
     if (num_in <= 0) ret_code = num_in;	//propagate error code or no symbols
-    else ret_code = process_input_image(config, map_in, symbols_in, num_in);
+    else {
+	if (config->show_fingerprint || config->layout_out) {
+	    symbol_map_resolve(map_in, symbols_in, num_in);
+	}
+	if (config->show_fingerprint) print_fingerprints(map_in, config->map_files[0]);
+	// Compile layout while the blobs still hold the default data
+	ret_code = config->layout_out ? symbol_map_write_layout(
+	    map_in, symbols_in, num_in, config->layout_out) : 0;
+	if (ret_code >= 0) ret_code = process_input_image(config, map_in, symbols_in, num_in);
+    }
 
     symbol_list_free(symbols_in, num_in);
     free(symbols_in);
@@ -174,7 +1128,6 @@ main(int argc, char **argv)
 {
     int ret_code;
     tool_config config = {
-	.section		= DEFAULT_SECTION,
 	.lpstring_min		= -1,
 	.show_size		= 0,
 	.show_fields		= showNone,
@@ -194,7 +1147,8 @@ main(int argc, char **argv)
     // Process specified actions
     ret_code = -process_maps(&config);
 
-    free(config.overrides);
+    override_list_free(config.overrides);
+    free(config.binary_overrides);
 
     return ret_code;
 }
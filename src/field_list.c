@@ -1,6 +1,6 @@
 ///@file
 ///@brief	Linked list of field descriptors
-///@copyright	Copyright (C) 2014, 2015, 2022, 2023  Andre Colomb
+///@copyright	Copyright (C) 2014, 2015, 2022, 2023, 2026  Andre Colomb
 ///
 /// This file is part of elf-mangle.
 ///
@@ -29,20 +29,115 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 /// Compile diagnostic output messages?
 #define DEBUG 0
 
 
 
-/// Element in the linked list
+/// Minimum number of hash table slots to allocate
+#define MIN_CAPACITY		64
+/// Minimum size of arena blocks in bytes
+#define BLOCK_SIZE		(64 * 1024)
+
+/// Round up sizes to keep arena allocations aligned for any field member
+#define ALIGN_SIZE(s)	(((s) + sizeof(void*) - 1) & ~(sizeof(void*) - 1))
+
+
+
+/// Element in the hash table
 struct nvm_field_list_entry {
     /// Immutable field descriptor
     const nvm_field	field;
-    /// Link to next list elemnt
-    field_list_entry*	next;
+    /// Hash value of the symbol name
+    size_t		hash;
 };
 
+/// Memory block for allocating entries and names, never moved or shrunk
+struct field_list_block {
+    /// Previously allocated block
+    field_list_block*	next;
+    /// Number of bytes used in the data area
+    size_t		used;
+    /// Size of the data area in bytes
+    size_t		size;
+    /// Data area for allocations
+    char		data[];
+};
+
+
+
+/// Calculate the FNV-1a hash value of a symbol name
+static inline size_t
+hash_name(const char *symbol)
+{
+    uint64_t hash = 14695981039346656037ULL;
+
+    while (*symbol) {
+	hash ^= (unsigned char) *symbol++;
+	hash *= 1099511628211ULL;
+    }
+    return (size_t) hash;
+}
+
+
+
+///@brief Allocate memory from the list's arena
+///@return Address of the allocated memory or NULL on error
+static void*
+arena_alloc(
+    nvm_field_list *list,	///< [in,out] List owning the arena
+    size_t size)		///< [in] Number of bytes needed
+{
+    field_list_block *block = list->arena;
+    size_t block_size;
+    void *mem;
+
+    size = ALIGN_SIZE(size);
+    if (! block || block->size - block->used < size) {
+	block_size = size > BLOCK_SIZE ? size : BLOCK_SIZE;
+	block = malloc(sizeof(*block) + block_size);
+	if (! block) return NULL;
+	block->next = list->arena;
+	block->used = 0;
+	block->size = block_size;
+	list->arena = block;
+    }
+    mem = block->data + block->used;
+    block->used += size;
+    return mem;
+}
+
+
+
+///@brief Enlarge the hash table, keeping all entries
+///@return Zero on success or negative on error
+static int
+grow_table(
+    nvm_field_list *list)	///< [in,out] List to enlarge
+{
+    field_list_entry **slots, *entry;
+    size_t capacity, i, pos;
+
+    capacity = list->capacity ? list->capacity * 2 : MIN_CAPACITY;
+    slots = calloc(capacity, sizeof(*slots));
+    if (! slots) return -1;
+
+    for (i = 0; i < list->capacity; ++i) {
+	entry = list->slots[i];
+	if (! entry) continue;
+	for (pos = entry->hash & (capacity - 1); slots[pos]; pos = (pos + 1) & (capacity - 1));
+	slots[pos] = entry;
+    }
+    if (DEBUG) printf("%s: %zu -> %zu slots\n", __func__, list->capacity, capacity);
+
+    free(list->slots);
+    list->slots = slots;
+    list->capacity = capacity;
+    return 0;
+}
+
 
 
 const nvm_field*
@@ -50,14 +145,17 @@ field_list_find(const char* restrict symbol,
 		const nvm_field_list* restrict list)
 {
     field_list_entry *entry;
-    int comp;
+    size_t hash, pos;
 
-    if (! list) return NULL;
+    if (! list || ! symbol || ! list->count) return NULL;
 
-    for (entry = list->start; entry; entry = entry->next) {
-	comp = strcmp(entry->field.symbol, symbol);
-	if (DEBUG) printf("%s: (%s; %s) = %d\n", __func__, entry->field.symbol, symbol, comp);
-	if (comp == 0) return &entry->field;
+    hash = hash_name(symbol);
+    for (pos = hash & (list->capacity - 1); (entry = list->slots[pos]);
+	 pos = (pos + 1) & (list->capacity - 1)) {
+	if (DEBUG) printf("%s: [%zu] (%s; %s)\n", __func__, pos, entry->field.symbol, symbol);
+	if (entry->hash == hash && strcmp(entry->field.symbol, symbol) == 0) {
+	    return &entry->field;
+	}
     }
     return NULL;
 }
@@ -71,26 +169,95 @@ field_list_add(nvm_field_list *list,
 {
     nvm_field *field;
     field_list_entry *entry;
+    char *name;
+    size_t length, pos;
+
+    if (! list || ! symbol) return NULL;
+
+    // Keep load factor below 3/4
+    if ((list->count + 1) * 4 > list->capacity * 3 && grow_table(list) < 0) return NULL;
+
+    // Intern the name right after the entry
+    length = strlen(symbol) + 1;
+    entry = arena_alloc(list, ALIGN_SIZE(sizeof(*entry)) + length);
+    if (! entry) return NULL;
+    name = (char*) entry + ALIGN_SIZE(sizeof(*entry));
+    memcpy(name, symbol, length);
+
+    // Initialize new element through non-const pointer
+    field = (nvm_field*) &entry->field;
+    memset(field, 0, sizeof(*field));
+    field->expected_size = expected_size;
+    field->symbol = name;
+    field->description = description;
+    entry->hash = hash_name(name);
+
+    // Equal names are found in order of insertion along the probe sequence
+    for (pos = entry->hash & (list->capacity - 1); list->slots[pos];
+	 pos = (pos + 1) & (list->capacity - 1));
+    list->slots[pos] = entry;
+    ++list->count;
+    return &entry->field;
+}
+
+
+
+void
+field_list_free(nvm_field_list *list)
+{
+    field_list_block *block;
 
-    if (! list) return NULL;
-
-    entry = calloc(1, sizeof(*entry));
-    if (entry) {
-	// Initialize new element through non-const pointer
-	field = (nvm_field*) &entry->field;
-	field->expected_size = expected_size;
-	field->symbol = symbol;
-	field->description = description;
-	// Insert new field entry at given tail position
-	if (list->tail) {
-	    entry->next = list->tail->next;
-	    list->tail->next = entry;
+    if (! list) return;
+
+    while ((block = list->arena)) {
+	list->arena = block->next;
+	free(block);
+    }
+    free(list->slots);
+    list->slots = NULL;
+    list->capacity = list->count = 0;
+}
+
+
+
+#ifdef TEST_FIELD_LIST
+#include <time.h>
+
+/// Benchmark adding and finding unknown fields like during map parsing.
+///
+/// Each symbol name is looked up first and added when not found, then
+/// all names are looked up again as when parsing a second map.  With
+/// constant time per operation, the time per symbol should stay about
+/// the same for each list size.
+int
+main(void)
+{
+    static const int counts[] = { 10000, 100000 };
+    struct timespec start, end;
+    nvm_field_list list = { 0 };
+    char name[32];
+    int i, n, missing;
+    double elapsed;
+
+    for (i = 0; i < (int) (sizeof(counts) / sizeof(*counts)); ++i) {
+	missing = 0;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (n = 0; n < counts[i]; ++n) {
+	    snprintf(name, sizeof(name), "nvm_unknown_%d", n);
+	    if (! field_list_find(name, &list)
+		&& ! field_list_add(&list, n % 16, name, NULL)) return 1;
 	}
-	// Adjust new chain tail position
-	list->tail = entry;
-	// Adjust chain start if there was previously no element
-	if (! list->start) list->start = entry;
-	return &entry->field;
+	for (n = 0; n < counts[i]; ++n) {
+	    snprintf(name, sizeof(name), "nvm_unknown_%d", n);
+	    if (! field_list_find(name, &list)) ++missing;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	field_list_free(&list);
+
+	elapsed = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+	printf("%7d symbols: %10.3f ms total, %6.2f ns per symbol%s\n",
+	       counts[i], elapsed / 1e6, elapsed / counts[i], missing ? " (FAILED)" : "");
     }
-    return NULL;
+    return 0;
 }
+#endif
@@ -1,6 +1,6 @@
 ///@file
 ///@brief	Growable list of field descriptors with invariant addresses
-///@copyright	Copyright (C) 2014  Andre Colomb
+///@copyright	Copyright (C) 2014, 2026  Andre Colomb
 ///
 /// This file is part of elf-mangle.
 ///
@@ -34,12 +34,21 @@ typedef struct nvm_field nvm_field;
 /// Opaque type for a list entry
 typedef struct nvm_field_list_entry field_list_entry;
 
-/// List of field descriptors
+/// Opaque type for a block of memory holding entries and names
+typedef struct field_list_block field_list_block;
+
+/// List of field descriptors, indexed by symbol name.
+///
+/// A zero-initialized structure represents an empty list.
 typedef struct nvm_field_list {
-    /// Access to the first list entry
-    field_list_entry*	start;
-    /// Direct access to the last list entry
-    field_list_entry*	tail;
+    /// Hash table of entries, using open addressing with linear probing
+    field_list_entry**	slots;
+    /// Number of hash table slots, zero or a power of two
+    size_t		capacity;
+    /// Number of entries in the list
+    size_t		count;
+    /// Most recently allocated memory block for entries and names
+    field_list_block*	arena;
 } nvm_field_list;
 
 
@@ -51,6 +60,7 @@ const nvm_field* field_list_find(
 );
 
 ///@brief Append and initialize a new field descriptor to the list
+///@details The symbol name is copied, so it need not stay valid afterwards.
 ///@invariant References to any previously added field descriptors remain valid
 ///@return Reference to the newly added field descriptor
 const nvm_field* field_list_add(
@@ -60,4 +70,10 @@ const nvm_field* field_list_add(
     const char *description	///< [in] Intelligible field name to record in field descriptor
 );
 
+///@brief Release all field descriptors in the list
+///@note All references to field descriptors from the list become invalid
+void field_list_free(
+    nvm_field_list *list	///< [in,out] Field descriptor list, left empty
+);
+
 #endif //FIELD_LIST_H_
@@ -1,6 +1,6 @@
 ///@file
 ///@brief	Locate special strings in binary images
-///@copyright	Copyright (C) 2014, 2015, 2016  Andre Colomb
+///@copyright	Copyright (C) 2014, 2015, 2016, 2026  Andre Colomb
 ///
 /// This file is part of elf-mangle.
 ///
@@ -90,9 +90,10 @@ nvm_string_find(const char* blob, size_t size, uint8_t min_length)
 /// parameter.  If negative, the string length is also included.  If
 /// no delimiter is specified, a human-readable, verbose default
 /// format is used.  A nonzero output_format then avoids translation
-/// of the message.
+/// of the message.  Printed offsets are counted from the given address,
+/// so data from several ranges of an image can be listed consistently.
 int
-nvm_string_list(const char* blob, size_t size,
+nvm_string_list(const char* blob, size_t size, size_t address,
 		uint8_t min_length,
 		int output_format, const char *delim)
 {
@@ -112,7 +113,7 @@ nvm_string_list(const char* blob, size_t size,
 	    case -16:	fmt = "%7zx+%03zx "; break;
 	    default:	break;
 	    }
-	    if (fmt) printf(fmt, next - 1 - blob, strlen(next));
+	    if (fmt) printf(fmt, address + (next - 1 - blob), strlen(next));
 	    printf("%s%s", next, delim);
 	} else {
 	    printf(output_format
@@ -120,7 +121,7 @@ nvm_string_list(const char* blob, size_t size,
 		      "\"%s\"\n")
 		   : _("Length prefixed string at offset [%04zx] (%zu bytes + NUL):\n\t"
 		       "\"%s\"\n"),
-		   next - 1 - blob, strlen(next), next);
+		   address + (next - 1 - blob), strlen(next), next);
 	}
 	next += strlen(next) + 1;
 	size -= next - start;
@@ -170,6 +171,6 @@ main(void)
 	"\0"			//0xff
 	;
 
-    return nvm_string_list(data, sizeof(data), 0, -16, " EOS\n\n");
+    return nvm_string_list(data, sizeof(data), 0, 0, -16, " EOS\n\n");
 }
 #endif
@@ -1,6 +1,6 @@
 ///@file
 ///@brief	Locate special strings in binary images
-///@copyright	Copyright (C) 2014, 2016  Andre Colomb
+///@copyright	Copyright (C) 2014, 2016, 2026  Andre Colomb
 ///
 /// This file is part of elf-mangle.
 ///
@@ -45,6 +45,7 @@ const char* nvm_string_find(
 int nvm_string_list(
     const char* blob,		///< [in] Binary data to search in
     size_t size,		///< [in] Size of binary data
+    size_t address,		///< [in] Address of the first byte for printed offsets
     uint8_t min_length,		///< [in] Minimum string length passed to nvm_string_find()
     int output_format,		///< [in] Output format configuration
     const char *delim		///< [in] Delimiter for string output, forces simple format if set
@@ -0,0 +1,424 @@
+///@file
+///@brief	Conversion of hexadecimal text to binary data
+///@copyright	Copyright (C) 2026  Andre Colomb
+///
+/// This file is part of elf-mangle.
+///
+/// This file is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU Lesser General Public License as
+/// published by the Free Software Foundation, either version 3 of the
+/// License, or (at your option) any later version.
+///
+/// elf-mangle is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+/// Lesser General Public License for more details.
+///
+/// You should have received a copy of the GNU Lesser General Public
+/// License along with this program.  If not, see
+/// <http://www.gnu.org/licenses/>.
+///
+///@author	Andre Colomb <src@andre.colomb.de>
+
+
+#include "config.h"
+
+#include "hex_decode.h"
+
+#include <stdio.h>
+#include <ctype.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+/// Decode contiguous digits sixteen bytes at a time
+#define HEX_DECODE_SSE2 1
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+/// Decode contiguous digits 32 bytes at a time, if the processor supports it
+#define HEX_DECODE_AVX2 1
+#endif
+#endif
+
+/// Compile diagnostic output messages?
+#define DEBUG 0
+
+/// Characters to decode singly after a block decoder stopped, before trying again
+#define BLOCK_RETRY	32
+/// Upper limit for backing off after repeated block decoder failures
+#define BLOCK_RETRY_MAX	1024
+
+
+
+///@brief Decode a run of contiguous digit pairs in large blocks
+///@details Stops before the first block containing anything but hex digits,
+///         or when the text or output buffer is too short for another block.
+///@return Number of bytes decoded, consuming twice as many characters
+typedef size_t (*decode_run_function)(
+    const char *text,		///< [in] Hexadecimal text
+    size_t length,		///< [in] Number of characters available
+    char *output,		///< [out] Buffer to store decoded bytes
+    size_t max_length);		///< [in] Space left in output buffer
+
+
+
+/// Value of each hexadecimal digit character plus one, zero for all others
+static const unsigned char digit_values[256] = {
+    ['0'] = 1,  ['1'] = 2,  ['2'] = 3,  ['3'] = 4,  ['4'] = 5,
+    ['5'] = 6,  ['6'] = 7,  ['7'] = 8,  ['8'] = 9,  ['9'] = 10,
+    ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+    ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+};
+
+
+
+/// Convert a hexadecimal digit to its value, negative if invalid
+static inline int
+hex_value(unsigned char c)
+{
+    // Table lookup avoids mispredicted branches on mixed digits and letters
+    return digit_values[c] - 1;
+}
+
+
+
+#if HEX_DECODE_SSE2
+///@brief Convert sixteen characters to their digit values
+///@return Non-zero if all characters were valid hex digits
+static inline int
+nibbles_sse2(
+    __m128i chars,		///< [in] Characters to convert
+    __m128i *values)		///< [out] Digit value in each byte
+{
+    const __m128i lower = _mm_or_si128(chars, _mm_set1_epi8(0x20));
+    const __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('0' - 1)),
+					_mm_cmplt_epi8(chars, _mm_set1_epi8('9' + 1)));
+    const __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+					_mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+
+    // Signed comparison rejects any bytes above 0x7f as well
+    *values = _mm_or_si128(
+	_mm_and_si128(digit, _mm_sub_epi8(chars, _mm_set1_epi8('0'))),
+	_mm_and_si128(alpha, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10))));
+    return _mm_movemask_epi8(_mm_or_si128(digit, alpha)) == 0xFFFF;
+}
+
+
+
+/// Merge pairs of digit values into one byte in each 16-bit lane
+static inline __m128i
+merge_sse2(__m128i values)
+{
+    return _mm_or_si128(_mm_slli_epi16(_mm_and_si128(values, _mm_set1_epi16(0x00FF)), 4),
+			_mm_srli_epi16(values, 8));
+}
+
+
+
+///@brief Decode contiguous digits with SSE2 instructions
+///@sa decode_run_function
+static size_t
+decode_run_sse2(const char *text, size_t length, char *output, size_t max_length)
+{
+    __m128i first, second;
+    size_t decoded = 0;
+
+    while (length >= 32 && max_length - decoded >= 16) {
+	if (! nibbles_sse2(_mm_loadu_si128((const __m128i*) text), &first)
+	    || ! nibbles_sse2(_mm_loadu_si128((const __m128i*) (text + 16)), &second)) break;
+	_mm_storeu_si128((__m128i*) (output + decoded),
+			 _mm_packus_epi16(merge_sse2(first), merge_sse2(second)));
+	text += 32;
+	length -= 32;
+	decoded += 16;
+    }
+    return decoded;
+}
+#endif //HEX_DECODE_SSE2
+
+
+
+#if HEX_DECODE_AVX2
+///@brief Convert 32 characters to their digit values
+///@return Non-zero if all characters were valid hex digits
+__attribute__((target("avx2")))
+static inline int
+nibbles_avx2(
+    __m256i chars,		///< [in] Characters to convert
+    __m256i *values)		///< [out] Digit value in each byte
+{
+    const __m256i lower = _mm256_or_si256(chars, _mm256_set1_epi8(0x20));
+    const __m256i digit = _mm256_andnot_si256(
+	_mm256_cmpgt_epi8(chars, _mm256_set1_epi8('9')),
+	_mm256_cmpgt_epi8(chars, _mm256_set1_epi8('0' - 1)));
+    const __m256i alpha = _mm256_andnot_si256(
+	_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('f')),
+	_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)));
+
+    *values = _mm256_or_si256(
+	_mm256_and_si256(digit, _mm256_sub_epi8(chars, _mm256_set1_epi8('0'))),
+	_mm256_and_si256(alpha, _mm256_sub_epi8(lower, _mm256_set1_epi8('a' - 10))));
+    return _mm256_movemask_epi8(_mm256_or_si256(digit, alpha)) == -1;
+}
+
+
+
+/// Merge pairs of digit values into one byte in each 16-bit lane
+__attribute__((target("avx2")))
+static inline __m256i
+merge_avx2(__m256i values)
+{
+    return _mm256_or_si256(
+	_mm256_slli_epi16(_mm256_and_si256(values, _mm256_set1_epi16(0x00FF)), 4),
+	_mm256_srli_epi16(values, 8));
+}
+
+
+
+///@brief Decode contiguous digits with AVX2 instructions
+///@sa decode_run_function
+__attribute__((target("avx2")))
+static size_t
+decode_run_avx2(const char *text, size_t length, char *output, size_t max_length)
+{
+    __m256i first, second, packed;
+    size_t decoded = 0;
+
+    while (length >= 64 && max_length - decoded >= 32) {
+	if (! nibbles_avx2(_mm256_loadu_si256((const __m256i*) text), &first)
+	    || ! nibbles_avx2(_mm256_loadu_si256((const __m256i*) (text + 32)), &second)) break;
+	// Packing works within 128-bit lanes, so restore the quadword order afterwards
+	packed = _mm256_packus_epi16(merge_avx2(first), merge_avx2(second));
+	_mm256_storeu_si256((__m256i*) (output + decoded),
+			    _mm256_permute4x64_epi64(packed, 0xD8));
+	text += 64;
+	length -= 64;
+	decoded += 32;
+    }
+    // Finish with smaller blocks if possible
+    return decoded + decode_run_sse2(text, length, output + decoded, max_length - decoded);
+}
+#endif //HEX_DECODE_AVX2
+
+
+
+/// Choose the fastest block decoder supported by the processor
+static inline decode_run_function
+select_decode_run(void)
+{
+#if HEX_DECODE_AVX2
+    if (__builtin_cpu_supports("avx2")) return decode_run_avx2;
+#endif
+#if HEX_DECODE_SSE2
+    return decode_run_sse2;
+#else
+    return NULL;
+#endif
+}
+
+
+
+///@brief Decode hex text using the given block decoder for contiguous digits
+///@sa hex_decode()
+static ssize_t
+decode(const char *text, size_t length, char *output, size_t max_length, size_t *error_pos,
+       decode_run_function decode_run)		///< [in] Block decoder or NULL for scalar only
+{
+    size_t pos = 0, decoded = 0, retry = 0, backoff = BLOCK_RETRY, run;
+    int high, low;
+
+    while (pos < length) {
+	if (decode_run && pos >= retry) {
+	    run = decode_run(text + pos, length - pos, output + decoded, max_length - decoded);
+	    pos += 2 * run;
+	    decoded += run;
+	    if (pos == length) break;
+	    // Avoid probing every white-space character with another block,
+	    // and back off further while blocks keep failing
+	    if (run) backoff = BLOCK_RETRY;
+	    else if (backoff < BLOCK_RETRY_MAX) backoff *= 2;
+	    retry = pos + backoff;
+	}
+
+	// Single pairs at block boundaries, between white-space or before an error
+	high = hex_value(text[pos]);
+	if (high < 0 && isspace((unsigned char) text[pos])) {
+	    ++pos;
+	    continue;
+	}
+	low = high < 0 || pos + 1 == length ? -1 : hex_value(text[pos + 1]);
+	if (low < 0) {
+	    if (error_pos) *error_pos = high < 0 ? pos : pos + 1;
+	    return HEX_DECODE_INVALID;
+	} else if (decoded >= max_length) {
+	    if (error_pos) *error_pos = pos;
+	    return HEX_DECODE_TOO_LONG;
+	}
+	output[decoded++] = high << 4 | low;
+	pos += 2;
+    }
+    if (DEBUG) printf("%s: %zu characters to %zu bytes\n", __func__, length, decoded);
+    return decoded;
+}
+
+
+
+ssize_t
+hex_decode(const char *text, size_t length, char *output, size_t max_length, size_t *error_pos)
+{
+    if (! text || (max_length && ! output)) {
+	if (error_pos) *error_pos = 0;
+	return HEX_DECODE_INVALID;
+    }
+    return decode(text, length, output, max_length, error_pos, select_decode_run());
+}
+
+
+
+#ifdef TEST_HEX_DECODE
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/// Time elapsed since a previous timestamp, in seconds
+static double
+elapsed(const struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+
+
+/// Fill a buffer with random hex text, optionally separated and with errors
+static void
+random_text(char *text, size_t length, int separate, int corrupt)
+{
+    static const char digits[] = "0123456789abcdefABCDEF";
+    size_t i;
+
+    for (i = 0; i < length; ) {
+	if (separate && rand() % 4 == 0) text[i++] = " \t\n"[rand() % 3];
+	else {
+	    text[i++] = digits[rand() % (sizeof(digits) - 1)];
+	    if (i < length) text[i++] = digits[rand() % (sizeof(digits) - 1)];
+	}
+    }
+    if (corrupt && length) text[rand() % length] = "g/:@G`\xff x"[rand() % 9];
+}
+
+
+
+/// Compare all block decoders against the scalar one on random input
+static int
+verify_decoders(int rounds)
+{
+    const decode_run_function runs[] = {
+#if HEX_DECODE_SSE2
+	decode_run_sse2,
+#endif
+#if HEX_DECODE_AVX2
+	decode_run_avx2,
+#endif
+	NULL,
+    };
+    char text[300], expected[160], output[160];
+    size_t length, max_length, expected_pos, pos;
+    ssize_t expected_ret, ret;
+    int round, r, failed = 0;
+
+    for (round = 0; round < rounds; ++round) {
+	length = rand() % sizeof(text);
+	max_length = rand() % 4 == 0 ? rand() % sizeof(output) : sizeof(output);
+	random_text(text, length, rand() % 2, rand() % 4 == 0);
+	expected_pos = pos = 0;
+	expected_ret = decode(text, length, expected, max_length, &expected_pos, NULL);
+	for (r = 0; runs[r]; ++r) {
+#if HEX_DECODE_AVX2
+	    if (runs[r] == decode_run_avx2 && ! __builtin_cpu_supports("avx2")) continue;
+#endif
+	    ret = decode(text, length, output, max_length, &pos, runs[r]);
+	    if (ret != expected_ret || (ret < 0 && pos != expected_pos)
+		|| (ret > 0 && memcmp(output, expected, ret) != 0)) {
+		printf("Decoder %d mismatch: \"%.*s\" -> %zd / %zd (pos %zu / %zu)\n",
+		       r, (int) length, text, ret, expected_ret, pos, expected_pos);
+		++failed;
+	    }
+	}
+    }
+    printf("Verified %d random inputs, %d mismatches\n", rounds, failed);
+    return failed;
+}
+
+
+
+/// Measure decoding throughput for each available decoder
+static void
+benchmark_decoders(size_t bytes, int separate)
+{
+    struct {
+	const char *name;
+	decode_run_function run;
+    } variants[] = {
+	{ "scalar",	NULL },
+#if HEX_DECODE_SSE2
+	{ "SSE2",	decode_run_sse2 },
+#endif
+#if HEX_DECODE_AVX2
+	{ "AVX2",	decode_run_avx2 },
+#endif
+    };
+    struct timespec start;
+    char *text, *output;
+    double seconds;
+    ssize_t ret;
+    unsigned v;
+    int rep, reps = 20;
+
+    text = malloc(2 * bytes);
+    output = malloc(bytes);
+    if (! text || ! output) goto out;
+    random_text(text, 2 * bytes, separate, 0);
+
+    for (v = 0; v < sizeof(variants) / sizeof(*variants); ++v) {
+#if HEX_DECODE_AVX2
+	if (variants[v].run == decode_run_avx2 && ! __builtin_cpu_supports("avx2")) continue;
+#endif
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (rep = 0; rep < reps; ++rep) {
+	    ret = decode(text, 2 * bytes, output, bytes, NULL, variants[v].run);
+	}
+	seconds = elapsed(&start) / reps;
+	printf("%s %s: %zd bytes in %.3f ms, %.2f ns/byte, %.0f MB/s\n",
+	       separate ? "separated" : "contiguous", variants[v].name, ret,
+	       seconds * 1e3, seconds * 1e9 / ret, ret / seconds / 1e6);
+    }
+
+out:
+    free(text);
+    free(output);
+}
+
+
+
+int
+main(int argc, char **argv)
+{
+    const char sample[] = "4265 65\t46 zz";
+    char buf[8] = { 0 };
+    size_t error_pos = 0;
+    ssize_t ret;
+
+    ret = hex_decode(sample, strlen(sample), buf, sizeof(buf), &error_pos);
+    printf("[%s] -> %zd, error at %zu (`%c'), decoded \"%s\"\n",
+	   sample, ret, error_pos, sample[error_pos], buf);
+
+    srand(argc > 1 ? atoi(argv[1]) : 1);
+    if (verify_decoders(100000)) return 1;
+
+    benchmark_decoders(4 << 20, 0);
+    benchmark_decoders(1 << 20, 1);
+    return 0;
+}
+#endif
@@ -0,0 +1,50 @@
+///@file
+///@brief	Conversion of hexadecimal text to binary data
+///@copyright	Copyright (C) 2026  Andre Colomb
+///
+/// This file is part of elf-mangle.
+///
+/// This file is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU Lesser General Public License as
+/// published by the Free Software Foundation, either version 3 of the
+/// License, or (at your option) any later version.
+///
+/// elf-mangle is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+/// Lesser General Public License for more details.
+///
+/// You should have received a copy of the GNU Lesser General Public
+/// License along with this program.  If not, see
+/// <http://www.gnu.org/licenses/>.
+///
+///@author	Andre Colomb <src@andre.colomb.de>
+
+
+#ifndef HEX_DECODE_H_
+#define HEX_DECODE_H_
+
+#include <sys/types.h>
+
+
+/// Error code for an invalid or incomplete pair of hex digits
+#define HEX_DECODE_INVALID	-1
+/// Error code for more data than fits the output buffer
+#define HEX_DECODE_TOO_LONG	-2
+
+
+///@brief Decode bytes given as pairs of hexadecimal digits
+///@details Pairs may be separated by white-space or follow each other
+///         directly, but a pair must not be split.  Both upper and lower
+///         case digits are accepted.  Long runs of contiguous digits are
+///         decoded with SIMD instructions where the processor supports them.
+///@return Number of bytes decoded or negative error code
+ssize_t hex_decode(
+    const char *text,		///< [in] Hexadecimal text, need not be zero-terminated
+    size_t length,		///< [in] Number of characters to decode
+    char *output,		///< [out] Buffer to store decoded bytes
+    size_t max_length,		///< [in] Size of output buffer
+    size_t *error_pos		///< [out] Offset of offending character on error, may be NULL
+);
+
+#endif //HEX_DECODE_H_
@@ -0,0 +1,229 @@
+///@file
+///@brief	Sidecar files indexing the data records of Intel Hex images
+///@copyright	Copyright (C) 2026  Andre Colomb
+///
+/// This file is part of elf-mangle.
+///
+/// This file is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU Lesser General Public License as
+/// published by the Free Software Foundation, either version 3 of the
+/// License, or (at your option) any later version.
+///
+/// elf-mangle is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+/// Lesser General Public License for more details.
+///
+/// You should have received a copy of the GNU Lesser General Public
+/// License along with this program.  If not, see
+/// <http://www.gnu.org/licenses/>.
+///
+///@author	Andre Colomb <src@andre.colomb.de>
+
+
+#include "config.h"
+
+#include "ihex_index.h"
+#include "atomic_file.h"
+#include "intl.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+/// Compile diagnostic output messages?
+#define DEBUG 0
+
+
+
+///@brief Fill in the image file's size and modification time
+static void
+stamp_header(
+    ihex_index_header *header,	///< [out] Header to update
+    const struct stat *st)	///< [in] Status of the image file
+{
+    header->file_size = st->st_size;
+    header->mtime_sec = st->st_mtime;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    header->mtime_nsec = st->st_mtim.tv_nsec;
+#else
+    header->mtime_nsec = 0;
+#endif
+}
+
+
+
+char*
+ihex_index_name(const char *filename)
+{
+    char *name;
+
+    if (! filename) return NULL;
+    name = malloc(strlen(filename) + sizeof(IHEX_INDEX_SUFFIX));
+    if (! name) return NULL;
+    strcpy(name, filename);
+    strcat(name, IHEX_INDEX_SUFFIX);
+    return name;
+}
+
+
+
+uint64_t
+ihex_index_hash(uint64_t hash, const char *text, size_t length)
+{
+    while (length--) {
+	hash ^= (unsigned char) *text++;
+	hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+
+
+int
+ihex_index_add(ihex_index *index, size_t address, size_t length,
+	       const char *text, size_t text_offset, size_t text_length)
+{
+    ihex_index_block *block, *blocks;
+    uint32_t size;
+
+    if (! index || ! text) return -1;
+
+    block = index->header.num_blocks ? &index->blocks[index->header.num_blocks - 1] : NULL;
+    if (! block || block->address + block->length != address
+	|| block->text_offset + block->text_length != text_offset
+	|| block->text_length + text_length > IHEX_INDEX_BLOCK_TEXT) {
+	if (index->header.num_blocks >= index->size) {
+	    size = index->size < 8 ? 16 : index->size * 2;
+	    blocks = realloc(index->blocks, size * sizeof(*blocks));
+	    if (! blocks) return -3;
+	    index->blocks = blocks;
+	    index->size = size;
+	}
+	block = &index->blocks[index->header.num_blocks++];
+	block->address = address;
+	block->text_offset = text_offset;
+	block->length = 0;
+	block->text_length = 0;
+	block->hash = IHEX_INDEX_HASH_INIT;
+    }
+    block->length += length;
+    block->text_length += text_length;
+    block->hash = ihex_index_hash(block->hash, text + text_offset, text_length);
+    return 0;
+}
+
+
+
+///@brief Validate the header and blocks of an index read from file
+///@return Non-zero if the index describes the image file's current state
+static int
+check_index(
+    const ihex_index *index,	///< [in] Index read from file
+    const struct stat *st)	///< [in] Status of the image file
+{
+    ihex_index_header current;
+    const ihex_index_block *block;
+    uint64_t text_end = 0;
+
+    stamp_header(&current, st);
+    if (memcmp(index->header.magic, IHEX_INDEX_MAGIC, sizeof(IHEX_INDEX_MAGIC)) != 0
+	|| index->header.byte_order != IHEX_INDEX_BYTE_ORDER
+	|| index->header.version != IHEX_INDEX_VERSION
+	|| index->header.file_size != current.file_size
+	|| index->header.mtime_sec != current.mtime_sec
+	|| index->header.mtime_nsec != current.mtime_nsec) return 0;
+
+    // Blocks must lie within the image file, in ascending order
+    for (block = index->blocks; block < index->blocks + index->header.num_blocks; ++block) {
+	if (block->text_offset < text_end || block->text_offset > current.file_size
+	    || block->text_length > current.file_size - block->text_offset
+	    || block->address + block->length > index->header.end) return 0;
+	text_end = block->text_offset + block->text_length;
+    }
+    return 1;
+}
+
+
+
+int
+ihex_index_read(const char *index_name, const struct stat *st, ihex_index *index)
+{
+    struct stat index_st;
+    FILE *in;
+    int valid = 0;
+
+    if (! index_name || ! st || ! index) return -1;
+    memset(index, 0, sizeof(*index));
+
+    in = fopen(index_name, "rb");
+    if (! in) return 0;		//not yet built
+
+    if (fstat(fileno(in), &index_st) == 0
+	&& fread(&index->header, sizeof(index->header), 1, in) == 1
+	&& (uint64_t) index_st.st_size == sizeof(index->header)
+	+ (uint64_t) index->header.num_blocks * sizeof(*index->blocks)) {
+	index->blocks = malloc((index->header.num_blocks ? index->header.num_blocks : 1)
+			       * sizeof(*index->blocks));
+	if (! index->blocks) valid = -3;
+	else if (fread(index->blocks, sizeof(*index->blocks), index->header.num_blocks, in)
+		 == index->header.num_blocks) {
+	    index->size = index->header.num_blocks;
+	    valid = check_index(index, st);
+	}
+    }
+    fclose(in);
+
+    if (DEBUG) printf("%s: %s with %u blocks, %s\n", __func__, index_name,
+		      index->header.num_blocks, valid > 0 ? "valid" : "not used");
+    if (valid <= 0) ihex_index_free(index);
+    return valid;
+}
+
+
+
+///@brief Output the index header and blocks to an open stream
+///@return Zero on success or negative error code
+static int
+write_index(
+    FILE *out,			///< [in] Output file stream
+    const void *arg)		///< [in] Index with complete header
+{
+    const ihex_index *index = arg;
+
+    if (fwrite(&index->header, sizeof(index->header), 1, out) != 1
+	|| fwrite(index->blocks, sizeof(*index->blocks), index->header.num_blocks, out)
+	!= index->header.num_blocks) return -2;
+    return 0;
+}
+
+
+
+int
+ihex_index_write(const char *index_name, const struct stat *st, ihex_index *index)
+{
+    int status;
+
+    if (! index_name || ! st || ! index) return -1;
+
+    memcpy(index->header.magic, IHEX_INDEX_MAGIC, sizeof(IHEX_INDEX_MAGIC));
+    index->header.byte_order = IHEX_INDEX_BYTE_ORDER;
+    index->header.version = IHEX_INDEX_VERSION;
+    index->header.reserved = 0;
+    stamp_header(&index->header, st);
+
+    status = atomic_file_write(index_name, _("index file"), write_index, index);
+    if (DEBUG) printf("%s: %u blocks -> %s (%d)\n", __func__,
+		      index->header.num_blocks, index_name, status);
+    return status;
+}
+
+
+
+void
+ihex_index_free(ihex_index *index)
+{
+    if (! index) return;
+    free(index->blocks);
+    memset(index, 0, sizeof(*index));
+}
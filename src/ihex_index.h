@@ -0,0 +1,151 @@
+///@file
+///@brief	Sidecar files indexing the data records of Intel Hex images
+///@copyright	Copyright (C) 2026  Andre Colomb
+///
+/// This file is part of elf-mangle.
+///
+/// This file is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU Lesser General Public License as
+/// published by the Free Software Foundation, either version 3 of the
+/// License, or (at your option) any later version.
+///
+/// elf-mangle is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+/// Lesser General Public License for more details.
+///
+/// You should have received a copy of the GNU Lesser General Public
+/// License along with this program.  If not, see
+/// <http://www.gnu.org/licenses/>.
+///
+///@author	Andre Colomb <src@andre.colomb.de>
+
+
+#ifndef IHEX_INDEX_H_
+#define IHEX_INDEX_H_
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+/// Identification at the start of every index file
+#define IHEX_INDEX_MAGIC	"ELFMIHX"
+/// Format revision, incremented on any incompatible change
+#define IHEX_INDEX_VERSION	1
+/// Marker to detect files written on a host with different byte order
+#define IHEX_INDEX_BYTE_ORDER	0x01020304U
+/// Appended to the image file name to form the index file name
+#define IHEX_INDEX_SUFFIX	".idx"
+/// Maximum amount of record text described by one block
+#define IHEX_INDEX_BLOCK_TEXT	4096
+/// Initial value for hashing the text of a block
+#define IHEX_INDEX_HASH_INIT	14695981039346656037ULL
+
+
+/// File header of a record index.
+///
+/// All values are stored in the writing host's byte order.  The header is
+/// directly followed by the block records, in the order of their text
+/// within the image file.
+typedef struct ihex_index_header {
+    /// Identification string including NUL terminator
+    char		magic[8];
+    /// Byte order marker, must equal IHEX_INDEX_BYTE_ORDER
+    uint32_t		byte_order;
+    /// Format revision, must equal IHEX_INDEX_VERSION
+    uint32_t		version;
+    /// Size of the indexed image file in bytes
+    uint64_t		file_size;
+    /// Modification time of the indexed image file, seconds part
+    int64_t		mtime_sec;
+    /// Modification time of the indexed image file, nanoseconds part
+    int64_t		mtime_nsec;
+    /// Highest data address in the image file plus one
+    uint64_t		end;
+    /// Number of block records
+    uint32_t		num_blocks;
+    /// Unused, for alignment
+    uint32_t		reserved;
+} ihex_index_header;
+
+/// Record describing consecutive data records with contiguous addresses
+typedef struct ihex_index_block {
+    /// Absolute address of the first data byte
+    uint64_t		address;
+    /// Location of the first record's text within the image file
+    uint64_t		text_offset;
+    /// Number of data bytes in all records
+    uint32_t		length;
+    /// Size of the records' text including line endings
+    uint32_t		text_length;
+    /// FNV-1a hash value of the records' text
+    uint64_t		hash;
+} ihex_index_block;
+
+/// Record index of one image file in memory
+typedef struct ihex_index {
+    /// File header, also used while building
+    ihex_index_header	header;
+    /// Block records in file order
+    ihex_index_block*	blocks;
+    /// Number of block records allocated
+    uint32_t		size;
+} ihex_index;
+
+
+///@brief Derive the index file name for an image file
+///@return Newly allocated file name or NULL on error
+char* ihex_index_name(
+    const char *filename	///< [in] Image file name
+);
+
+///@brief Continue hashing block text
+///@return Updated hash value
+uint64_t ihex_index_hash(
+    uint64_t hash,		///< [in] Hash value so far or IHEX_INDEX_HASH_INIT
+    const char *text,		///< [in] Text to hash
+    size_t length		///< [in] Number of characters
+);
+
+///@brief Describe one data record in the index
+///@details The last block is extended if the record's text and addresses
+///         directly follow it, otherwise a new block is started.
+///@return Zero on success or negative error code
+int ihex_index_add(
+    ihex_index *index,		///< [in,out] Index being built
+    size_t address,		///< [in] Absolute address of the record's data
+    size_t length,		///< [in] Number of data bytes
+    const char *text,		///< [in] Start of the image file text
+    size_t text_offset,		///< [in] Location of the record's line
+    size_t text_length		///< [in] Size of the line including line ending
+);
+
+///@brief Read the index of an image file if it is up to date
+///@details The index must match the image file's current size and
+///         modification time.  Missing or outdated index files are ignored.
+///@return 1 if the index is valid, zero if not available or negative
+///        error code
+int ihex_index_read(
+    const char *index_name,	///< [in] Index file path to open
+    const struct stat *st,	///< [in] Status of the image file
+    ihex_index *index		///< [out] Index to fill, release with ihex_index_free()
+);
+
+///@brief Write an index describing the given image file status
+///@details The file is replaced atomically, so concurrent readers never see
+///         a partially written index.
+///@return Zero on success or negative error code
+int ihex_index_write(
+    const char *index_name,	///< [in] Index file path to write
+    const struct stat *st,	///< [in] Status of the indexed image file
+    ihex_index *index		///< [in,out] Index to store, header is completed
+);
+
+///@brief Release the memory allocated for an index
+void ihex_index_free(
+    ihex_index *index		///< [in,out] Index to reset
+);
+
+#endif //IHEX_INDEX_H_
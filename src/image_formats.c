@@ -1,6 +1,6 @@
 ///@file
 ///@brief	Handling of different binary image formats
-///@copyright	Copyright (C) 2014, 2015, 2016, 2023  Andre Colomb
+///@copyright	Copyright (C) 2014, 2015, 2016, 2023, 2026  Andre Colomb
 ///
 /// This file is part of elf-mangle.
 ///
@@ -26,9 +26,13 @@
 #include "image_formats.h"
 #include "image_ihex.h"
 #include "image_raw.h"
+#include "image_ranges.h"
 #include "intl.h"
 
 #include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
 
 /// Compile diagnostic output messages?
 #define DEBUG 0
@@ -36,18 +40,19 @@
 
 
 int
-image_memorize_file(const char *filename,
-		    const char **blob, size_t *blob_size,
-		    enum image_format format)
+image_read_ranges(const char *filename,
+		  image_ranges *ranges,
+		  enum image_format format)
 {
+    const char *blob;
+    size_t blob_size;
     int status = 0;
 
-    if (! filename || ! blob || ! blob_size) return -1;
+    if (! filename || ! ranges) return -1;
 
     if (format == formatNone ||
 	format == formatIntelHex) {
-#if HAVE_INTELHEX
-	status = image_ihex_memorize_file(filename, blob, blob_size);
+	status = image_ihex_read_ranges(filename, ranges);
 	if (status != 0) return status;
 	// Retry with raw binary on failure
 	else if (format == formatNone) {
@@ -56,13 +61,17 @@ image_memorize_file(const char *filename,
 		    filename);
 	    format = formatRawBinary;
 	}
-#else // !HAVE_INTELHEX
-	format = formatRawBinary;
-#endif
     }
 
     if (format == formatRawBinary) {
-	status = image_raw_memorize_file(filename, blob, blob_size);
+	status = image_raw_memorize_file(filename, &blob, &blob_size);
+	if (status <= 0) return status;
+	if (image_ranges_add(ranges, 0, blob_size, blob) != 0) {
+	    fprintf(stderr, _("Could not allocate memory for image data: %s\n"),
+		    strerror(errno));
+	    status = -3;
+	}
+	free((char*) blob);
 	return status;
     }
 
@@ -75,7 +84,7 @@ image_memorize_file(const char *filename,
 int
 image_merge_file(const char *filename,
 		 const nvm_symbol *list, const int list_size,
-		 const size_t blob_size,
+		 const size_t blob_size, const size_t load_address,
 		 enum image_format format)
 {
     int symbols = 0;
@@ -84,8 +93,7 @@ image_merge_file(const char *filename,
 
     if (format == formatNone ||
 	format == formatIntelHex) {
-#if HAVE_INTELHEX
-	symbols = image_ihex_merge_file(filename, list, list_size, blob_size);
+	symbols = image_ihex_merge_file(filename, list, list_size, blob_size, load_address);
 	if (symbols != 0) return symbols;
 	// Retry with raw binary on failure
 	else if (format == formatNone) {
@@ -94,9 +102,6 @@ image_merge_file(const char *filename,
 		    filename);
 	    format = formatRawBinary;
 	}
-#else // !HAVE_INTELHEX
-	format = formatRawBinary;
-#endif
     }
 
     if (format == formatRawBinary) {
@@ -1,6 +1,6 @@
 ///@file
 ///@brief	Handling of different binary image formats
-///@copyright	Copyright (C) 2014, 2016, 2023  Andre Colomb
+///@copyright	Copyright (C) 2014, 2016, 2023, 2026  Andre Colomb
 ///
 /// This file is part of elf-mangle.
 ///
@@ -30,6 +30,7 @@
 
 // Forward declarations
 typedef struct nvm_symbol nvm_symbol;
+typedef struct image_ranges image_ranges;
 
 
 /// Options controlling the format of an image file
@@ -40,12 +41,12 @@ enum image_format {
 };
 
 
-///@brief Open image file and store contents in memory
+///@brief Open image file and collect its populated address ranges
+///@details Raw binary files form a single range starting at address zero.
 ///@return 1 on success or negative error code
-int image_memorize_file(
+int image_read_ranges(
     const char *filename,	///< [in] Input file path to open
-    const char **blob,		///< [out] Binary data content
-    size_t *blob_size,		///< [out] Data address at end of content
+    image_ranges *ranges,	///< [out] Populated ranges, sorted by address
     enum image_format format	///< [in] Expected input format
 );
 
@@ -56,6 +57,7 @@ int image_merge_file(
     const nvm_symbol *list,	///< [in] Symbol list start address
     int list_size,		///< [in] Number of symbols in list
     size_t blob_size,		///< [in] Expected data size in the image
+    size_t load_address,	///< [in] Load address of the section's data
     enum image_format format	///< [in] Expected input format
 );
 
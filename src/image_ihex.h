@@ -1,6 +1,6 @@
 ///@file
 ///@brief	Handle input and output of blob data to Intel Hex files
-///@copyright	Copyright (C) 2014, 2016, 2023  Andre Colomb
+///@copyright	Copyright (C) 2014, 2016, 2023, 2026  Andre Colomb
 ///
 /// This file is part of elf-mangle.
 ///
@@ -28,25 +28,89 @@
 #include <stddef.h>
 
 
+/// Number of data bytes in each Intel Hex record unless configured otherwise
+#define IHEX_DEFAULT_RECORD_LENGTH	0x20
+/// Maximum number of data bytes in an Intel Hex record
+#define IHEX_MAX_RECORD_LENGTH		0xFF
+
+
 // Forward declarations
 typedef struct nvm_symbol nvm_symbol;
+typedef struct image_ranges image_ranges;
+
+
+/// Relation of Intel Hex input addresses to the section's load address
+enum ihex_addressing {
+    addressingAuto	= 0,	///< Absolute if no data lies below the load address
+    addressingRelative	= 1,	///< Section data always starts at address zero
+    addressingAbsolute	= 2,	///< Section data always starts at the load address
+};
 
 
-///@brief Open Intel Hex image file and store contents in memory
-///@return 1 on success or negative error code
-int image_ihex_memorize_file(
+///@brief Open Intel Hex image file and collect its populated address ranges
+///@details Memory is only needed for the data actually contained in the file,
+///         regardless of the addresses used.
+///@return 1 on success, zero if the file is not in Intel Hex format or
+///        negative error code
+int image_ihex_read_ranges(
     const char *filename,	///< [in] Input file path to open
-    const char **blob,		///< [out] Binary data content
-    size_t *blob_size		///< [out] Data address at end of content
+    image_ranges *ranges	///< [out] Populated ranges, sorted by address
 );
 
 ///@brief Open Intel Hex image file and update each listed symbol's content
-///@return Number of symbols successfully read or negative error code
+///@details Records are parsed one by one, validating their checksums.  Only
+///         data within the section's address window is kept and then copied
+///         to the overlapping symbols.  The window starts at address zero or
+///         the section's load address, see image_ihex_addressing().  Gaps
+///         within the file's address range read as zero bytes.
+///@return Number of symbols successfully read, zero if the file is not in
+///        Intel Hex format or negative error code
 int image_ihex_merge_file(
     const char *filename,	///< [in] Input file path to open
     const nvm_symbol *list,	///< [in] Symbol list start address
     int list_size,		///< [in] Number of symbols in list
-    size_t blob_size		///< [in] Expected data size in the image
+    size_t blob_size,		///< [in] Expected data size in the image
+    size_t load_address		///< [in] Load address of the section's data
+);
+
+///@brief Set up parallel decoding of large Intel Hex input files
+///@details Memory mapped files of several megabytes are split into chunks of
+///         lines, each decoded by a separate thread.  The data is merged in
+///         file order afterwards.
+void image_ihex_read_threads(
+    int threads			///< [in] Maximum number of threads to use
+);
+
+///@brief Set up reading Intel Hex input files through a record index
+///@details A sidecar file next to each merged image, named like the image
+///         plus IHEX_INDEX_SUFFIX, locates the data records by address.  It is
+///         written after reading a whole file and used on later runs to read
+///         only the records overlapping any symbol, as long as the image's size
+///         and modification time are unchanged.
+void image_ihex_read_index(
+    int enable			///< [in] Non-zero to use and write index files
+);
+
+///@brief Choose where the section's data starts within Intel Hex input files
+///@details By default, files without any data below the section's load address
+///         are read with absolute addresses, which is reported.  Others start
+///         at address zero, like the section-relative AVR EEPROM images.
+void image_ihex_addressing(
+    enum ihex_addressing mode	///< [in] Address interpretation to use
+);
+
+///@brief Set the number of data bytes in each written record
+///@details Values outside the valid range select the default length.
+void image_ihex_record_length(
+    size_t length		///< [in] Data bytes per record, up to IHEX_MAX_RECORD_LENGTH
+);
+
+///@brief Set up parallel encoding of large Intel Hex images
+///@details Images of several 64 KiB segments are split into consecutive
+///         chunks, each encoded by a separate thread and written in order.
+///         Small images are always encoded sequentially.
+void image_ihex_write_threads(
+    int threads			///< [in] Maximum number of threads to use
 );
 
 ///@brief Write blob data to Intel Hex image file
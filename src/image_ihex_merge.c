@@ -0,0 +1,1314 @@
+///@file
+///@brief	Read Intel Hex files into populated address ranges and symbols
+///@copyright	Copyright (C) 2026  Andre Colomb
+///
+/// This file is part of elf-mangle.
+///
+/// This file is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU Lesser General Public License as
+/// published by the Free Software Foundation, either version 3 of the
+/// License, or (at your option) any later version.
+///
+/// elf-mangle is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+/// Lesser General Public License for more details.
+///
+/// You should have received a copy of the GNU Lesser General Public
+/// License along with this program.  If not, see
+/// <http://www.gnu.org/licenses/>.
+///
+///@author	Andre Colomb <src@andre.colomb.de>
+
+
+
+#include "config.h"
+
+#include "image_ihex.h"
+#include "image_ranges.h"
+#include "ihex_index.h"
+#include "hex_decode.h"
+#include "symbol_list.h"
+#include "intl.h"
+
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
+#include <sys/stat.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <stdint.h>
+#include <inttypes.h>
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/// Compile diagnostic output messages?
+#define DEBUG 0
+
+// Default to stream-based implementation
+#ifndef HAVE_MMAP
+#define HAVE_MMAP 0
+#endif
+
+/// Record type for data bytes
+#define REC_DATA		0x00
+/// Record type marking the end of file
+#define REC_EOF			0x01
+/// Record type for an Extended Segment Address
+#define REC_ESA			0x02
+/// Record type for a Start Segment Address
+#define REC_SSA			0x03
+/// Record type for an Extended Linear Address
+#define REC_ELA			0x04
+/// Record type for a Start Linear Address
+#define REC_SLA			0x05
+/// Bytes in a record besides its data: length, offset, type and checksum
+#define RECORD_OVERHEAD		5
+/// Minimum amount of text for each thread to decode
+#define CHUNK_MIN_TEXT		(1024 * 1024)
+/// Upper limit for parallel threads decoding a file
+#define MAX_READ_THREADS	64
+/// Largest gap between indexed blocks of interest to read through at once
+#define INDEX_READ_GAP		4096
+
+
+
+/// Symbols sorted by offset to locate the destinations of record data
+typedef struct merge_index {
+    /// Symbols with a storage address, in ascending offset order
+    const nvm_symbol**	sorted;
+    /// Highest end offset of any symbol up to the same position
+    size_t*		reach;
+    /// Number of sorted symbols
+    int			count;
+    /// Expected data size in the image, nothing is merged beyond
+    size_t		limit;
+    /// Position found by the last lookup, records usually ascend
+    int			cursor;
+} merge_index;
+
+/// Address windows of interest while reading a file
+typedef struct read_window {
+    /// Start of the second window, the first one always starts at zero
+    size_t		base;
+    /// Size of both windows, SIZE_MAX to keep all data
+    size_t		size;
+} read_window;
+
+/// Single decoded Intel Hex record
+typedef struct ihex_record {
+    /// Number of data bytes
+    uint8_t		length;
+    /// Load offset of the data within the current segment
+    uint16_t		offset;
+    /// Record type
+    uint8_t		type;
+    /// Information or data bytes
+    const unsigned char* data;
+} ihex_record;
+
+/// Consecutive lines of a memory mapped file, decoded by one thread
+typedef struct merge_chunk {
+    /// Start of the first line
+    const char*		text;
+    /// End of the last line
+    const char*		end;
+    /// Address base in effect at the first line, from the prefix pass
+    size_t		base;
+    /// Line number of the first line
+    int			first_line;
+    /// Address windows of the data to keep
+    const read_window*	window;
+    /// Data within the windows, in file order
+    image_ranges	ranges;
+    /// Number of valid records decoded
+    int			valid;
+    /// Highest data address plus one
+    size_t		high;
+    /// Lowest data address, SIZE_MAX if no data found
+    size_t		low;
+    /// End-of-file record found?
+    char		eof;
+    /// Error message for the first invalid record, NULL if none
+    const char*		errmsg;
+    /// Line number of the last line decoded, or the invalid one
+    int			last_line;
+    /// Zero on success or negative error code
+    int			status;
+} merge_chunk;
+
+/// Number of threads to decode large files with
+static int read_threads = 1;
+
+/// Use sidecar record index files to read only the needed records?
+static char use_index = 0;
+
+/// How data addresses relate to the section's load address
+static enum ihex_addressing addressing = addressingAuto;
+
+
+
+void
+image_ihex_read_threads(int threads)
+{
+    read_threads = threads < 1 ? 1 : threads;
+}
+
+
+
+void
+image_ihex_read_index(int enable)
+{
+    use_index = enable != 0;
+}
+
+
+
+void
+image_ihex_addressing(enum ihex_addressing mode)
+{
+    addressing = mode;
+}
+
+
+
+///@brief Find the next line feed character
+///@return Address of the line feed or end of text if none found
+static const char*
+find_newline(
+    const char *text,		///< [in] Start of text to search
+    const char *end)		///< [in] End of text
+{
+#if defined(__SSE2__)
+    const __m128i newline = _mm_set1_epi8('\n');
+    int mask;
+
+    // Compare sixteen characters at once, lines are usually short
+    for (; end - text >= 16; text += 16) {
+	mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) text),
+						newline));
+	if (mask) return text + __builtin_ctz(mask);
+    }
+#endif
+    text = memchr(text, '\n', end - text);
+    return text ? text : end;
+}
+
+
+
+///@brief Sum up bytes modulo 256
+///@return Checksum of all bytes, zero for a valid record
+static uint8_t
+checksum(
+    const unsigned char *bytes,	///< [in] Decoded record bytes
+    size_t length)		///< [in] Number of bytes
+{
+    unsigned sum = 0;
+#if defined(__SSE2__)
+    __m128i total = _mm_setzero_si128();
+
+    for (; length >= 16; bytes += 16, length -= 16) {
+	total = _mm_add_epi64(total, _mm_sad_epu8(_mm_loadu_si128((const __m128i*) bytes),
+						  _mm_setzero_si128()));
+    }
+    sum = _mm_cvtsi128_si32(total) + _mm_cvtsi128_si32(_mm_srli_si128(total, 8));
+#endif
+    while (length--) sum += *bytes++;
+    return sum;
+}
+
+
+
+///@brief Compare two symbols by offset for qsort()
+///@return Negative, zero or positive for ascending order
+static int
+compare_offset(const void *a, const void *b)
+{
+    const nvm_symbol *sa = *(const nvm_symbol* const*) a, *sb = *(const nvm_symbol* const*) b;
+
+    return (sa->offset > sb->offset) - (sa->offset < sb->offset);
+}
+
+
+
+///@brief Sort the symbols with storage by offset
+///@return Zero on success or negative error code
+static int
+build_index(
+    merge_index *index,		///< [out] Index to set up
+    const nvm_symbol *list,	///< [in] Symbol list start address
+    int list_size,		///< [in] Number of symbols in list
+    size_t limit)		///< [in] Expected data size in the image
+{
+    const nvm_symbol *symbol;
+    size_t end;
+    int i;
+
+    index->count = 0;
+    index->limit = limit;
+    index->cursor = 0;
+    index->sorted = malloc((list_size > 0 ? list_size : 1) * sizeof(*index->sorted));
+    index->reach = malloc((list_size > 0 ? list_size : 1) * sizeof(*index->reach));
+    if (! index->sorted || ! index->reach) return -3;
+
+    for (symbol = list; symbol < list + list_size; ++symbol) {
+	if (symbol->blob_address && symbol->size) index->sorted[index->count++] = symbol;
+    }
+    qsort(index->sorted, index->count, sizeof(*index->sorted), compare_offset);
+    // Symbols may overlap, so keep track of the furthest end seen so far
+    for (i = 0, end = 0; i < index->count; ++i) {
+	if (end < index->sorted[i]->offset + index->sorted[i]->size) {
+	    end = index->sorted[i]->offset + index->sorted[i]->size;
+	}
+	index->reach[i] = end;
+    }
+    return 0;
+}
+
+
+
+///@brief Copy data or zeros into all symbols overlapping an address range
+static void
+merge_range(
+    merge_index *index,		///< [in,out] Sorted symbols
+    size_t address,		///< [in] Start address of the range
+    size_t length,		///< [in] Number of bytes in the range
+    const unsigned char *data)	///< [in] Data to copy or NULL to clear
+{
+    const nvm_symbol *symbol;
+    size_t start, end;
+    int low = 0, high = index->count, i;
+
+    if (address >= index->limit || length == 0) return;
+    if (length > index->limit - address) length = index->limit - address;
+
+    // Find the first symbol reaching beyond the range start, usually close
+    // after the one found for the previous record
+    if (index->cursor == 0 || index->reach[index->cursor - 1] <= address) {
+	low = index->cursor;
+	for (i = 0; i < 4 && low < index->count && index->reach[low] <= address; ++i) ++low;
+    } else high = index->cursor;
+    while (low < high) {
+	i = low + (high - low) / 2;
+	if (index->reach[i] > address) high = i;
+	else low = i + 1;
+    }
+    index->cursor = low;
+    for (i = low; i < index->count && index->sorted[i]->offset < address + length; ++i) {
+	symbol = index->sorted[i];
+	if (symbol->offset + symbol->size <= address) continue;
+	start = symbol->offset > address ? symbol->offset : address;
+	end = symbol->offset + symbol->size < address + length
+	    ? symbol->offset + symbol->size : address + length;
+	if (data) memcpy(symbol->blob_address + (start - symbol->offset),
+			 data + (start - address), end - start);
+	else memset(symbol->blob_address + (start - symbol->offset), 0, end - start);
+    }
+}
+
+
+
+///@brief Decode and validate one line of text as Intel Hex record
+///@return NULL on success or an error message
+static const char*
+parse_record(
+    const char *line,		///< [in] Line of text without line ending
+    size_t length,		///< [in] Number of characters in line
+    unsigned char *buffer,	///< [out] Storage for decoded bytes
+    ihex_record *record)	///< [out] Decoded record fields
+{
+    ssize_t decoded;
+
+    if (length < 1 || line[0] != ':') return _("missing start code");
+    decoded = hex_decode(line + 1, length - 1, (char*) buffer,
+			 RECORD_OVERHEAD + IHEX_MAX_RECORD_LENGTH, NULL);
+    // Reject white-space between digit pairs, accepted by hex_decode()
+    if (decoded < RECORD_OVERHEAD || (size_t) decoded * 2 != length - 1) {
+	return _("invalid hex digits");
+    }
+    if (buffer[0] + RECORD_OVERHEAD != decoded) return _("wrong record length");
+    if (checksum(buffer, decoded)) return _("incorrect checksum");
+
+    record->length = buffer[0];
+    record->offset = (buffer[1] << 8) | buffer[2];
+    record->type = buffer[3];
+    record->data = buffer + 4;
+    switch (record->type) {
+    case REC_DATA:
+	return NULL;
+    case REC_EOF:
+	return record->length == 0 ? NULL : _("wrong record length");
+    case REC_ESA:
+    case REC_ELA:
+	return record->length == 2 ? NULL : _("wrong record length");
+    case REC_SSA:
+    case REC_SLA:
+	return record->length == 4 ? NULL : _("wrong record length");
+    default:
+	return _("unknown record type");
+    }
+}
+
+
+
+///@brief Merge one data record into the symbols it overlaps
+///@details Symbol content between the highest address seen so far and the
+///         end of this record is cleared before the data is copied, so gaps
+///         within the file's data range read as zero bytes.
+static void
+merge_data(
+    merge_index *index,		///< [in,out] Sorted symbols to merge into
+    size_t *high,		///< [in,out] Highest data address plus one so far
+    size_t address,		///< [in] Absolute address of the data
+    size_t length,		///< [in] Number of data bytes
+    const unsigned char *data)	///< [in] Data bytes
+{
+    if (DEBUG) printf("%s: %zu bytes at 0x%04zx\n", __func__, length, address);
+    if (address + length > *high) {
+	// Only the gap before this record needs clearing
+	if (address > *high) merge_range(index, *high, address - *high, NULL);
+	*high = address + length;
+    }
+    merge_range(index, address, length, data);
+}
+
+
+
+///@brief Check the outcome of parsing a whole file
+///@return Highest data address plus one, zero if not in Intel Hex format or
+///        negative error code
+static ssize_t
+check_merged(
+    const char *filename,	///< [in] File name for error messages
+    int records,		///< [in] Number of valid records parsed
+    int eof,			///< [in] End-of-file record found?
+    int line_number,		///< [in] Number of the last line parsed
+    size_t high)		///< [in] Highest data address plus one
+{
+    if (records == 0) return 0;
+    if (! eof) {
+	fprintf(stderr, _("%s:%d: Missing Intel Hex end-of-file record\n"),
+		filename, line_number);
+	return -4;
+    }
+    if (high == 0) {
+	fprintf(stderr, _("Image file \"%s\" is empty\n"), filename);
+	return -4;
+    }
+    return high;
+}
+
+
+
+///@brief Check whether data overlaps one of the address windows of interest
+///@return Non-zero if any byte lies within a window
+static inline int
+in_window(
+    const read_window *window,	///< [in] Address windows
+    size_t address,		///< [in] Absolute address of the data
+    size_t length)		///< [in] Number of data bytes
+{
+    if (address < window->size) return 1;
+    return address + length > window->base
+	&& (address < window->base || address - window->base < window->size);
+}
+
+
+
+///@brief Choose where the section's data starts within the file's addresses
+///@details Unless configured otherwise, files without any data below the
+///         section's load address are taken to use absolute addresses, so
+///         the window starts there.  Others, like AVR EEPROM images, start at
+///         address zero.
+///@return Address corresponding to the start of the section
+static inline size_t
+window_base(
+    size_t low,			///< [in] Lowest data address in the file
+    size_t load_address)	///< [in] Load address of the section
+{
+    switch (addressing) {
+    case addressingRelative:
+	return 0;
+    case addressingAbsolute:
+	return load_address;
+    default:
+	return low >= load_address ? load_address : 0;
+    }
+}
+
+
+
+///@brief Parse records from an open stream and keep the data within the windows
+///@return Highest data address plus one, zero if not in Intel Hex format or
+///        negative error code
+static ssize_t
+read_stream(
+    FILE *in,			///< [in] Stream opened for reading
+    const char *filename,	///< [in] File name for error messages
+    const read_window *window,	///< [in] Address windows of the data to keep
+    image_ranges *ranges,	///< [in,out] Populated ranges to extend
+    size_t *low)		///< [out] Lowest data address, SIZE_MAX if none
+{
+    unsigned char buffer[RECORD_OVERHEAD + IHEX_MAX_RECORD_LENGTH];
+    ihex_record record;
+    const char *errmsg;
+    char *line = NULL;
+    size_t line_size = 0, base = 0, high = 0, address;
+    ssize_t length;
+    int line_number = 0, records = 0, eof = 0;
+
+    *low = SIZE_MAX;
+    while (! eof && (length = getline(&line, &line_size, in)) != -1) {
+	++line_number;
+	while (length > 0 && strchr(" \t\r\n", line[length - 1])) --length;
+	if (length == 0) continue;
+
+	errmsg = parse_record(line, length, buffer, &record);
+	if (errmsg) {
+	    free(line);
+	    // Only a file starting with a valid record is treated as Intel Hex
+	    if (records == 0) return 0;
+	    fprintf(stderr, _("%s:%d: Invalid Intel Hex record (%s)\n"),
+		    filename, line_number, errmsg);
+	    return -4;
+	}
+	++records;
+
+	switch (record.type) {
+	case REC_DATA:
+	    address = base + record.offset;
+	    if (address + record.length > high) high = address + record.length;
+	    if (record.length && address < *low) *low = address;
+	    if (in_window(window, address, record.length)
+		&& image_ranges_add(ranges, address, record.length, record.data) != 0) {
+		free(line);
+		return -3;
+	    }
+	    break;
+	case REC_EOF:
+	    eof = 1;
+	    break;
+	case REC_ESA:
+	    base = (size_t) ((record.data[0] << 8) | record.data[1]) << 4;
+	    break;
+	case REC_ELA:
+	    base = (size_t) ((record.data[0] << 8) | record.data[1]) << 16;
+	    break;
+	}
+    }
+    free(line);
+
+    return check_merged(filename, records, eof, line_number, high);
+}
+
+
+
+#if HAVE_MMAP
+///@brief Split mapped text into chunks at line boundaries
+///@details This sequential prefix pass only looks at each line's record type,
+///         to resolve the address base in effect at the start of each chunk.
+///         Records are fully validated later when decoding the chunks.
+static void
+split_chunks(
+    const char *text,		///< [in] Mapped file content
+    size_t size,		///< [in] Size of the text
+    merge_chunk chunks[],	///< [out] Chunks to set up
+    int num_chunks)		///< [in] Number of chunks
+{
+    const char *line, *next, *end = text + size;
+    unsigned char address[2];
+    size_t base = 0;
+    int chunk = 1, line_number = 1;
+
+    chunks[0].text = text;
+    chunks[0].base = 0;
+    chunks[0].first_line = 1;
+    for (line = text; line < end; line = next, ++line_number) {
+	next = find_newline(line, end);
+	if (next < end) ++next;
+	for (; chunk < num_chunks && line >= text + size / num_chunks * chunk; ++chunk) {
+	    chunks[chunk - 1].end = chunks[chunk].text = line;
+	    chunks[chunk].base = base;
+	    chunks[chunk].first_line = line_number;
+	}
+	// Extended address records carry a base address in big-endian order
+	if (next - line >= 13 && line[0] == ':' && line[7] == '0'
+	    && (line[8] == '2' || line[8] == '4')
+	    && hex_decode(line + 9, 4, (char*) address, sizeof(address), NULL) == 2) {
+	    base = (size_t) ((address[0] << 8) | address[1]) << (line[8] == '2' ? 4 : 16);
+	}
+    }
+    for (; chunk < num_chunks; ++chunk) {
+	chunks[chunk - 1].end = chunks[chunk].text = end;
+	chunks[chunk].base = base;
+	chunks[chunk].first_line = line_number;
+    }
+    chunks[num_chunks - 1].end = end;
+}
+
+
+
+///@brief Reserve space for the data kept from a chunk
+///@details Estimated from the window size and the amount of text, which needs
+///         at least two characters per byte.  The buffer grows as needed.
+///@return Zero on success or negative error code
+static int
+reserve_data(
+    merge_chunk *chunk)		///< [in,out] Chunk to decode
+{
+    size_t data = (chunk->end - chunk->text) / 2;
+
+    if (chunk->window->size < data / 2) data = chunk->window->size * 2;
+    return image_ranges_reserve(&chunk->ranges, 16, data + 1024);
+}
+
+
+
+///@brief Decode and validate all records of a chunk
+///@details Only data records overlapping the address windows are kept.
+///@return Always NULL, results are stored in the chunk
+static void*
+decode_chunk(
+    void *arg)			///< [in,out] Chunk to decode
+{
+    merge_chunk *chunk = arg;
+    unsigned char buffer[RECORD_OVERHEAD + IHEX_MAX_RECORD_LENGTH];
+    ihex_record record;
+    const char *line, *next;
+    size_t length, address, base = chunk->base;
+    int line_number = chunk->first_line - 1;
+
+    chunk->status = reserve_data(chunk);
+    for (line = chunk->text; line < chunk->end && ! chunk->eof && ! chunk->status; line = next) {
+	++line_number;
+	next = find_newline(line, chunk->end);
+	length = next - line;
+	if (next < chunk->end) ++next;
+	while (length > 0 && strchr(" \t\r", line[length - 1])) --length;
+	if (length == 0) continue;
+
+	chunk->errmsg = parse_record(line, length, buffer, &record);
+	if (chunk->errmsg) break;
+	++chunk->valid;
+
+	switch (record.type) {
+	case REC_DATA:
+	    address = base + record.offset;
+	    if (address + record.length > chunk->high) chunk->high = address + record.length;
+	    if (record.length && address < chunk->low) chunk->low = address;
+	    if (in_window(chunk->window, address, record.length)) {
+		chunk->status = image_ranges_add(&chunk->ranges, address, record.length,
+						 record.data);
+	    }
+	    break;
+	case REC_EOF:
+	    chunk->eof = 1;
+	    break;
+	case REC_ESA:
+	    base = (size_t) ((record.data[0] << 8) | record.data[1]) << 4;
+	    break;
+	case REC_ELA:
+	    base = (size_t) ((record.data[0] << 8) | record.data[1]) << 16;
+	    break;
+	}
+    }
+    chunk->last_line = line_number;
+    return NULL;
+}
+
+
+
+///@brief Decode mapped text in parallel chunks and keep the data within the windows
+///@details All chunks are decoded and validated before any data is collected,
+///         in file order.  Invalid files thus leave the ranges untouched.
+///@return Highest data address plus one, zero if not in Intel Hex format or
+///        negative error code
+static ssize_t
+read_mapped(
+    const char *text,		///< [in] Mapped file content
+    size_t size,		///< [in] Size of the text
+    const char *filename,	///< [in] File name for error messages
+    const read_window *window,	///< [in] Address windows of the data to keep
+    image_ranges *ranges,	///< [in,out] Populated ranges to extend
+    size_t *low)		///< [out] Lowest data address, SIZE_MAX if none
+{
+    merge_chunk chunks[MAX_READ_THREADS];
+    const image_range *range;
+    size_t high = 0;
+    ssize_t result = 0;
+    int num_chunks, records = 0, eof = 0, line_number = 0, i;
+#if HAVE_PTHREADS
+    pthread_t threads[MAX_READ_THREADS];
+    char started[MAX_READ_THREADS];
+#endif
+
+    *low = SIZE_MAX;
+    num_chunks = read_threads < MAX_READ_THREADS ? read_threads : MAX_READ_THREADS;
+    if ((size_t) num_chunks > size / CHUNK_MIN_TEXT) num_chunks = size / CHUNK_MIN_TEXT;
+    if (num_chunks < 1) num_chunks = 1;
+    memset(chunks, 0, num_chunks * sizeof(*chunks));
+    for (i = 0; i < num_chunks; ++i) {
+	chunks[i].window = window;
+	chunks[i].low = SIZE_MAX;
+    }
+    split_chunks(text, size, chunks, num_chunks);
+    if (DEBUG) printf("%s: %zu characters in %d chunks\n", __func__, size, num_chunks);
+
+#if HAVE_PTHREADS
+    // The calling thread decodes the first chunk itself
+    for (i = 1; i < num_chunks; ++i) {
+	started[i] = pthread_create(&threads[i], NULL, decode_chunk, &chunks[i]) == 0;
+    }
+#endif
+    decode_chunk(&chunks[0]);
+    for (i = 1; i < num_chunks; ++i) {
+#if HAVE_PTHREADS
+	if (started[i]) pthread_join(threads[i], NULL);
+	else
+#endif
+	    decode_chunk(&chunks[i]);
+    }
+
+    // Check for errors up to the end-of-file record before collecting anything
+    for (i = 0; i < num_chunks && ! eof && result == 0; ++i) {
+	line_number = chunks[i].last_line;
+	if (chunks[i].status) result = chunks[i].status;
+	else if (chunks[i].errmsg) {
+	    // Only a file starting with a valid record is treated as Intel Hex
+	    if (records + chunks[i].valid == 0) result = -1;
+	    else {
+		fprintf(stderr, _("%s:%d: Invalid Intel Hex record (%s)\n"),
+			filename, chunks[i].last_line, chunks[i].errmsg);
+		result = -4;
+	    }
+	}
+	records += chunks[i].valid;
+	eof = chunks[i].eof;
+	if (high < chunks[i].high) high = chunks[i].high;
+	if (*low > chunks[i].low) *low = chunks[i].low;
+    }
+    if (result == -1) result = 0;
+    else if (result == 0) result = check_merged(filename, records, eof, line_number, high);
+
+    for (i = 0; i < num_chunks && result > 0; ++i) {
+	if (ranges->count == 0) {
+	    // Take over the first chunk's data instead of copying it
+	    image_ranges_free(ranges);
+	    *ranges = chunks[i].ranges;
+	    memset(&chunks[i].ranges, 0, sizeof(chunks[i].ranges));
+	} else {
+	    for (range = chunks[i].ranges.ranges;
+		 range < chunks[i].ranges.ranges + chunks[i].ranges.count; ++range) {
+		if (image_ranges_add(ranges, range->address, range->length,
+				     chunks[i].ranges.data + range->data) != 0) {
+		    result = -3;
+		    break;
+		}
+	    }
+	}
+	if (chunks[i].eof) break;
+    }
+    for (i = 0; i < num_chunks; ++i) image_ranges_free(&chunks[i].ranges);
+    return result;
+}
+
+
+
+///@brief Describe the data records of mapped text in a record index
+///@details Only each line's record header is looked at, as the records were
+///         fully validated while reading the file before.
+///@return Zero on success or negative error code
+static int
+build_record_index(
+    const char *text,		///< [in] Mapped file content
+    size_t size,		///< [in] Size of the text
+    ihex_index *index)		///< [in,out] Index to extend
+{
+    const char *line, *next, *end = text + size;
+    unsigned char header[4], address[2];
+    size_t base = 0;
+    int status = 0;
+
+    for (line = text; line < end && status == 0; line = next) {
+	next = find_newline(line, end);
+	if (next < end) ++next;
+	if (next - line < 11 || line[0] != ':'
+	    || hex_decode(line + 1, 8, (char*) header, sizeof(header), NULL) != 4) continue;
+
+	switch (header[3]) {
+	case REC_DATA:
+	    status = ihex_index_add(index, base + ((header[1] << 8) | header[2]), header[0],
+				    text, line - text, next - line);
+	    break;
+	case REC_EOF:
+	    return 0;
+	case REC_ESA:
+	case REC_ELA:
+	    if (hex_decode(line + 9, 4, (char*) address, sizeof(address), NULL) == 2) {
+		base = (size_t) ((address[0] << 8) | address[1])
+		    << (header[3] == REC_ESA ? 4 : 16);
+	    }
+	    break;
+	}
+    }
+    return status;
+}
+
+
+
+///@brief Store a record index for a successfully read file
+///@details Failures are reported, but do not affect reading the file.
+static void
+write_record_index(
+    const char *index_name,	///< [in] Index file path to write
+    const struct stat *st,	///< [in] Status of the image file
+    const char *text,		///< [in] Mapped file content
+    size_t end)			///< [in] Highest data address in the file plus one
+{
+    ihex_index index = { .header.end = end };
+
+    if (build_record_index(text, st->st_size, &index) != 0) {
+	fprintf(stderr, _("Could not allocate memory for image data: %s\n"),
+		strerror(errno));
+    } else ihex_index_write(index_name, st, &index);
+    ihex_index_free(&index);
+}
+#endif
+
+
+
+///@brief Parse a whole file and keep the data within the address windows
+///@details Regular files are memory mapped where possible, to be decoded in
+///         parallel.  Otherwise records are parsed one by one from the stream.
+///         The resulting ranges are sorted by address.  A record index is only
+///         written for memory mapped files.
+///@return Highest data address plus one, zero if not in Intel Hex format or
+///        negative error code
+static ssize_t
+read_file(
+    FILE *in,			///< [in] Stream opened for reading
+    const char *filename,	///< [in] File name for error messages
+    const read_window *window,	///< [in] Address windows of the data to keep
+    image_ranges *ranges,	///< [in,out] Populated ranges to extend
+    size_t *low,		///< [out] Lowest data address, SIZE_MAX if none
+    const char *index_name)	///< [in] Record index file to write or NULL
+{
+    ssize_t result;
+#if HAVE_MMAP
+    struct stat st;
+    void *mapped = MAP_FAILED;
+
+    if (fstat(fileno(in), &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+	mapped = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(in), 0);
+	if (DEBUG && mapped == MAP_FAILED) {
+	    printf("%s: mmap() failed (%s)\n", __func__, strerror(errno));
+	}
+    }
+    if (mapped != MAP_FAILED) {
+	result = read_mapped(mapped, st.st_size, filename, window, ranges, low);
+	if (result > 0 && index_name) write_record_index(index_name, &st, mapped, result);
+	munmap(mapped, st.st_size);
+    } else
+#else
+    (void) index_name;
+#endif
+	result = read_stream(in, filename, window, ranges, low);
+
+    if (result > 0 && image_ranges_sort(ranges) != 0) result = -3;
+    if (result == -3) {
+	fprintf(stderr, _("Could not allocate memory for image data: %s\n"),
+		strerror(errno));
+    }
+    return result;
+}
+
+
+
+///@brief Merge the data within the section's window into the symbols
+///@details Gaps between the ranges up to the end of the file's data read as
+///         zero bytes.
+///@return Size of the file's data counted from the window start
+static size_t
+merge_window(
+    merge_index *index,		///< [in,out] Sorted symbols to merge into
+    const image_ranges *ranges,	///< [in] Sorted data within the windows
+    size_t end,			///< [in] Highest data address in the file plus one
+    size_t base)		///< [in] Address where the section's window starts
+{
+    const image_range *range;
+    size_t high = 0, skip;
+
+    if (DEBUG) printf("%s: window starts at 0x%04zx\n", __func__, base);
+    if (end <= base) return 0;	//no data within the window
+    for (range = ranges->ranges + image_ranges_find(ranges, base);
+	 range < ranges->ranges + ranges->count && high < index->limit; ++range) {
+	skip = range->address < base ? base - range->address : 0;
+	merge_data(index, &high, range->address + skip - base, range->length - skip,
+		   ranges->data + range->data + skip);
+    }
+    if (end - base > high) merge_range(index, high, end - base - high, NULL);
+    return end - base;
+}
+
+
+
+///@brief Check whether data overlaps any symbol
+///@return Non-zero if any byte lies within a symbol
+static int
+overlaps_symbol(
+    const merge_index *index,	///< [in] Sorted symbols
+    size_t address,		///< [in] Start address relative to the window
+    size_t length)		///< [in] Number of bytes
+{
+    int low = 0, high = index->count, i;
+
+    if (address >= index->limit) return 0;
+    // Find the first symbol reaching beyond the start
+    while (low < high) {
+	i = low + (high - low) / 2;
+	if (index->reach[i] > address) high = i;
+	else low = i + 1;
+    }
+    return low < index->count && index->sorted[low]->offset < address + length;
+}
+
+
+
+///@brief Check whether an indexed block holds data for any symbol
+///@return Non-zero if the block needs to be read
+static int
+wanted_block(
+    const merge_index *index,	///< [in] Sorted symbols
+    const ihex_index_block *block,	///< [in] Indexed block of records
+    size_t base)		///< [in] Address where the section's window starts
+{
+    size_t end = block->address + block->length;
+
+    if (end <= base) return 0;
+    if (block->address >= base) return overlaps_symbol(index, block->address - base,
+							block->length);
+    return overlaps_symbol(index, 0, end - base);
+}
+
+
+
+///@brief Decode the data records of an indexed block
+///@return Zero on success, -1 if the text does not match the index or
+///        negative error code
+static int
+decode_block(
+    const char *text,		///< [in] Text read for the block
+    const ihex_index_block *block,	///< [in] Indexed block of records
+    image_ranges *ranges)	///< [in,out] Populated ranges to extend
+{
+    unsigned char buffer[RECORD_OVERHEAD + IHEX_MAX_RECORD_LENGTH];
+    ihex_record record;
+    const char *line, *next, *end = text + block->text_length;
+    size_t length, base = 0, address = block->address;
+
+    if (ihex_index_hash(IHEX_INDEX_HASH_INIT, text, block->text_length) != block->hash) {
+	return -1;
+    }
+    for (line = text; line < end; line = next) {
+	next = find_newline(line, end);
+	length = next - line;
+	if (next < end) ++next;
+	while (length > 0 && strchr(" \t\r", line[length - 1])) --length;
+
+	if (parse_record(line, length, buffer, &record) || record.type != REC_DATA) return -1;
+	// All records in a block share the same base and follow each other
+	if (line == text) base = address - record.offset;
+	else if (base + record.offset != address) return -1;
+	if (image_ranges_add(ranges, address, record.length, record.data) != 0) return -3;
+	address += record.length;
+    }
+    return address == block->address + block->length ? 0 : -1;
+}
+
+
+
+///@brief Read only the records holding symbol data, located by a record index
+///@details Blocks of interest are read from the file directly, with short gaps
+///         between them read through.  If the index is missing, outdated or
+///         does not match the file content, nothing is kept.
+///@return Highest data address plus one, zero if the index cannot be used or
+///        negative error code
+static ssize_t
+read_indexed(
+    FILE *in,			///< [in] Stream opened for reading
+    const char *index_name,	///< [in] Record index file to read
+    const merge_index *symbols,	///< [in] Sorted symbols to read data for
+    size_t load_address,	///< [in] Load address of the section
+    image_ranges *ranges,	///< [in,out] Populated ranges to extend
+    size_t *low)		///< [out] Lowest data address, SIZE_MAX if none
+{
+    ihex_index index;
+    const ihex_index_block *first, *last, *block, *blocks_end;
+    struct stat st;
+    char *text = NULL, *buffer;
+    size_t base, span, text_size = 0;
+    ssize_t result;
+    int status;
+
+    if (fstat(fileno(in), &st) != 0 || ! S_ISREG(st.st_mode)) return 0;
+    status = ihex_index_read(index_name, &st, &index);
+    if (status <= 0) result = status;
+    else {
+	blocks_end = index.blocks + index.header.num_blocks;
+	for (block = index.blocks, *low = SIZE_MAX; block < blocks_end; ++block) {
+	    if (block->length && block->address < *low) *low = block->address;
+	}
+	base = window_base(*low, load_address);
+	for (first = index.blocks, status = 0; first < blocks_end && status == 0;
+	     first = last + 1) {
+	    last = first;
+	    if (! wanted_block(symbols, first, base)) continue;
+	    for (block = first + 1; block < blocks_end && block->text_offset
+		     - (last->text_offset + last->text_length) <= INDEX_READ_GAP; ++block) {
+		if (wanted_block(symbols, block, base)) last = block;
+	    }
+
+	    span = last->text_offset + last->text_length - first->text_offset;
+	    if (span > text_size) {
+		buffer = realloc(text, span);
+		if (! buffer) {
+		    status = -3;
+		    break;
+		}
+		text = buffer;
+		text_size = span;
+	    }
+	    if (pread(fileno(in), text, span, first->text_offset) != (ssize_t) span) status = -1;
+	    for (block = first; block <= last && status == 0; ++block) {
+		if (! wanted_block(symbols, block, base)) continue;
+		status = decode_block(text + (block->text_offset - first->text_offset), block,
+				      ranges);
+	    }
+	}
+	if (status == 0 && image_ranges_sort(ranges) != 0) status = -3;
+	result = status == 0 ? (ssize_t) index.header.end : status;
+	if (DEBUG) printf("%s: %u blocks indexed, %s\n", __func__, index.header.num_blocks,
+			  status == 0 ? "used" : "not matching");
+	free(text);
+	ihex_index_free(&index);
+    }
+
+    if (result == -1) {
+	// Index not matching the file, which is read completely instead
+	image_ranges_free(ranges);
+	result = 0;
+    } else if (result == -3) {
+	fprintf(stderr, _("Could not allocate memory for image data: %s\n"),
+		strerror(errno));
+    }
+    return result;
+}
+
+
+
+int
+image_ihex_read_ranges(const char *filename, image_ranges *ranges)
+{
+    read_window window = { 0, SIZE_MAX };
+    FILE *in;
+    ssize_t end;
+    size_t low;
+
+    if (! filename || ! ranges) return -1;	//invalid parameters
+
+    in = fopen(filename, "r");
+    if (! in) {
+	fprintf(stderr, _("Cannot open image \"%s\" (%s)\n"), filename, strerror(errno));
+	return -2;
+    }
+
+    end = read_file(in, filename, &window, ranges, &low, NULL);
+    if (end == 0 && ferror(in)) {
+	fprintf(stderr, _("Cannot open image \"%s\" (%s)\n"), filename, strerror(errno));
+	end = -2;
+    }
+    fclose(in);
+
+    if (end <= 0) {
+	image_ranges_free(ranges);
+	return end;
+    }
+    if (DEBUG) printf(_("%s: %s contains %d ranges up to 0x%04zx\n"),
+		      __func__, filename, ranges->count, (size_t) end - 1);
+    return 1;
+}
+
+
+
+int
+image_ihex_merge_file(const char *filename,
+		      const nvm_symbol *list, const int list_size,
+		      size_t blob_size, size_t load_address)
+{
+    merge_index index = { 0 };
+    image_ranges ranges = { 0 };
+    read_window window = { addressing == addressingRelative ? 0 : load_address, blob_size };
+    const nvm_symbol *symbol;
+    char *index_name = NULL;
+    FILE *in;
+    ssize_t end;
+    size_t file_size, low, base;
+    int symbols = 0;
+
+    if (! filename || ! blob_size) return -1;	//invalid parameters
+
+    in = fopen(filename, "r");
+    if (! in) {
+	fprintf(stderr, _("Cannot open image \"%s\" (%s)\n"), filename, strerror(errno));
+	return -2;
+    }
+
+    if (build_index(&index, list, list_size, blob_size) != 0) {
+	fprintf(stderr, _("Could not allocate memory for image data: %s\n"),
+		strerror(errno));
+	symbols = -3;
+    } else {
+	// Without memory for the index file name, the whole file is read
+	if (use_index) index_name = ihex_index_name(filename);
+	end = index_name
+	    ? read_indexed(in, index_name, &index, load_address, &ranges, &low) : 0;
+	if (end == 0) end = read_file(in, filename, &window, &ranges, &low, index_name);
+	if (end < 0) symbols = end;
+	else if (end == 0 && ferror(in)) {
+	    fprintf(stderr, _("Cannot open image \"%s\" (%s)\n"), filename, strerror(errno));
+	    symbols = -2;
+	} else if (end == 0) symbols = 0;	//not in Intel Hex format
+	else {
+	    base = window_base(low, load_address);
+	    if (addressing == addressingAuto && base) {
+		fprintf(stderr, _("Image file \"%s\" has no data below 0x%04zx,"
+				  " reading absolute addresses\n"), filename, base);
+	    } else if (addressing == addressingAuto && load_address && low >= blob_size
+		       && (size_t) end > load_address) {
+		// Probably a larger dump, which needs absolute addresses
+		fprintf(stderr, _("Image file \"%s\" has no data from address zero,"
+				  " but beyond the load address 0x%04zx\n"),
+			filename, load_address);
+	    }
+	    file_size = merge_window(&index, &ranges, end, base);
+	    if (DEBUG) printf(_("%s: %s contains data up to 0x%04zx\n"),
+			      __func__, filename, (size_t) end - 1);
+	    if (blob_size > file_size) {
+		fprintf(stderr, _("Image file \"%s\" is too small, %zu of %zu bytes missing\n"),
+			filename, blob_size - file_size, blob_size);
+		blob_size = file_size;
+	    }
+	    // Count symbols with at least partial data, or without storage
+	    for (symbol = list; symbol < list + list_size; ++symbol) {
+		if (! symbol->blob_address || symbol->offset < blob_size) ++symbols;
+	    }
+	}
+    }
+    free(index.sorted);
+    free(index.reach);
+    free(index_name);
+    image_ranges_free(&ranges);
+    fclose(in);
+
+    return symbols;
+}
+
+
+
+#ifdef TEST_IHEX_MERGE
+#include <time.h>
+
+/// Pseudo-random test data byte for an address
+static inline unsigned char
+test_data(size_t address)
+{
+    return address * 2654435761U >> 13;
+}
+
+
+
+/// Write a test file with pseudo-random data and extended linear addresses
+static int
+write_test_file(const char *filename, size_t base, size_t size)
+{
+    unsigned char record[RECORD_OVERHEAD + 32];
+    size_t address, length, i;
+    FILE *out = fopen(filename, "w");
+
+    if (! out) return -1;
+    for (address = base; address < base + size; address += length) {
+	if (address % 0x10000 == 0) {
+	    fprintf(out, ":02000004%04zX%02X\n", address >> 16,
+		    (uint8_t) -(2 + 4 + (address >> 24) + ((address >> 16) & 0xFF)));
+	}
+	length = base + size - address < 32 ? base + size - address : 32;
+	record[0] = length;
+	record[1] = (address >> 8) & 0xFF;
+	record[2] = address & 0xFF;
+	record[3] = REC_DATA;
+	for (i = 0; i < length; ++i) record[4 + i] = test_data(address + i);
+	record[4 + length] = -checksum(record, 4 + length);
+	fputc(':', out);
+	for (i = 0; i < length + RECORD_OVERHEAD; ++i) fprintf(out, "%02X", record[i]);
+	fputc('\n', out);
+    }
+    fputs(":00000001FF\n", out);
+    return fclose(out);
+}
+
+
+
+/// Merge the test file and compare the result with a reference
+static void
+run_merge(const char *label, const char *filename, int threads, int stream,
+	  const char *index_name, size_t base,
+	  const nvm_symbol *symbols, int num_symbols, char *blob, size_t size,
+	  size_t file_size, const char *reference)
+{
+    struct timespec start, end;
+    read_window window = { base, size };
+    image_ranges ranges = { 0 };
+    merge_index index;
+    FILE *in;
+    ssize_t result;
+    size_t low;
+    double ms;
+
+    memset(blob, 0xAA, size);
+    image_ihex_read_threads(threads);
+    in = fopen(filename, "r");
+    if (! in || build_index(&index, symbols, num_symbols, size) != 0) return;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    result = index_name ? read_indexed(in, index_name, &index, base, &ranges, &low) : 0;
+    if (result == 0) result = stream ? read_stream(in, filename, &window, &ranges, &low)
+	: read_file(in, filename, &window, &ranges, &low, index_name);
+    if (result > 0) result = merge_window(&index, &ranges, result, base);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    fclose(in);
+    free(index.sorted);
+    free(index.reach);
+    image_ranges_free(&ranges);
+    ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+    printf("\t%-20s %8.2f ms  %s\n", label, ms,
+	   result != (ssize_t) file_size ? "FAIL"
+	   : reference && memcmp(blob, reference, size) ? "differs" : "ok");
+}
+
+
+
+/// Merge a small test file and check from which address the section is read
+static void
+check_addressing(const char *filename, enum ihex_addressing mode, size_t file_base,
+		 size_t load_address, size_t expected)
+{
+    char blob[0x100];
+    nvm_symbol symbol = { 0, sizeof(blob), blob, 0, NULL };
+    size_t i;
+    int symbols, match = 1;
+
+    if (write_test_file(filename, file_base, 0x800) != 0) return;
+    image_ihex_addressing(mode);
+    symbols = image_ihex_merge_file(filename, &symbol, 1, sizeof(blob), load_address);
+    for (i = 0; i < sizeof(blob); ++i) {
+	if ((unsigned char) blob[i] != test_data(expected + i)) match = 0;
+    }
+    image_ihex_addressing(addressingAuto);
+    printf("	mode %d, data at 0x%04zx, section at 0x%04zx  %s\n", mode, file_base,
+	   load_address, symbols == 1 && match ? "ok" : "FAIL");
+}
+
+
+
+/// Write an image with image_ihex_write_file() and check that it reads back the same
+static void
+check_round_trip(const char *filename, size_t size)
+{
+    char *blob = malloc(size), *back = calloc(1, size);
+    nvm_symbol symbol = { 0, size, back, 0, NULL };
+    size_t i;
+    int symbols = -1;
+
+    if (blob && back) {
+	for (i = 0; i < size; ++i) blob[i] = test_data(i);
+	if (image_ihex_write_file(filename, blob, size) == (ssize_t) size) {
+	    symbols = image_ihex_merge_file(filename, &symbol, 1, size, 0);
+	}
+    }
+    printf("	%zu bytes written and read back  %s\n", size,
+	   symbols == 1 && ! memcmp(blob, back, size) ? "ok" : "FAIL");
+    free(back);
+    free(blob);
+}
+
+
+
+int
+main(int argc, char **argv)
+{
+    const char *filename = argc > 1 ? argv[1] : "test_ihex_merge.hex";
+    size_t size = (argc > 2 ? atoi(argv[2]) : 8) << 20, i;
+    int threads = argc > 3 ? atoi(argv[3]) : 4, num_symbols = size / 64;
+    size_t base = argc > 4 ? strtoul(argv[4], NULL, 0) & ~0xFFFFUL : 0x08000000;
+    nvm_symbol *symbols = calloc(num_symbols, sizeof(*symbols));
+    char *blob = malloc(size), *reference = malloc(size), label[32];
+    char *index_name = ihex_index_name(filename);
+
+    if (! symbols || ! blob || ! reference || ! index_name) return 1;
+
+    // Files reaching beyond a small load address may still be section-relative
+    puts("address windows:");
+    check_addressing(filename, addressingAuto, 0, 0x400, 0);
+    check_addressing(filename, addressingAuto, 0x400, 0x400, 0x400);
+    check_addressing(filename, addressingAbsolute, 0, 0x400, 0x400);
+    check_addressing(filename, addressingRelative, 0, 0x400, 0);
+
+    // Output beyond the first segment and the first megabyte needs address records
+    puts("round trip:");
+    check_round_trip(filename, 0x10001);
+    check_round_trip(filename, 0x180000);
+
+    if (write_test_file(filename, base, size) != 0) return 1;
+    for (i = 0; i < (size_t) num_symbols; ++i) {
+	symbols[i].offset = i * 64;
+	symbols[i].size = 64;
+	symbols[i].blob_address = blob + i * 64;
+    }
+    printf("%zu MiB at 0x%08zx in %d symbols:\n", size >> 20, base, num_symbols);
+    run_merge("stream", filename, 1, 1, NULL, base, symbols, num_symbols, blob, size, size,
+	      NULL);
+    memcpy(reference, blob, size);
+    run_merge("mapped, 1 thread", filename, 1, 0, NULL, base, symbols, num_symbols, blob, size,
+	      size, reference);
+    snprintf(label, sizeof(label), "mapped, %d threads", threads);
+    run_merge(label, filename, threads, 0, NULL, base, symbols, num_symbols, blob, size, size,
+	      reference);
+
+    // Extract only a small window, like a page from a full flash dump
+    printf("first 64 KiB of %zu MiB in %d symbols:\n", size >> 20, 1024);
+    run_merge("stream", filename, 1, 1, NULL, base, symbols, 1024, blob, 0x10000, size,
+	      reference);
+    run_merge("mapped, 1 thread", filename, 1, 0, NULL, base, symbols, 1024, blob, 0x10000, size,
+	      reference);
+    run_merge(label, filename, threads, 0, NULL, base, symbols, 1024, blob, 0x10000, size,
+	      reference);
+    run_merge("building index", filename, 1, 0, index_name, base, symbols, 1024, blob, 0x10000,
+	      size, reference);
+    run_merge("indexed", filename, 1, 0, index_name, base, symbols, 1024, blob, 0x10000,
+	      size, reference);
+
+    remove(index_name);
+    remove(filename);
+    free(index_name);
+    free(reference);
+    free(blob);
+    free(symbols);
+    return 0;
+}
+#endif
@@ -1,6 +1,6 @@
 ///@file
 ///@brief	Handle output of blob data to Intel Hex files
-///@copyright	Copyright (C) 2014, 2015, 2023  Andre Colomb
+///@copyright	Copyright (C) 2014, 2015, 2023, 2026  Andre Colomb
 ///
 /// This file is part of elf-mangle.
 ///
@@ -27,55 +27,257 @@
 #include "intl.h"
 
 #include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
 #include <errno.h>
 #include <inttypes.h>
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
 
 /// Compile diagnostic output messages?
 #define DEBUG 0
 
+/// Record type for data bytes
+#define REC_DATA		0x00
+/// Record type marking the end of file
+#define REC_EOF			0x01
+/// Record type for an Extended Segment Address
+#define REC_ESA			0x02
+/// Record type for an Extended Linear Address
+#define REC_ELA			0x04
+/// Number of segments reachable through Extended Segment Address records
+#define ESA_SEGMENTS		0x10
+/// Characters in a record besides its data: colon, length, offset, type, checksum, newline
+#define RECORD_OVERHEAD		(1 + 2 + 4 + 2 + 2 + 1)
+/// Number of bytes addressable within one segment
+#define SEGMENT_LENGTH		0x10000
+/// Minimum number of segments for each thread to encode
+#define SEGMENTS_PER_THREAD	4
+/// Upper limit for parallel threads encoding an image
+#define MAX_WRITE_THREADS	64
 
+/// Build the hex digit pairs for all bytes with the given upper nibble
+#define HEX_ROW(h)	h "0" h "1" h "2" h "3" h "4" h "5" h "6" h "7" \
+			h "8" h "9" h "A" h "B" h "C" h "D" h "E" h "F"
 
-///@brief Output a single Intel Hex record to file
-///@return Written record length or negative error code
-static inline int
-ihex_write_single_record(
-    FILE* restrict out,		///< [in] Output file stream
+/// Two upper case hex digits for each byte value
+static const char hex_pairs[] =
+    HEX_ROW("0") HEX_ROW("1") HEX_ROW("2") HEX_ROW("3")
+    HEX_ROW("4") HEX_ROW("5") HEX_ROW("6") HEX_ROW("7")
+    HEX_ROW("8") HEX_ROW("9") HEX_ROW("A") HEX_ROW("B")
+    HEX_ROW("C") HEX_ROW("D") HEX_ROW("E") HEX_ROW("F");
+
+/// Number of data bytes in each data record
+static size_t record_length = IHEX_DEFAULT_RECORD_LENGTH;
+
+/// Number of threads to encode large images with
+static int write_threads = 1;
+
+/// Consecutive segments of an image encoded to text by one thread
+typedef struct ihex_chunk {
+    /// Binary data of the whole image
+    const unsigned char*	blob;
+    /// Size of the whole image in bytes
+    size_t			blob_size;
+    /// Index of the first segment to encode
+    size_t			first;
+    /// Index after the last segment to encode
+    size_t			last;
+    /// Buffer for the encoded records
+    char*			text;
+    /// Number of characters encoded
+    size_t			length;
+} ihex_chunk;
+
+
+
+void
+image_ihex_record_length(size_t length)
+{
+    if (length < 1 || length > IHEX_MAX_RECORD_LENGTH) length = IHEX_DEFAULT_RECORD_LENGTH;
+    record_length = length;
+}
+
+
+
+void
+image_ihex_write_threads(int threads)
+{
+    write_threads = threads < 1 ? 1 : threads;
+}
+
+
+
+///@brief Encode a single Intel Hex record to text
+///@return Address after the last character encoded
+static char*
+encode_record(
+    char* restrict out,		///< [out] Buffer for the record text
     uint8_t reclen,		///< [in] Size of record data in bytes
     uint16_t load_offset,	///< [in] Starting load offset of the data bytes
     uint8_t rectyp,		///< [in] Record type
-    const char* restrict data)	///< [in] Information or data for record content
+    const unsigned char* restrict data)	///< [in] Information or data for record content
 {
-    int r;
-    uint8_t checksum, i;
+    const unsigned char *end = data + reclen;
+    uint8_t checksum;
 
-    if (! out || (reclen && ! data)) return -1;
+    checksum = reclen + (load_offset >> 8) + (load_offset & 0xFF) + rectyp;
+    *out++ = ':';
+    memcpy(out, hex_pairs + 2 * reclen, 2);
+    memcpy(out + 2, hex_pairs + 2 * (load_offset >> 8), 2);
+    memcpy(out + 4, hex_pairs + 2 * (load_offset & 0xFF), 2);
+    memcpy(out + 6, hex_pairs + 2 * rectyp, 2);
+    out += 8;
+    for (; data < end; ++data, out += 2) {
+	memcpy(out, hex_pairs + 2 * *data, 2);
+	checksum += *data;
+    }
+    checksum = -checksum;
+    memcpy(out, hex_pairs + 2 * checksum, 2);
+    out[2] = '\n';
+    return out + 3;
+}
 
-    // Write header
-    r = fprintf(out, ":%02" PRIX8 "%04" PRIX16 "%02" PRIX8,
-		reclen, (unsigned) load_offset, rectyp);
-    if (r < 0) return r;
-    checksum = reclen
-	+ ((load_offset >> 8) & 0xFF)
-	+ ((load_offset >> 0) & 0xFF) + rectyp;
 
-    // Write data
-    for (i = 0; i < reclen; ++i) {
-	r = fprintf(out, "%02hhX", (unsigned char) data[i]);
-	if (r < 0) return r;
-	checksum += data[i];
+
+///@brief Calculate the data size of a range of segments
+///@return Number of data bytes within the segments
+static size_t
+segments_data_size(
+    size_t blob_size,		///< [in] Size of the whole image in bytes
+    size_t first,		///< [in] Index of the first segment
+    size_t last)		///< [in] Index after the last segment
+{
+    if (last * SEGMENT_LENGTH < blob_size) blob_size = last * SEGMENT_LENGTH;
+    return blob_size - first * SEGMENT_LENGTH;
+}
+
+
+
+///@brief Calculate the text size of a range of segments
+///@return Number of characters needed to encode the segments
+static size_t
+segments_text_size(
+    size_t blob_size,		///< [in] Size of the whole image in bytes
+    size_t first,		///< [in] Index of the first segment
+    size_t last)		///< [in] Index after the last segment
+{
+    size_t size, full, text;
+
+    // Data records, plus an address record after each complete segment
+    size = segments_data_size(blob_size, first, last);
+    full = size / SEGMENT_LENGTH;
+    text = full * ((SEGMENT_LENGTH + record_length - 1) / record_length * RECORD_OVERHEAD
+		   + RECORD_OVERHEAD + 4);
+    size %= SEGMENT_LENGTH;
+    text += (size + record_length - 1) / record_length * RECORD_OVERHEAD;
+    return text + 2 * (full * SEGMENT_LENGTH + size);
+}
+
+
+
+///@brief Encode data records for a range of segments
+///@details Each segment restarts at load offset zero.  A complete segment is
+///         followed by an Extended Segment Address record for the next one,
+///         or an Extended Linear Address record beyond the first megabyte.
+///@return Address after the last character encoded
+static char*
+encode_segments(
+    char* restrict out,		///< [out] Buffer for the record text
+    const unsigned char* restrict blob,	///< [in] Binary data of the whole image
+    size_t blob_size,		///< [in] Size of the whole image in bytes
+    size_t first,		///< [in] Index of the first segment
+    size_t last)		///< [in] Index after the last segment
+{
+    const unsigned char *data, *end;
+    unsigned char usba[2];
+    size_t segment, reclen, base;
+
+    for (segment = first; segment < last; ++segment) {
+	data = blob + segment * SEGMENT_LENGTH;
+	end = data + segments_data_size(blob_size, segment, segment + 1);
+	for (; data < end; data += reclen) {
+	    reclen = (size_t) (end - data) < record_length ? (size_t) (end - data) : record_length;
+	    out = encode_record(out, reclen, (data - blob) % SEGMENT_LENGTH, REC_DATA, data);
+	}
+	if (end - (blob + segment * SEGMENT_LENGTH) == SEGMENT_LENGTH) {
+	    // Base address for the next segment in big-endian order, in paragraphs
+	    // (16 bytes) while reachable, else in multiples of 64 KiB
+	    base = segment + 1 < ESA_SEGMENTS ? (segment + 1) << 12 : segment + 1;
+	    usba[0] = (base >> 8) & 0xFF;
+	    usba[1] = base & 0xFF;
+	    out = encode_record(out, sizeof(usba), 0,
+				segment + 1 < ESA_SEGMENTS ? REC_ESA : REC_ELA, usba);
+	}
     }
+    return out;
+}
 
-    // Write checksum
-    checksum = -checksum;
-    r = fprintf(out, "%02" PRIX8 "\n", checksum);
-    if (r < 0) return r;
 
-    return reclen;
+
+///@brief Thread entry point to encode one chunk of segments
+///@return Always NULL, success is indicated by the chunk's text
+static void*
+encode_chunk(
+    void *arg)			///< [in,out] Chunk description
+{
+    ihex_chunk *chunk = arg;
+
+    chunk->text = malloc(segments_text_size(chunk->blob_size, chunk->first, chunk->last));
+    if (! chunk->text) return NULL;
+    chunk->length = encode_segments(chunk->text, chunk->blob, chunk->blob_size,
+				    chunk->first, chunk->last) - chunk->text;
+    return NULL;
+}
+
+
+
+///@brief Encode chunks of segments in parallel, writing them in order
+///@return Number of data bytes written to file (negated on error)
+static ssize_t
+ihex_write_parallel(
+    FILE* restrict out,		///< [in] Output file stream
+    ihex_chunk chunks[],	///< [in,out] Chunks covering the whole image
+    int num_chunks)		///< [in] Number of chunks
+{
+    ssize_t nbytes = 0;
+    int i, failed = 0;
+#if HAVE_PTHREADS
+    pthread_t threads[num_chunks];
+    char started[num_chunks];
+
+    // The calling thread encodes the first chunk itself
+    for (i = 1; i < num_chunks; ++i) {
+	started[i] = pthread_create(&threads[i], NULL, encode_chunk, &chunks[i]) == 0;
+    }
+#endif
+    for (i = 0; i < num_chunks; ++i) {
+#if HAVE_PTHREADS
+	if (i > 0 && started[i]) pthread_join(threads[i], NULL);
+	else
+#endif
+	    encode_chunk(&chunks[i]);
+	if (! chunks[i].text) {
+	    fprintf(stderr, _("Could not allocate memory for Intel Hex records.\n"));
+	    failed = 1;
+	}
+	// Write chunks as they complete, in order
+	if (! failed && chunks[i].text
+	    && fwrite(chunks[i].text, 1, chunks[i].length, out) == chunks[i].length) {
+	    nbytes += segments_data_size(chunks[i].blob_size, chunks[i].first, chunks[i].last);
+	} else failed = 1;
+	free(chunks[i].text);
+    }
+    return failed ? -nbytes : nbytes;
 }
 
 
 
 ///@brief Generate and output records of Intel Hex format for binary data
+///@details Records are encoded segment by segment into a buffer, so only few
+///         calls are needed to write the output.  Large images are split up
+///         into chunks of segments for parallel encoding.
 ///@return Number of bytes written to file (negated on error)
 static ssize_t
 ihex_write(
@@ -83,53 +285,50 @@ ihex_write(
     const char* blob,		///< [in] Binary data to write
     size_t blob_size)		///< [in] Data size in bytes
 {
-    static const size_t default_length = 0x20;
-    static const size_t segment_length = 0x10000;
-    static const uint8_t rec_data = 0x00;
-    static const uint8_t rec_eof = 0x01;
-    static const uint8_t rec_esa = 0x02;
+    static const unsigned char eof[] = ":00000001FF\n";
+    ihex_chunk chunks[MAX_WRITE_THREADS];
+    size_t num_segments, segment, length;
+    ssize_t nbytes = 0;
+    char *text;
+    int num_chunks, i;
 
-    size_t reclen;
-    uint16_t load_offset = 0;
-    uint32_t segment_base = 0;
-    char usba[2];
-    ssize_t recbytes = 0, nbytes = 0;
+    num_segments = (blob_size + SEGMENT_LENGTH - 1) / SEGMENT_LENGTH;
+    num_chunks = write_threads < MAX_WRITE_THREADS ? write_threads : MAX_WRITE_THREADS;
+    if ((size_t) num_chunks > num_segments / SEGMENTS_PER_THREAD) {
+	num_chunks = num_segments / SEGMENTS_PER_THREAD;
+    }
+    if (DEBUG) printf("%s: %zu bytes in %zu segments, records of %zu bytes, %d chunks\n",
+		      __func__, blob_size, num_segments, record_length, num_chunks);
 
-    while (blob_size) {
-	// Limit record to default length
-	if (blob_size < default_length) reclen = blob_size;
-	else reclen = default_length;
-	// Limit to current segment
-	if (load_offset + reclen > segment_length) reclen = segment_length - load_offset;
-	if (DEBUG) printf(_("%s: Record len=%zu source=%p rest=%zu USBA=%" PRIu32 "\n"),
-			  __func__, reclen, blob, blob_size, segment_base);
-
-	// Write record data
-	if (reclen) recbytes = ihex_write_single_record(out, reclen, load_offset, rec_data, blob);
-	if (recbytes < 0) return -nbytes;
-	nbytes += recbytes;
-
-	// Check segment size limit
-	if (load_offset < segment_length - reclen) {
-	    load_offset += reclen;
-	} else {
-	    // Restart with next segment
-	    ++segment_base;
-	    load_offset = 0;
-	    // Calculate Upper Segment Base Address in big-endian order
-	    usba[0] = (char) ((segment_base >> 0) & 0xFF);
-	    usba[1] = (char) ((segment_base >> 8) & 0xFF);
-	    ihex_write_single_record(out, sizeof(usba) / sizeof(*usba), 0, rec_esa, usba);
+    if (num_chunks > 1) {
+	for (i = 0; i < num_chunks; ++i) {
+	    chunks[i].blob = (const unsigned char*) blob;
+	    chunks[i].blob_size = blob_size;
+	    chunks[i].first = num_segments * i / num_chunks;
+	    chunks[i].last = num_segments * (i + 1) / num_chunks;
+	    chunks[i].text = NULL;
 	}
-	// Advance in source data
-	blob += reclen;
-	blob_size -= reclen;
+	nbytes = ihex_write_parallel(out, chunks, num_chunks);
+	if (nbytes < 0) return nbytes;
+    } else {
+	// Reuse a buffer large enough for any single segment
+	text = malloc(segments_text_size(blob_size, 0, 1));
+	if (! text) {
+	    fprintf(stderr, _("Could not allocate memory for Intel Hex records.\n"));
+	    return -3;
+	}
+	for (segment = 0; segment < num_segments; ++segment) {
+	    length = encode_segments(text, (const unsigned char*) blob, blob_size,
+				     segment, segment + 1) - text;
+	    if (fwrite(text, 1, length, out) != length) break;
+	    nbytes += segments_data_size(blob_size, segment, segment + 1);
+	}
+	free(text);
+	if (segment < num_segments) return -nbytes;
     }
-    // Write closing end-of-file record
-    recbytes = ihex_write_single_record(out, 0, 0, rec_eof, NULL);
-    if (recbytes < 0) return -nbytes;
-    else nbytes += recbytes;
 
+    // Write closing end-of-file record
+    if (fwrite(eof, 1, sizeof(eof) - 1, out) != sizeof(eof) - 1) return -nbytes;
     return nbytes;
 }
 
@@ -155,3 +354,125 @@ image_ihex_write_file(const char* restrict filename,
 
     return nbytes;
 }
+
+
+
+#ifdef TEST_IHEX_OUTPUT
+#include <time.h>
+
+///@brief Output a single record with one fprintf() per byte, as done before
+///@return Written record length or negative error code
+static int
+reference_write_record(FILE *out, uint8_t reclen, uint16_t load_offset, uint8_t rectyp,
+		       const char *data)
+{
+    uint8_t checksum, i;
+
+    if (fprintf(out, ":%02" PRIX8 "%04" PRIX16 "%02" PRIX8,
+		reclen, (unsigned) load_offset, rectyp) < 0) return -1;
+    checksum = reclen + ((load_offset >> 8) & 0xFF) + ((load_offset >> 0) & 0xFF) + rectyp;
+    for (i = 0; i < reclen; ++i) {
+	if (fprintf(out, "%02hhX", (unsigned char) data[i]) < 0) return -1;
+	checksum += data[i];
+    }
+    checksum = -checksum;
+    if (fprintf(out, "%02" PRIX8 "\n", checksum) < 0) return -1;
+    return reclen;
+}
+
+
+
+/// Generate records like the previous per-byte formatting implementation
+static void
+reference_write(FILE *out, const char *blob, size_t blob_size)
+{
+    uint16_t load_offset = 0;
+    uint32_t segment_base = 0, base;
+    size_t reclen;
+    char usba[2];
+
+    while (blob_size) {
+	reclen = blob_size < record_length ? blob_size : record_length;
+	if (load_offset + reclen > SEGMENT_LENGTH) reclen = SEGMENT_LENGTH - load_offset;
+	reference_write_record(out, reclen, load_offset, REC_DATA, blob);
+	if (load_offset < SEGMENT_LENGTH - reclen) load_offset += reclen;
+	else {
+	    ++segment_base;
+	    load_offset = 0;
+	    base = segment_base < ESA_SEGMENTS ? segment_base << 12 : segment_base;
+	    usba[0] = (char) ((base >> 8) & 0xFF);
+	    usba[1] = (char) ((base >> 0) & 0xFF);
+	    reference_write_record(out, sizeof(usba), 0,
+				   segment_base < ESA_SEGMENTS ? REC_ESA : REC_ELA, usba);
+	}
+	blob += reclen;
+	blob_size -= reclen;
+    }
+    reference_write_record(out, 0, 0, REC_EOF, NULL);
+}
+
+
+
+/// Time one writer to /dev/null, then return the text it produces
+static char*
+run_writer(const char *label, int reference, const char *blob, size_t blob_size, size_t *length)
+{
+    struct timespec start, end;
+    char *text = NULL;
+    FILE *out;
+    double ms;
+
+    out = fopen("/dev/null", "w");
+    if (! out) return NULL;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (reference) reference_write(out, blob, blob_size);
+    else ihex_write(out, blob, blob_size);
+    fflush(out);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    fclose(out);
+    ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+    printf("\t%-24s %8.2f ms  %7.1f MB/s\n", label, ms, blob_size / ms / 1e3);
+
+    out = open_memstream(&text, length);
+    if (! out) return NULL;
+    if (reference) reference_write(out, blob, blob_size);
+    else ihex_write(out, blob, blob_size);
+    fclose(out);
+    return text;
+}
+
+
+
+int
+main(int argc, char **argv)
+{
+    const size_t sizes[] = { 100, 0x10000, 0x10001, 1 << 20, 16 << 20 };
+    const size_t lengths[] = { IHEX_DEFAULT_RECORD_LENGTH, 0x30, IHEX_MAX_RECORD_LENGTH };
+    size_t s, l, i, ref_length, length;
+    char *blob, *ref, *text, label[32];
+    int threads = argc > 1 ? atoi(argv[1]) : 4;
+
+    for (s = 0; s < sizeof(sizes) / sizeof(*sizes); ++s) {
+	blob = malloc(sizes[s]);
+	if (! blob) return 1;
+	for (i = 0; i < sizes[s]; ++i) blob[i] = (char) (i * 2654435761U >> 13);
+	for (l = 0; l < sizeof(lengths) / sizeof(*lengths); ++l) {
+	    printf("%zu bytes, records of %zu bytes:\n", sizes[s], lengths[l]);
+	    image_ihex_record_length(lengths[l]);
+	    ref = run_writer("fprintf() per byte", 1, blob, sizes[s], &ref_length);
+	    image_ihex_write_threads(1);
+	    text = run_writer("table, 1 thread", 0, blob, sizes[s], &length);
+	    if (! ref || ! text || length != ref_length || memcmp(ref, text, length)) puts("\tFAIL");
+	    free(text);
+	    image_ihex_write_threads(threads);
+	    snprintf(label, sizeof(label), "table, %d threads", threads);
+	    text = run_writer(label, 0, blob, sizes[s], &length);
+	    if (! ref || ! text || length != ref_length || memcmp(ref, text, length)) puts("\tFAIL");
+	    free(text);
+	    free(ref);
+	}
+	free(blob);
+    }
+    return 0;
+}
+#endif
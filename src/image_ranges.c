@@ -0,0 +1,251 @@
+///@file
+///@brief	Sorted set of populated address ranges within an image
+///@copyright	Copyright (C) 2026  Andre Colomb
+///
+/// This file is part of elf-mangle.
+///
+/// This file is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU Lesser General Public License as
+/// published by the Free Software Foundation, either version 3 of the
+/// License, or (at your option) any later version.
+///
+/// elf-mangle is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+/// Lesser General Public License for more details.
+///
+/// You should have received a copy of the GNU Lesser General Public
+/// License along with this program.  If not, see
+/// <http://www.gnu.org/licenses/>.
+///
+///@author	Andre Colomb <src@andre.colomb.de>
+
+
+
+
+#include "config.h"
+
+#include "image_ranges.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+/// Compile diagnostic output messages?
+#define DEBUG 0
+
+
+
+int
+image_ranges_reserve(image_ranges *set, int count, size_t data_size)
+{
+    image_range *ranges;
+    unsigned char *data;
+
+    if (! set || count < 0) return -1;
+
+    if (count > set->size) {
+	ranges = realloc(set->ranges, count * sizeof(*ranges));
+	if (! ranges) return -3;
+	set->ranges = ranges;
+	set->size = count;
+    }
+    if (data_size > set->data_size) {
+	data = realloc(set->data, data_size);
+	if (! data) return -3;
+	set->data = data;
+	set->data_size = data_size;
+    }
+    return 0;
+}
+
+
+
+int
+image_ranges_add(image_ranges *set, size_t address, size_t length, const void *data)
+{
+    image_range *last;
+    size_t data_size;
+    int size;
+
+    if (! set || (length && ! data)) return -1;
+    if (! length) return 0;
+
+    if (set->data_length + length > set->data_size) {
+	data_size = set->data_size < 512 ? 1024 : set->data_size * 2;
+	while (data_size < set->data_length + length) data_size *= 2;
+	if (image_ranges_reserve(set, set->size, data_size) != 0) return -3;
+    }
+
+    // The last range's data always ends the buffer, so it can grow in place
+    last = set->count ? set->ranges + set->count - 1 : NULL;
+    if (last && address == last->address + last->length) last->length += length;
+    else {
+	if (last && address < last->address + last->length) set->unsorted = 1;
+	if (set->count >= set->size) {
+	    size = set->size < 8 ? 16 : set->size * 2;
+	    if (image_ranges_reserve(set, size, set->data_size) != 0) return -3;
+	}
+	last = set->ranges + set->count++;
+	last->address = address;
+	last->length = length;
+	last->data = set->data_length;
+    }
+    memcpy(set->data + set->data_length, data, length);
+    set->data_length += length;
+    return 0;
+}
+
+
+
+///@brief Locate the first range ending after an address by binary search
+///@return Index of the range or number of ranges if none found
+static int
+find_range(
+    const image_range *ranges,	///< [in] Ranges in ascending order
+    int count,			///< [in] Number of ranges
+    size_t address)		///< [in] Address to look up
+{
+    int low = 0, high = count, i;
+
+    while (low < high) {
+	i = low + (high - low) / 2;
+	if (ranges[i].address + ranges[i].length > address) high = i;
+	else low = i + 1;
+    }
+    return low;
+}
+
+
+
+///@brief Compare two ranges by address for qsort()
+///@details Ranges at the same address keep the order they were added in.
+///@return Negative, zero or positive for ascending order
+static int
+compare_address(const void *a, const void *b)
+{
+    const image_range *ra = a, *rb = b;
+
+    if (ra->address != rb->address) {
+	return (ra->address > rb->address) - (ra->address < rb->address);
+    }
+    return (ra->data > rb->data) - (ra->data < rb->data);
+}
+
+
+
+int
+image_ranges_sort(image_ranges *set)
+{
+    image_range *sorted, *joined, *range;
+    unsigned char *data = NULL;
+    size_t end, length = 0;
+    int count = 0, i;
+
+    if (! set) return -1;
+    if (! set->unsorted) return 0;
+
+    sorted = malloc(set->count * sizeof(*sorted));
+    joined = malloc(set->count * sizeof(*joined));
+    if (sorted && joined) {
+	memcpy(sorted, set->ranges, set->count * sizeof(*sorted));
+	qsort(sorted, set->count, sizeof(*sorted), compare_address);
+
+	// Join each range touching or overlapping the previous one
+	for (range = sorted; range < sorted + set->count; ++range) {
+	    end = range->address + range->length;
+	    if (count && range->address <= joined[count - 1].address + joined[count - 1].length) {
+		if (end > joined[count - 1].address + joined[count - 1].length) {
+		    joined[count - 1].length = end - joined[count - 1].address;
+		}
+	    } else joined[count++] = *range;
+	}
+	for (i = 0; i < count; ++i) {
+	    joined[i].data = length;
+	    length += joined[i].length;
+	}
+	data = malloc(length);
+    }
+    free(sorted);
+    if (! data) {
+	free(joined);
+	return -3;
+    }
+
+    // Copy in the order added, so later data overwrites earlier bytes
+    for (range = set->ranges; range < set->ranges + set->count; ++range) {
+	i = find_range(joined, count, range->address);
+	memcpy(data + joined[i].data + (range->address - joined[i].address),
+	       set->data + range->data, range->length);
+    }
+    if (DEBUG) printf("%s: joined %d ranges into %d, %zu of %zu bytes\n", __func__,
+		      set->count, count, length, set->data_length);
+
+    free(set->ranges);
+    free(set->data);
+    set->size = set->count;
+    set->ranges = joined;
+    set->count = count;
+    set->data = data;
+    set->data_length = set->data_size = length;
+    set->unsorted = 0;
+    return 0;
+}
+
+
+
+int
+image_ranges_find(const image_ranges *set, size_t address)
+{
+    if (! set) return 0;
+    return find_range(set->ranges, set->count, address);
+}
+
+
+
+size_t
+image_ranges_end(const image_ranges *set)
+{
+    if (! set || ! set->count) return 0;
+    return set->ranges[set->count - 1].address + set->ranges[set->count - 1].length;
+}
+
+
+
+void
+image_ranges_free(image_ranges *set)
+{
+    if (! set) return;
+    free(set->ranges);
+    free(set->data);
+    memset(set, 0, sizeof(*set));
+}
+
+
+
+#ifdef TEST_IMAGE_RANGES
+/// Test program with demo function calls
+int
+main(void)
+{
+    image_ranges set = { 0 };
+    const image_range *range;
+
+    image_ranges_add(&set, 0x08000000, 4, "abcd");
+    image_ranges_add(&set, 0x08000004, 4, "efgh");
+    image_ranges_add(&set, 0x08001000, 2, "xy");
+    image_ranges_add(&set, 0x08000006, 4, "GHIJ");	//overlapping, takes precedence
+    image_ranges_add(&set, 0x20, 3, "low");
+    image_ranges_add(&set, 0x08000002, 1, "C");
+    printf("unsorted %d, %d ranges\n", set.unsorted, set.count);
+    image_ranges_sort(&set);
+    for (range = set.ranges; range < set.ranges + set.count; ++range) {
+	printf("0x%08zx %2zu \"%.*s\"\n", range->address, range->length,
+	       (int) range->length, set.data + range->data);
+    }
+    printf("find 0x08000fff -> %d, end 0x%08zx\n",
+	   image_ranges_find(&set, 0x08000fff), image_ranges_end(&set));
+    image_ranges_free(&set);
+    return 0;
+}
+#endif
@@ -0,0 +1,105 @@
+///@file
+///@brief	Sorted set of populated address ranges within an image
+///@copyright	Copyright (C) 2026  Andre Colomb
+///
+/// This file is part of elf-mangle.
+///
+/// This file is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU Lesser General Public License as
+/// published by the Free Software Foundation, either version 3 of the
+/// License, or (at your option) any later version.
+///
+/// elf-mangle is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+/// Lesser General Public License for more details.
+///
+/// You should have received a copy of the GNU Lesser General Public
+/// License along with this program.  If not, see
+/// <http://www.gnu.org/licenses/>.
+///
+///@author	Andre Colomb <src@andre.colomb.de>
+
+
+
+
+#ifndef IMAGE_RANGES_H_
+#define IMAGE_RANGES_H_
+
+#include <stddef.h>
+
+
+/// Contiguous run of populated bytes within an image
+typedef struct image_range {
+    /// Address of the first byte
+    size_t		address;
+    /// Number of bytes
+    size_t		length;
+    /// Position of the bytes within the set's data buffer
+    size_t		data;
+} image_range;
+
+/// Populated ranges of an image, with memory proportional to the data
+typedef struct image_ranges {
+    /// Ranges in the order added, ascending by address once sorted
+    image_range*	ranges;
+    /// Number of ranges
+    int			count;
+    /// Allocated size of the ranges list
+    int			size;
+    /// Data bytes of all ranges
+    unsigned char*	data;
+    /// Number of data bytes used
+    size_t		data_length;
+    /// Allocated size of the data buffer
+    size_t		data_size;
+    /// Ranges were added out of order or overlapping
+    char		unsorted;
+} image_ranges;
+
+
+///@brief Reserve space for ranges and data to be added
+///@return Zero on success or negative error code
+int image_ranges_reserve(
+    image_ranges *set,		///< [in,out] Range set to extend
+    int count,			///< [in] Expected number of ranges
+    size_t data_size		///< [in] Expected number of data bytes
+);
+
+///@brief Add populated bytes to a range set
+///@details Data continuing the previously added range extends it.  Bytes
+///         added later take precedence over earlier ones at the same address.
+///@return Zero on success or negative error code
+int image_ranges_add(
+    image_ranges *set,		///< [in,out] Range set to extend
+    size_t address,		///< [in] Address of the first byte
+    size_t length,		///< [in] Number of bytes
+    const void *data		///< [in] Data bytes
+);
+
+///@brief Sort the ranges by address and join adjacent or overlapping ones
+///@details Sets built from ascending, non-overlapping data are left as is.
+///@return Zero on success or negative error code
+int image_ranges_sort(
+    image_ranges *set		///< [in,out] Range set to sort
+);
+
+///@brief Find the first range ending after an address in a sorted set
+///@return Index of the range or number of ranges if none found
+int image_ranges_find(
+    const image_ranges *set,	///< [in] Sorted range set
+    size_t address		///< [in] Address to look up
+);
+
+///@brief Determine the address after the last populated byte of a sorted set
+///@return End address or zero if empty
+size_t image_ranges_end(
+    const image_ranges *set	///< [in] Sorted range set
+);
+
+///@brief Release the memory used by a range set, leaving it empty
+void image_ranges_free(
+    image_ranges *set		///< [in,out] Range set to clear
+);
+
+#endif //IMAGE_RANGES_H_
@@ -0,0 +1,149 @@
+# Copyright (C) 2026  Andre Colomb
+#
+# This file is part of elf-mangle.
+#
+# This file is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as
+# published by the Free Software Foundation, either version 3 of the
+# License, or (at your option) any later version.
+#
+# elf-mangle is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this program.  If not, see
+# <http://www.gnu.org/licenses/>.
+
+
+# Generate a minimal perfect hash for the known_fields[] table.
+#
+# Reads the C source defining the table and writes a header for it,
+# declaring a constant nvm_field_hash named known_fields_hash.  Each
+# table entry must start on its own line with the expected size
+# followed by the quoted symbol name, as in
+#     { 3,	"nvm_unique",	N_("Unique system identification"),
+#
+# Duplicate symbol names are reported as an error, so the build fails
+# instead of silently hiding one of the descriptors.
+#
+# Only POSIX awk features are used.  All arithmetic is split into
+# 16-bit halves to stay exact within double precision.
+
+
+function mul32(a, b,	alo, ahi, blo, bhi)
+{
+    alo = a % 65536; ahi = int(a / 65536)
+    blo = b % 65536; bhi = int(b / 65536)
+    return (((ahi * blo + alo * bhi) % 65536) * 65536 + alo * blo) % 4294967296
+}
+
+function xor32(a, b,	result, bit)
+{
+    result = 0
+    for (bit = 1; a > 0 || b > 0; bit *= 2) {
+	if ((a % 2) != (b % 2)) result += bit
+	a = int(a / 2); b = int(b / 2)
+    }
+    return result
+}
+
+# Must match field_hash_name() in nvm_field.c
+function hash_name(name, seed,	hash, i, lo)
+{
+    hash = (2166136261 + seed) % 4294967296
+    for (i = 1; i <= length(name); ++i) {
+	lo = hash % 256
+	hash = hash - lo + xor32(lo, ord[substr(name, i, 1)])
+	hash = mul32(hash, 16777619)
+    }
+    return xor32(hash, int(hash / 65536))
+}
+
+
+BEGIN {
+    for (i = 1; i < 256; ++i) ord[sprintf("%c", i)] = i
+    n = 0
+    in_table = 0
+    error = 0
+}
+
+/known_fields\[\][ \t]*=[ \t]*\{/ { in_table = 1; next }
+
+in_table && /^[ \t]*\}[ \t]*;/ { in_table = 0; next }
+
+in_table && match($0, /^[ \t]*\{[^",{}]*,[ \t]*"[^"]*"/) {
+    entry = substr($0, RSTART, RLENGTH)
+    sub(/^[^"]*"/, "", entry)
+    sub(/"$/, "", entry)
+    if (entry in index_of) {
+	printf("%s:%d: duplicate known field \"%s\", first defined in line %d\n",
+	       FILENAME, FNR, entry, line_of[entry]) > "/dev/stderr"
+	error = 1
+    }
+    index_of[entry] = n
+    line_of[entry] = FNR
+    name[n++] = entry
+}
+
+END {
+    if (error) exit 1
+
+    # About one key per bucket keeps the displacement search short
+    buckets = n
+    for (k = 0; k < n; ++k) {
+	b = hash_name(name[k], 0) % buckets
+	f1[k] = hash_name(name[k], 1)
+	f2[k] = hash_name(name[k], 2)
+	members[b] = (b in members) ? members[b] " " k : k
+	count[b]++
+    }
+
+    # Place larger buckets first, while most slots are still free
+    for (s = 0; s < n; ++s) taken[s] = 0
+    for (size = n; size > 0; --size) {
+	for (b = 0; b < buckets; ++b) {
+	    if (count[b] != size) continue
+	    split(members[b], keys, " ")
+	    for (d = 0; ; ++d) {
+		if (d >= n * 65536) {
+		    print "known_fields_hash.awk: no perfect hash found" > "/dev/stderr"
+		    exit 1
+		}
+		d0 = int(d / n); d1 = d % n
+		ok = 1
+		for (i = 1; i <= size && ok; ++i) {
+		    s = (f1[keys[i]] + d0 * f2[keys[i]] + d1) % n
+		    if (taken[s]) ok = 0
+		    for (j = 1; j < i && ok; ++j) if (slot_of[keys[j]] == s) ok = 0
+		    slot_of[keys[i]] = s
+		}
+		if (ok) break
+	    }
+	    displace[b] = d
+	    for (i = 1; i <= size; ++i) {
+		taken[slot_of[keys[i]]] = 1
+		slot[slot_of[keys[i]]] = keys[i]
+	    }
+	}
+    }
+
+    print "/// Generated by known_fields_hash.awk from " FILENAME ", do not edit."
+    print ""
+    if (n == 0) {
+	print "static const nvm_field_hash known_fields_hash = { 0, NULL, 0, NULL };"
+	print "#define KNOWN_FIELDS_HASH_SIZE\t0"
+	exit 0
+    }
+    print "static const uint32_t known_fields_displace[] = {"
+    for (b = 0; b < buckets; ++b) printf("    %u,\n", (b in displace) ? displace[b] : 0)
+    print "};"
+    print "static const uint32_t known_fields_slots[] = {"
+    for (s = 0; s < n; ++s) printf("    %u,\t// %s\n", slot[s], name[slot[s]])
+    print "};"
+    print "static const nvm_field_hash known_fields_hash = {"
+    printf("    %u, known_fields_displace, %u, known_fields_slots\n", buckets, n)
+    print "};"
+    printf("#define KNOWN_FIELDS_HASH_SIZE\t%u\n", n)
+}
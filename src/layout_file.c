@@ -0,0 +1,312 @@
+///@file
+///@brief	Compiled symbol layouts stored in binary files
+///@copyright	Copyright (C) 2026  Andre Colomb
+///
+/// This file is part of elf-mangle.
+///
+/// This file is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU Lesser General Public License as
+/// published by the Free Software Foundation, either version 3 of the
+/// License, or (at your option) any later version.
+///
+/// elf-mangle is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+/// Lesser General Public License for more details.
+///
+/// You should have received a copy of the GNU Lesser General Public
+/// License along with this program.  If not, see
+/// <http://www.gnu.org/licenses/>.
+///
+///@author	Andre Colomb <src@andre.colomb.de>
+
+
+#include "config.h"
+
+#include "layout_file.h"
+#include "known_fields.h"
+#include "symbol_list.h"
+#include "nvm_field.h"
+#include "atomic_file.h"
+#include "intl.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+/// Compile diagnostic output messages?
+#define DEBUG 0
+
+
+
+/// Round up file offsets to keep records naturally aligned
+static inline uint64_t
+align_offset(uint64_t offset)
+{
+    return (offset + sizeof(uint64_t) - 1) & ~(uint64_t) (sizeof(uint64_t) - 1);
+}
+
+
+
+/// Check that a range of bytes lies completely within the file
+static inline int
+range_valid(uint64_t offset, uint64_t length, size_t size)
+{
+    return offset <= size && length <= size - offset;
+}
+
+
+
+int
+layout_file_identify(const char *data, size_t size)
+{
+    if (! data || size < sizeof(layout_file_header)) return 0;
+    return memcmp(data, LAYOUT_FILE_MAGIC, sizeof(LAYOUT_FILE_MAGIC)) == 0;
+}
+
+
+
+///@brief Validate the section records of a compiled layout
+///@return NULL if valid or error message
+static const char*
+check_sections(
+    const layout_file_header *header)	///< [in] Structurally checked layout file header
+{
+    const layout_file_section *section;
+    const layout_file_symbol *sym;
+    uint32_t i;
+
+    section = (const layout_file_section*) ((const char*) header + header->sections_offset);
+    for (i = 0; i < header->num_sections; ++i, ++section) {
+	if (section->name >= header->strings_size) return _("Corrupt string table");
+	if (section->first_symbol > header->num_symbols
+	    || section->num_symbols > header->num_symbols - section->first_symbol
+	    || section->blob_offset % sizeof(uint64_t) != 0) {
+	    return _("Corrupt section record");
+	}
+	sym = layout_file_symbols(header) + section->first_symbol;
+	for (; sym < layout_file_symbols(header) + section->first_symbol
+		 + section->num_symbols; ++sym) {
+	    if (sym->name >= header->strings_size
+		|| ! range_valid(sym->offset, sym->size, section->blob_size)) {
+		return _("Corrupt symbol record");
+	    }
+	}
+    }
+    return NULL;
+}
+
+
+
+const layout_file_header*
+layout_file_check(const char *data, size_t size, const char **errmsg)
+{
+    const layout_file_header *header = (const layout_file_header*) data;
+    const layout_file_section *section;
+    const char *message = NULL;
+    uint32_t i;
+
+    if (! layout_file_identify(data, size)) message = _("Not a layout file");
+    else if (header->byte_order != LAYOUT_FILE_BYTE_ORDER) {
+	message = _("Incompatible byte order");
+    } else if (header->version != LAYOUT_FILE_VERSION) {
+	message = _("Unsupported format version");
+    } else if (header->known_fields != (uint32_t) known_fields_expected()) {
+	// Symbol sizes and field bindings depend on the known fields table
+	message = _("Known fields changed");
+    } else if (header->sections_offset % sizeof(uint64_t) != 0
+	       || header->symbols_offset % sizeof(uint64_t) != 0
+	       || ! range_valid(header->sections_offset,
+				(uint64_t) header->num_sections * sizeof(*section), size)
+	       || ! range_valid(header->symbols_offset,
+				(uint64_t) header->num_symbols * sizeof(layout_file_symbol),
+				size)
+	       || ! range_valid(header->strings_offset, header->strings_size, size)) {
+	message = _("File truncated");
+    } else if (header->strings_size == 0
+	       || data[header->strings_offset + header->strings_size - 1] != '\0') {
+	message = _("Corrupt string table");
+    } else {
+	section = (const layout_file_section*) (data + header->sections_offset);
+	for (i = 0; i < header->num_sections; ++i) {
+	    if (! range_valid(section[i].blob_offset, section[i].blob_size, size)) {
+		message = _("File truncated");
+		break;
+	    }
+	}
+	if (! message) message = check_sections(header);
+    }
+
+    if (DEBUG && message) printf("%s: %s\n", __func__, message);
+    if (errmsg) *errmsg = message;
+    return message ? NULL : header;
+}
+
+
+
+const layout_file_section*
+layout_file_find_section(const layout_file_header *header, const char *section_name)
+{
+    const layout_file_section *section;
+    uint32_t i;
+
+    if (! header || ! section_name) return NULL;
+
+    section = (const layout_file_section*) ((const char*) header + header->sections_offset);
+    for (i = 0; i < header->num_sections; ++i, ++section) {
+	if (strcmp(layout_file_string(header, section->name), section_name) == 0) return section;
+    }
+    return NULL;
+}
+
+
+
+const layout_file_symbol*
+layout_file_symbols(const layout_file_header *header)
+{
+    return (const layout_file_symbol*) ((const char*) header + header->symbols_offset);
+}
+
+
+
+const char*
+layout_file_string(const layout_file_header *header, uint32_t index)
+{
+    return (const char*) header + header->strings_offset + index;
+}
+
+
+
+/// Header and contents of a layout file to write
+typedef struct layout_output {
+    /// Header with counts and string table size filled in, completed while writing
+    layout_file_header*		header;
+    /// Sections to store, @sa layout_file_write()
+    const layout_file_contents*	sections;
+} layout_output;
+
+
+
+/// Output zero bytes to reach the given file offset
+static inline int
+write_padding(FILE *out, uint64_t position, uint64_t target)
+{
+    static const char padding[sizeof(uint64_t)] = { 0 };
+    size_t gap = target - position;
+
+    return fwrite(padding, 1, gap, out) == gap ? 0 : -2;
+}
+
+
+
+///@brief Output the layout contents to an open stream
+///@return Zero on success or negative error code
+static int
+write_layout(
+    FILE *out,			///< [in] Output file stream
+    const void *arg)		///< [in] Layout to write, @sa layout_output
+{
+    const layout_output *output = arg;
+    layout_file_header *header = output->header;
+    const layout_file_contents *sections = output->sections;
+    layout_file_section section = { 0 };
+    layout_file_symbol record = { 0 };
+    uint32_t i, name, first;
+    uint64_t blob_offset;
+    int n;
+
+    // Arrange file sections following the header
+    header->sections_offset = align_offset(sizeof(*header));
+    header->symbols_offset = header->sections_offset + header->num_sections * sizeof(section);
+    header->strings_offset = header->symbols_offset + header->num_symbols * sizeof(record);
+    blob_offset = align_offset(header->strings_offset + header->strings_size);
+
+    if (fwrite(header, sizeof(*header), 1, out) != 1) return -2;
+    if (write_padding(out, sizeof(*header), header->sections_offset) != 0) return -2;
+
+    // Section names come first in the string table, followed by symbol names
+    name = first = 0;
+    for (i = 0; i < header->num_sections; ++i) {
+	section.blob_offset = blob_offset;
+	section.blob_size = sections[i].blob_size;
+	section.load_address = sections[i].load_address;
+	section.name = name;
+	section.first_symbol = first;
+	section.num_symbols = sections[i].num_symbols;
+	name += strlen(sections[i].section_name) + 1;
+	first += sections[i].num_symbols;
+	blob_offset = align_offset(blob_offset + sections[i].blob_size);
+	if (fwrite(&section, sizeof(section), 1, out) != 1) return -2;
+    }
+
+    for (i = 0; i < header->num_sections; ++i) {
+	for (n = 0; n < sections[i].num_symbols; ++n) {
+	    record.offset = sections[i].list[n].offset;
+	    record.size = sections[i].list[n].size;
+	    record.expected_size = sections[i].list[n].field->expected_size;
+	    record.name = name;
+	    name += strlen(sections[i].list[n].field->symbol) + 1;
+	    if (fwrite(&record, sizeof(record), 1, out) != 1) return -2;
+	}
+    }
+
+    for (i = 0; i < header->num_sections; ++i) {
+	if (fwrite(sections[i].section_name, strlen(sections[i].section_name) + 1, 1, out) != 1) {
+	    return -2;
+	}
+    }
+    for (i = 0; i < header->num_sections; ++i) {
+	for (n = 0; n < sections[i].num_symbols; ++n) {
+	    if (fwrite(sections[i].list[n].field->symbol,
+		       strlen(sections[i].list[n].field->symbol) + 1, 1, out) != 1) return -2;
+	}
+    }
+
+    blob_offset = header->strings_offset + header->strings_size;
+    for (i = 0; i < header->num_sections; ++i) {
+	if (write_padding(out, blob_offset, align_offset(blob_offset)) != 0) return -2;
+	blob_offset = align_offset(blob_offset);
+	if (sections[i].blob_size
+	    && fwrite(sections[i].blob, sections[i].blob_size, 1, out) != 1) return -2;
+	blob_offset += sections[i].blob_size;
+    }
+
+    return 0;
+}
+
+
+
+int
+layout_file_write(const char *filename, const layout_file_contents sections[],
+		  int num_sections)
+{
+    layout_file_header header = {
+	.magic		= LAYOUT_FILE_MAGIC,
+	.byte_order	= LAYOUT_FILE_BYTE_ORDER,
+	.version	= LAYOUT_FILE_VERSION,
+	.known_fields	= known_fields_expected(),
+	.num_sections	= num_sections,
+    };
+    layout_output output = { &header, sections };
+    int i, n, status;
+
+    if (! filename || ! sections || num_sections <= 0) return -1;
+
+    // Total symbol count and string table size, including NUL terminators
+    for (i = 0; i < num_sections; ++i) {
+	if (! sections[i].section_name || ! sections[i].blob || sections[i].num_symbols < 0
+	    || (sections[i].num_symbols && ! sections[i].list)) return -1;
+	header.num_symbols += sections[i].num_symbols;
+	header.strings_size += strlen(sections[i].section_name) + 1;
+	for (n = 0; n < sections[i].num_symbols; ++n) {
+	    if (! sections[i].list[n].field) return -1;
+	    header.strings_size += strlen(sections[i].list[n].field->symbol) + 1;
+	}
+    }
+
+    status = atomic_file_write(filename, _("layout file"), write_layout, &output);
+    if (DEBUG) printf("%s: %u sections, %u symbols -> %s (%d)\n", __func__,
+		      header.num_sections, header.num_symbols, filename, status);
+
+    return status;
+}
@@ -0,0 +1,168 @@
+///@file
+///@brief	Compiled symbol layouts stored in binary files
+///@copyright	Copyright (C) 2026  Andre Colomb
+///
+/// This file is part of elf-mangle.
+///
+/// This file is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU Lesser General Public License as
+/// published by the Free Software Foundation, either version 3 of the
+/// License, or (at your option) any later version.
+///
+/// elf-mangle is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+/// Lesser General Public License for more details.
+///
+/// You should have received a copy of the GNU Lesser General Public
+/// License along with this program.  If not, see
+/// <http://www.gnu.org/licenses/>.
+///
+///@author	Andre Colomb <src@andre.colomb.de>
+
+
+#ifndef LAYOUT_FILE_H_
+#define LAYOUT_FILE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+// Forward declarations
+typedef struct nvm_symbol nvm_symbol;
+
+
+/// Identification at the start of every layout file
+#define LAYOUT_FILE_MAGIC	"ELFMLAY"
+/// Format revision, incremented on any incompatible change
+#define LAYOUT_FILE_VERSION	4
+/// Marker to detect files written on a host with different byte order
+#define LAYOUT_FILE_BYTE_ORDER	0x01020304U
+
+
+/// File header of a compiled layout.
+///
+/// All values are stored in the writing host's byte order and offsets
+/// are counted from the start of the file.  The header is followed by
+/// the section records, the symbol records, the string table and each
+/// section's default binary data, in that order.
+typedef struct layout_file_header {
+    /// Identification string including NUL terminator
+    char		magic[8];
+    /// Byte order marker, must equal LAYOUT_FILE_BYTE_ORDER
+    uint32_t		byte_order;
+    /// Format revision, must equal LAYOUT_FILE_VERSION
+    uint32_t		version;
+    /// Number of symbol records
+    uint32_t		num_symbols;
+    /// Number of section records
+    uint32_t		num_sections;
+    /// Number of known fields in the writing program
+    uint32_t		known_fields;
+    /// Unused, for alignment
+    uint32_t		reserved;
+    /// Location of the first section record
+    uint64_t		sections_offset;
+    /// Location of the first symbol record
+    uint64_t		symbols_offset;
+    /// Location of the string table
+    uint64_t		strings_offset;
+    /// Size of the string table in bytes
+    uint64_t		strings_size;
+} layout_file_header;
+
+/// Record describing one section within a compiled layout
+typedef struct layout_file_section {
+    /// Location of the section's default binary data
+    uint64_t		blob_offset;
+    /// Size of the section's binary data in bytes
+    uint64_t		blob_size;
+    /// Address where the section's data is loaded on the target
+    uint64_t		load_address;
+    /// String table index of the section name
+    uint32_t		name;
+    /// Index of the section's first symbol record
+    uint32_t		first_symbol;
+    /// Number of consecutive symbol records belonging to the section
+    uint32_t		num_symbols;
+    /// Unused, for alignment
+    uint32_t		reserved;
+} layout_file_section;
+
+/// Record describing one symbol within a compiled layout
+typedef struct layout_file_symbol {
+    /// Position of the data within the section's blob
+    uint64_t		offset;
+    /// Size of the data field in bytes, after any resizing
+    uint64_t		size;
+    /// Expected size to record for an unknown field
+    uint64_t		expected_size;
+    /// String table index of the symbol name
+    uint32_t		name;
+    /// Unused, for alignment
+    uint32_t		reserved;
+} layout_file_symbol;
+
+/// Description of one section to be written into a compiled layout
+typedef struct layout_file_contents {
+    /// Name of the section described
+    const char*		section_name;
+    /// Default binary data of the section
+    const char*		blob;
+    /// Size of the binary data in bytes
+    size_t		blob_size;
+    /// Address where the data is loaded on the target
+    size_t		load_address;
+    /// List of symbols in the section
+    const nvm_symbol*	list;
+    /// Number of symbols in the list
+    int			num_symbols;
+} layout_file_contents;
+
+
+///@brief Check whether memory contents look like a compiled layout
+///@return Non-zero if the identification string matches
+int layout_file_identify(
+    const char *data,		///< [in] Start of file contents
+    size_t size			///< [in] Size of file contents in bytes
+);
+
+///@brief Validate the structure of a compiled layout in memory
+///@return Address of the file header or NULL on error
+const layout_file_header* layout_file_check(
+    const char *data,		///< [in] Start of file contents
+    size_t size,		///< [in] Size of file contents in bytes
+    const char **errmsg		///< [out] Reason why the layout is invalid
+);
+
+///@brief Look up a section by name in a validated layout
+///@return Address of the section record or NULL if not contained
+const layout_file_section* layout_file_find_section(
+    const layout_file_header *header,	///< [in] Validated layout file header
+    const char *section_name		///< [in] Name of the section to find
+);
+
+///@brief Access the list of symbol records in a validated layout
+///@return Address of the first symbol record
+const layout_file_symbol* layout_file_symbols(
+    const layout_file_header *header	///< [in] Validated layout file header
+);
+
+///@brief Access a string in a validated layout
+///@return Address of the NUL-terminated string
+const char* layout_file_string(
+    const layout_file_header *header,	///< [in] Validated layout file header
+    uint32_t index			///< [in] String table index
+);
+
+///@brief Write a compiled layout for the given symbols and section data
+///@details The file is replaced atomically, so concurrent readers never see
+///         a partially written layout.
+///@return Zero on success or negative error code
+int layout_file_write(
+    const char *filename,	///< [in] Output file path
+    const layout_file_contents sections[],	///< [in] Sections to describe
+    int num_sections		///< [in] Number of sections
+);
+
+#endif //LAYOUT_FILE_H_
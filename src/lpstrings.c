@@ -1,6 +1,6 @@
 ///@file
 ///@brief	Main program logic for lpstrings utility
-///@copyright	Copyright (C) 2016  Andre Colomb
+///@copyright	Copyright (C) 2016, 2026  Andre Colomb
 ///
 /// This file is part of elf-mangle.
 ///
@@ -24,6 +24,7 @@
 #include "config.h"
 
 #include "options.h"
+#include "image_ranges.h"
 #include "gettext.h"
 
 #include <locale.h>
@@ -31,27 +32,28 @@
 
 
 ///@brief Process binary data according to application arguments
+///@details Each populated address range of the image is scanned separately.
 ///@return Number of strings found or negative error code
 static int
 process_image(const tool_config *config)
 {
+    image_ranges ranges = { 0 };
+    const image_range *range;
     int status, ret_code = 0;
-    const char *blob_address;
-    size_t blob_size;
-
-    // Read input symbol layout and associated image data
-    status = image_memorize_file(	//input image loaded
-	config->image_in, &blob_address, &blob_size, config->format_in);
-    if (status > 0) {
-	// Scan for strings
-	ret_code = nvm_string_list(
-	    blob_address, blob_size,
+
+    // Read input image data
+    status = image_read_ranges(config->image_in, &ranges, config->format_in);
+    if (status <= 0) return status;	//propagate error code
+
+    // Scan for strings
+    for (range = ranges.ranges; range < ranges.ranges + ranges.count; ++range) {
+	ret_code += nvm_string_list(
+	    (const char*) ranges.data + range->data, range->length, range->address,
 	    config->lpstring_min,
 	    config->offset_radix * (config->show_fields & showByteSize ? -1 : 1),
 	    config->lpstring_delim);
-    } else {
-	ret_code = status;	//propagate error code
     }
+    image_ranges_free(&ranges);
 
     return ret_code;
 }
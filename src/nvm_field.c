@@ -1,6 +1,6 @@
 ///@file
 ///@brief	Helper functions to handle data field descriptors
-///@copyright	Copyright (C) 2014, 2015  Andre Colomb
+///@copyright	Copyright (C) 2014, 2015, 2026  Andre Colomb
 ///
 /// This file is part of elf-mangle.
 ///
@@ -28,6 +28,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <inttypes.h>
 
 /// Compile diagnostic output messages?
 #define DEBUG 0
@@ -52,6 +53,47 @@ find_field(const char *symbol,
 
 
 
+uint32_t
+field_hash_name(const char *symbol, uint32_t seed)
+{
+    uint32_t hash = 2166136261U + seed;
+
+    // FNV-1a with varying offset basis and final mixing of the upper bits
+    while (*symbol) {
+	hash ^= (unsigned char) *symbol++;
+	hash *= 16777619U;
+    }
+    return hash ^ (hash >> 16);
+}
+
+
+
+const nvm_field*
+find_field_hashed(const char *symbol,
+		  const nvm_field fields[], size_t num_fields,
+		  const nvm_field_hash *hash)
+{
+    uint32_t bucket, d0, d1, slot, index;
+
+    if (! hash || hash->num_slots != num_fields || ! hash->num_buckets) {
+	return find_field(symbol, fields, num_fields);
+    }
+
+    bucket = field_hash_name(symbol, 0) % hash->num_buckets;
+    d0 = hash->displace[bucket] / hash->num_slots;
+    d1 = hash->displace[bucket] % hash->num_slots;
+    slot = ((uint64_t) field_hash_name(symbol, 1)
+	    + (uint64_t) d0 * field_hash_name(symbol, 2) + d1) % hash->num_slots;
+    index = hash->slots[slot];
+    if (DEBUG) printf("%s: %s -> bucket %" PRIu32 " slot %" PRIu32 " (%s)\n", __func__,
+		      symbol, bucket, slot, fields[index].symbol);
+
+    if (index < num_fields && strcmp(fields[index].symbol, symbol) == 0) return &fields[index];
+    return NULL;
+}
+
+
+
 size_t
 copy_field_verbatim(const nvm_field *field __attribute__((unused)),
 		    char *dst, const char *src,
@@ -1,6 +1,6 @@
 ///@file
 ///@brief	Description of data fields associated with symbols
-///@copyright	Copyright (C) 2014, 2015  Andre Colomb
+///@copyright	Copyright (C) 2014, 2015, 2026  Andre Colomb
 ///
 /// This file is part of elf-mangle.
 ///
@@ -25,6 +25,7 @@
 #define NVM_FIELD_H_
 
 #include <stddef.h>
+#include <stdint.h>
 
 
 // Forward declaration
@@ -78,6 +79,43 @@ const nvm_field* find_field(
     size_t num_fields		///< [in] Number of elements in the vector
 );
 
+/// Minimal perfect hash over a vector of field descriptors.
+///
+/// A symbol name is assigned to one of the buckets by its first hash
+/// value.  The bucket's displacement then combines two further hash
+/// values into a unique slot, which stores the index of the only field
+/// descriptor that may match.  Tables are generated at build time from
+/// the field vector, see known_fields_hash.awk.
+typedef struct nvm_field_hash {
+    /// Number of buckets
+    uint32_t		num_buckets;
+    /// Displacement per bucket, encoded as d0 * num_slots + d1
+    const uint32_t*	displace;
+    /// Number of slots, equal to the number of field descriptors
+    uint32_t		num_slots;
+    /// Field descriptor index per slot
+    const uint32_t*	slots;
+} nvm_field_hash;
+
+///@brief Calculate the hash value of a symbol name
+///@details Must match the hash function in known_fields_hash.awk.
+///@return Seeded 32-bit hash value
+uint32_t field_hash_name(
+    const char *symbol,		///< [in] Symbol name
+    uint32_t seed		///< [in] Selects one of several hash functions
+);
+
+///@brief Find the field descriptor matching a symbol name using a perfect hash
+///@details Falls back to find_field() if no hash is given or it does not
+///         match the vector size.
+///@return Address of the field descriptor or NULL on error
+const nvm_field* find_field_hashed(
+    const char *symbol,		///< [in] Symbol name to look for
+    const nvm_field fields[],	///< [in] Vector of field descriptors
+    size_t num_fields,		///< [in] Number of elements in the vector
+    const nvm_field_hash *hash	///< [in] Perfect hash generated for the vector
+);
+
 ///@brief Copy data field content byte-wise
 ///@see field_copy_f
 size_t copy_field_verbatim(
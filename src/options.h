@@ -1,6 +1,6 @@
 ///@file
 ///@brief	Command line parsing
-///@copyright	Copyright (C) 2014, 2016, 2023  Andre Colomb
+///@copyright	Copyright (C) 2014, 2016, 2023, 2026  Andre Colomb
 ///
 /// This file is part of elf-mangle.
 ///
@@ -26,43 +26,83 @@
 
 #include "print_symbols.h"
 #include "image_formats.h"
+#include "image_ihex.h"
 #include "find_string.h"
+#include "serial_range.h"
+
+
+// Forward declarations
+typedef struct override_list override_list;
 
 
 /// Default ELF section to use
 #define DEFAULT_SECTION		".eeprom"
+/// Maximum number of ELF sections to examine at once
+#define MAX_SECTIONS		16
+/// Maximum number of map files in a migration chain
+#define MAX_MAP_FILES		32
+/// Placeholder for the section name in image file names
+#define SECTION_PLACEHOLDER	"%s"
 
 
 /// Application options
 typedef struct tool_config {
-    /// Names of input and output map files
-    const char*		map_files[2];
-    /// ELF section name to examine
-    const char*		section;
-    /// Name of the input image file
+    /// Names of input, intermediate and output map files
+    const char*		map_files[MAX_MAP_FILES];
+    /// Number of map files given
+    int			num_map_files;
+    /// ELF section names to examine
+    const char*		sections[MAX_SECTIONS];
+    /// Number of ELF sections to examine
+    int			num_sections;
+    /// Name of the input image file, may contain a section placeholder
     const char*		image_in;
-    /// Name of the output image file
+    /// Name of the output image file, may contain a section placeholder
     const char*		image_out;
     /// Format of the input image file
     enum image_format	format_in;
+    /// Relation of Intel Hex input addresses to the section's load address
+    enum ihex_addressing	input_addressing;
     /// Format of the output image file
     enum image_format	format_out;
+    /// Number of data bytes per Intel Hex output record, zero for the default
+    int			record_length;
+    /// Read Intel Hex input images through sidecar record index files
+    char		ihex_index;
     /// Locate strings of this minimum length within image
     int			lpstring_min;
     /// Output separator between located strings
     char*		lpstring_delim;
     /// Print out the total section image size in bytes
     char		show_size;
+    /// Print out the layout fingerprint of each parsed map
+    char		show_fingerprint;
     /// Number base for displaying address offsets and sizes
     signed char		offset_radix;
     /// Configuration flags for dumping symbol descriptions
     enum show_field	show_fields;
     /// Configuration flags for dumping symbol content
     enum print_content	print_content;
-    /// Override specification, comma-separated "field=<hexbytes>" pairs
-    char*		overrides;	///<@note Must be a heap address valid for free()
+    /// Override definitions, "field=<hexbytes>" pairs in the order given
+    override_list*	overrides;	///<@note Release with override_list_free()
     /// Override specification file to read from
     char*		overrides_file;
+    /// Binary override definitions, "field=<file>" pairs or directory names
+    const char**	binary_overrides;	///<@note Must be a heap address valid for free()
+    /// Number of binary override definitions
+    int			num_binary_overrides;
+    /// Compiled layout file to write for the input map
+    const char*		layout_out;
+    /// Directory for caching compiled layouts
+    const char*		layout_cache;
+    /// Maximum number of threads for scanning symbol tables, batch processing and encoding
+    int			threads;
+    /// List of input and output image file pairs to process in batch mode
+    const char*		batch_file;
+    /// Table of per-device field values to write one output image each
+    const char*		provision_file;
+    /// Counter values to write one output image each
+    serial_range	serial;
 } tool_config;
 
 
@@ -1,6 +1,6 @@
 ///@file
 ///@brief	Command line parsing for elf-mangle utility
-///@copyright	Copyright (C) 2014, 2015, 2016, 2023  Andre Colomb
+///@copyright	Copyright (C) 2014, 2015, 2016, 2023, 2026  Andre Colomb
 ///
 /// This file is part of elf-mangle.
 ///
@@ -25,10 +25,14 @@
 
 #include "options.h"
 #include "override.h"
+#include "serial_range.h"
+#include "image_ihex.h"
+#include "ihex_index.h"
 #include "find_string.h"
 #include "intl.h"
 
 #include <argp.h>
+#include <unistd.h>
 #include <string.h>
 #include <stdlib.h>
 
@@ -50,6 +54,19 @@
 #define OPT_FIELD_SIZE		'F'
 #define OPT_CHANGED		'c'
 #define OPT_SECTION_SIZE	's'
+// Long options only, outside the range of ASCII characters
+#define OPT_EMIT_LAYOUT		0x100
+#define OPT_LAYOUT_CACHE	0x101
+#define OPT_THREADS		0x102
+#define OPT_FINGERPRINT		0x103
+#define OPT_BATCH		0x104
+#define OPT_PROVISION		0x105
+#define OPT_DEFINE_BINARY	0x106
+#define OPT_SERIAL_RANGE	0x107
+#define OPT_SERIAL_FIELD	0x108
+#define OPT_RECORD_LENGTH	0x109
+#define OPT_IHEX_INDEX		0x10A
+#define OPT_INPUT_ADDRESSES	0x10B
 ///@}
 
 /// Helper macro to show number literals in option help
@@ -64,18 +81,21 @@ static const struct argp_option options[] = {
       N_("Input / output options:"),				0 },
     { "section",	OPT_SECTION,	N_("SECTION"),		0,
       N_("Use SECTION from ELF file instead of the default ("
-	 DEFAULT_SECTION ")"),					0 },
+	 DEFAULT_SECTION ").  May be given multiple times to process several"
+	 " sections at once, which requires a " SECTION_PLACEHOLDER
+	 " placeholder for the section name in any image FILE"),	0 },
     { "input",		OPT_INPUT,	N_("FILE"),		0,
       N_("Read binary input data from image FILE"),		0 },
     { "input-image",	OPT_INPUT,	NULL,			OPTION_ALIAS | OPTION_HIDDEN,
       NULL,							0 },
     { "input-format",	OPT_IN_FORMAT,	N_("FORMAT"),		0,
       N_("Format of input image file.  FORMAT can be either"
-	 " \"raw\""
-#if HAVE_INTELHEX
-	 ", \"ihex\""
-#endif
-	 " or \"auto\" (default)"),				0 },
+	 " \"raw\", \"ihex\" or \"auto\" (default)"),		0 },
+    { "input-addresses",	OPT_INPUT_ADDRESSES,	N_("MODE"),	0,
+      N_("Where the section's data starts in Intel Hex input files.  MODE can"
+	 " be \"relative\" for address zero, \"absolute\" for the section's"
+	 " load address or \"auto\" (default) for the load address only if no"
+	 " data lies below it"),					0 },
     { "output",		OPT_OUTPUT,	N_("FILE"),		0,
       N_("Write binary data to output image FILE"),		0 },
     { "output-image",	OPT_OUTPUT,	NULL,			OPTION_ALIAS | OPTION_HIDDEN,
@@ -83,16 +103,61 @@ static const struct argp_option options[] = {
     { "output-format",	OPT_OUT_FORMAT,	N_("FORMAT"),		0,
       N_("Format of output image file.  FORMAT can be either"
 	 " \"raw\" or \"ihex\" (default)"),			0 },
+    { "record-length",	OPT_RECORD_LENGTH,	N_("BYTES"),	0,
+      N_("Number of data BYTES in each record of Intel Hex output images,"
+	 " from 1 to 255 (default 32)"),			0 },
+    { "ihex-index",	OPT_IHEX_INDEX,	NULL,			0,
+      N_("Keep an index of the records in each Intel Hex input image, stored"
+	 " next to it with an added " IHEX_INDEX_SUFFIX " extension.  Later"
+	 " runs then read only the records needed for the fields in the map,"
+	 " until the image file changes"),			0 },
     { "define",		OPT_DEFINE,	N_("FIELD=BYTES,..."),	0,
       N_("Override the given fields' values (comma-separated pairs).\n"
 	 "Each FIELD symbol name must be followed by an equal sign and the data"
 	 " BYTES encoded in hexadecimal.  Missing bytes are left unchanged,"
-	 " extra data generates an error."),			0 },
+	 " extra data is ignored with a warning."),			0 },
     { "define-from",	OPT_DEFS_FROM,	N_("FILE"),		0,
       N_("Read override field=value pairs from FILE.\n"
 	 "Like the --define option, but accepts pairs separated"
 	 " by comma or newlines.  If FILE is -, the list will be read"
 	 " from standard input."),				0 },
+    { "define-binary",	OPT_DEFINE_BINARY,	N_("FIELD=FILE"),	0,
+      N_("Override the given field's value with the contents of binary FILE,"
+	 " which must not exceed the field's size.  If a directory DIR is given"
+	 " instead, each file named FIELD.bin within it overrides the respective"
+	 " field.  May be given multiple times"),		0 },
+    { "emit-layout",	OPT_EMIT_LAYOUT,	N_("FILE"),	0,
+      N_("Write the parsed input map layout to a compiled FILE, which can"
+	 " later be used in place of the ELF file as IN_MAP or OUT_MAP"), 0 },
+    { "layout-cache",	OPT_LAYOUT_CACHE,	N_("DIR"),	0,
+      N_("Cache compiled layouts of ELF files with a build ID in DIR,"
+	 " to skip parsing them again on subsequent runs"),	0 },
+    { "batch",		OPT_BATCH,	N_("FILE"),		0,
+      N_("Process many images with the same maps, parsed only once.  Each"
+	 " line of FILE names an input and an output image file, separated by"
+	 " white-space.  If FILE is -, the list will be read from standard"
+	 " input.  Display options do not apply to the images."),	0 },
+    { "provision",	OPT_PROVISION,	N_("FILE"),		0,
+      N_("Write one output image per device listed in the CSV or TSV table"
+	 " FILE.  The header line names the output image file column, followed"
+	 " by field symbol names.  Each further line holds a device's image file"
+	 " name and field values as hexadecimal BYTES.  If FILE is -, the table"
+	 " will be read from standard input."),		0 },
+    { "serial-range",	OPT_SERIAL_RANGE,	N_("FIRST-LAST[:STEP]"),	0,
+      N_("Write one output image for each serial number from FIRST to LAST,"
+	 " counting up by STEP (default 1).  The output image FILE name must"
+	 " contain a printf() integer conversion like %05d for the number"), 0 },
+    { "serial-field",	OPT_SERIAL_FIELD,	N_("FIELD[:OPT...]"),	0,
+      N_("Store serial numbers in FIELD.  Options \"be\" or \"le\" select"
+	 " the byte order (little-endian by default), a number limits how many"
+	 " BYTES are written"),					0 },
+#if HAVE_PTHREADS
+    { "threads",	OPT_THREADS,	N_("N"),		OPTION_ARG_OPTIONAL,
+      N_("Scan large ELF symbol tables, process batch images and encode large"
+	 " Intel Hex images using up to N parallel threads (argument defaults"
+	 " to the number of processors if omitted, batch images always use"
+	 " them)"),						0 },
+#endif
 
     { NULL,		0,		NULL,			0,
       N_("Display information from parsed files:"),		0 },
@@ -109,6 +174,9 @@ static const struct argp_option options[] = {
       N_("Print only symbols differing from output map"),	0 },
     { "section-size",	OPT_SECTION_SIZE,	NULL,		0,
       N_("Print size in bytes for the whole image"),		0 },
+    { "fingerprint",	OPT_FINGERPRINT,	NULL,		0,
+      N_("Print a hash identifying each map's symbol layout.  Maps with"
+	 " equal fingerprints need no data migration between them"),	0 },
     { "strings",	OPT_STRINGS,	N_("MIN-LEN"),		OPTION_ARG_OPTIONAL,
       N_("Locate strings of at least MIN-LEN bytes in input"
 	 " (argument defaults to " _STR_MACRO(FIND_STRING_DEFAULT_LENGTH)
@@ -119,7 +187,7 @@ static const struct argp_option options[] = {
 
 
 /// Non-option arguments shown in help texts
-static const char args_doc[] = N_("IN_MAP [OUT_MAP]");
+static const char args_doc[] = N_("IN_MAP [[VIA_MAP...] OUT_MAP]");
 
 /// Program short description
 static const char doc[] =
@@ -141,6 +209,8 @@ parse_opt(
     // Retreive the input argument from argp_parse
     struct tool_config *tool = state->input;
     const struct argp_child *child;
+    const char **definitions;
+    int i;
 
     switch (key) {
     case ARGP_KEY_INIT:
@@ -152,7 +222,14 @@ parse_opt(
 	break;
 
     case OPT_SECTION:
-	tool->section = arg;
+	for (i = 0; i < tool->num_sections; ++i) {
+	    if (strcmp(tool->sections[i], arg) == 0) {
+		argp_error(state, _("Section `%s' specified more than once."), arg);
+	    }
+	}
+	if (tool->num_sections >= MAX_SECTIONS) {
+	    argp_error(state, _("Too many sections, at most %d are supported."), MAX_SECTIONS);
+	} else tool->sections[tool->num_sections++] = arg;
 	break;
 
     case OPT_INPUT:
@@ -167,12 +244,18 @@ parse_opt(
 	if (arg == NULL) return EINVAL;
 	else if (strcmp(arg, "auto") == 0) tool->format_in = formatNone;
 	else if (strcmp(arg, "raw") == 0) tool->format_in = formatRawBinary;
-#if HAVE_INTELHEX
 	else if (strcmp(arg, "ihex") == 0) tool->format_in = formatIntelHex;
-#endif
 	else argp_error(state, _("Invalid binary image format `%s' specified."), arg);
 	break;
 
+    case OPT_INPUT_ADDRESSES:
+	if (arg == NULL) return EINVAL;
+	else if (strcmp(arg, "auto") == 0) tool->input_addressing = addressingAuto;
+	else if (strcmp(arg, "relative") == 0) tool->input_addressing = addressingRelative;
+	else if (strcmp(arg, "absolute") == 0) tool->input_addressing = addressingAbsolute;
+	else argp_error(state, _("Invalid address interpretation `%s' specified."), arg);
+	break;
+
     case OPT_OUT_FORMAT:
 	if (arg == NULL) return EINVAL;
 	else if (strcmp(arg, "raw") == 0) tool->format_out = formatRawBinary;
@@ -180,14 +263,73 @@ parse_opt(
 	else argp_error(state, _("Invalid binary image format `%s' specified."), arg);
 	break;
 
+    case OPT_RECORD_LENGTH:
+	tool->record_length = atoi(arg);
+	if (tool->record_length < 1 || tool->record_length > IHEX_MAX_RECORD_LENGTH) {
+	    argp_error(state, _("Invalid record length `%s' specified."), arg);
+	}
+	break;
+
+    case OPT_IHEX_INDEX:
+	tool->ihex_index = 1;
+	break;
+
     case OPT_DEFINE:
-	tool->overrides = override_append(tool->overrides, "%s", arg);
+	if (override_list_add(&tool->overrides, "%s", arg) < 0) return ENOMEM;
 	break;
 
     case OPT_DEFS_FROM:
 	tool->overrides_file = arg;
 	break;
 
+    case OPT_DEFINE_BINARY:
+	definitions = realloc(tool->binary_overrides,
+			      (tool->num_binary_overrides + 1) * sizeof(*definitions));
+	if (! definitions) return ENOMEM;
+	definitions[tool->num_binary_overrides++] = arg;
+	tool->binary_overrides = definitions;
+	break;
+
+    case OPT_SERIAL_RANGE:
+	if (serial_range_parse(&tool->serial, arg) != 0) {
+	    argp_error(state, _("Invalid serial number range `%s' specified."), arg);
+	}
+	break;
+
+    case OPT_SERIAL_FIELD:
+	if (serial_range_parse_field(&tool->serial, arg) != 0) {
+	    argp_error(state, _("Invalid serial number field `%s' specified."), arg);
+	}
+	break;
+
+    case OPT_EMIT_LAYOUT:
+	tool->layout_out = arg;
+	break;
+
+    case OPT_LAYOUT_CACHE:
+	tool->layout_cache = arg;
+	break;
+
+    case OPT_BATCH:
+	tool->batch_file = arg;
+	break;
+
+    case OPT_PROVISION:
+	tool->provision_file = arg;
+	break;
+
+#if HAVE_PTHREADS
+    case OPT_THREADS:
+	if (arg == NULL) {
+	    tool->threads = sysconf(_SC_NPROCESSORS_ONLN);
+	    if (tool->threads < 1) tool->threads = 1;
+	} else tool->threads = atoi(arg);
+	if (tool->threads < 1) {
+	    argp_error(state, _("Invalid number of threads `%s'."), arg);
+	}
+	break;
+#endif
+
     case OPT_STRINGS:
 	if (arg == NULL) tool->lpstring_min = 0;
 	else tool->lpstring_min = atoi(arg);
@@ -229,16 +371,61 @@ parse_opt(
 	tool->show_size = 1;
 	break;
 
+    case OPT_FINGERPRINT:
+	tool->show_fingerprint = 1;
+	break;
+
     case ARGP_KEY_ARG:	/* non-option -> input / output file name */
 	// Check number of non-option arguments
-	if (state->arg_num >= sizeof(tool->map_files) / sizeof(*tool->map_files))
+	if (state->arg_num >= MAX_MAP_FILES)
 	    argp_error(state, _("Too many map file arguments."));
-	else tool->map_files[state->arg_num] = arg;
+	else tool->map_files[tool->num_map_files++] = arg;
 	break;
 
     case ARGP_KEY_NO_ARGS:
 	argp_error(state, _("Missing file name."));
-	// Fall through
+	break;
+
+    case ARGP_KEY_END:
+	if (! tool->num_sections) tool->sections[tool->num_sections++] = DEFAULT_SECTION;
+	// Distinct image files are needed for each section
+	if (tool->num_sections > 1
+	    && ((tool->image_in && ! strstr(tool->image_in, SECTION_PLACEHOLDER))
+		|| (tool->image_out && ! strstr(tool->image_out, SECTION_PLACEHOLDER)))) {
+	    argp_error(state, _("Image file names must contain a %s placeholder"
+				" for multiple sections."), SECTION_PLACEHOLDER);
+	}
+	// Batch mode provides the image files and may read from standard input once
+	if (tool->batch_file && (tool->image_in || tool->image_out)) {
+	    argp_error(state, _("Batch mode cannot be combined with image file options."));
+	} else if (tool->batch_file && tool->overrides_file
+		   && strcmp(tool->batch_file, "-") == 0
+		   && strcmp(tool->overrides_file, "-") == 0) {
+	    argp_error(state, _("Overrides and batch file list cannot both be read"
+				" from standard input."));
+	}
+	// Provisioning names an output image for each device
+	if (tool->provision_file && (tool->batch_file || tool->image_out)) {
+	    argp_error(state, _("Provisioning cannot be combined with batch mode or"
+				" an output image file."));
+	} else if (tool->provision_file && tool->overrides_file
+		   && strcmp(tool->provision_file, "-") == 0
+		   && strcmp(tool->overrides_file, "-") == 0) {
+	    argp_error(state, _("Overrides and provisioning table cannot both be read"
+				" from standard input."));
+	}
+	// Serial numbers produce output image names from a template
+	if (tool->serial.count && (tool->batch_file || tool->provision_file)) {
+	    argp_error(state, _("Serial number ranges cannot be combined with batch mode"
+				" or provisioning."));
+	} else if (tool->serial.count && ! tool->serial.field) {
+	    argp_error(state, _("No field specified for serial numbers."));
+	} else if (tool->serial.count && serial_range_check_template(tool->image_out) != 0) {
+	    argp_error(state, _("Output image file name must contain one integer conversion"
+				" for serial numbers."));
+	}
+	break;
+
     case ARGP_KEY_FINI:
 	break;
 
@@ -1,6 +1,6 @@
 ///@file
 ///@brief	Command line parsing for lpstrings utility
-///@copyright	Copyright (C) 2016  Andre Colomb
+///@copyright	Copyright (C) 2016, 2026  Andre Colomb
 ///
 /// This file is part of elf-mangle.
 ///
@@ -54,11 +54,7 @@ static const struct argp_option options[] = {
       N_("Input / output options:"),				0 },
     { "input-format",	OPT_IN_FORMAT,	N_("FORMAT"),		0,
       N_("Format of input image file.  FORMAT can be either"
-	 " \"raw\""
-#if HAVE_INTELHEX
-	 ", \"ihex\""
-#endif
-	 " or \"auto\" (default)"),				0 },
+	 " \"raw\", \"ihex\" or \"auto\" (default)"),		0 },
     { "bytes",		OPT_BYTES,	N_("MIN-LEN"),		0,
       N_("Locate strings of at least MIN-LEN bytes in input"
 	 " (argument defaults to " _STR_MACRO(FIND_STRING_DEFAULT_LENGTH)
@@ -115,9 +111,7 @@ parse_opt(
 	if (arg == NULL) return EINVAL;
 	else if (strcmp(arg, "auto") == 0) tool->format_in = formatNone;
 	else if (strcmp(arg, "raw") == 0) tool->format_in = formatRawBinary;
-#if HAVE_INTELHEX
 	else if (strcmp(arg, "ihex") == 0) tool->format_in = formatIntelHex;
-#endif
 	else argp_error(state, _("Invalid binary image format `%s' specified."), arg);
 	break;
 
@@ -1,6 +1,6 @@
 ///@file
 ///@brief	Override symbol data from key-value string specification
-///@copyright	Copyright (C) 2014, 2015, 2023  Andre Colomb
+///@copyright	Copyright (C) 2014, 2015, 2023, 2026  Andre Colomb
 ///
 /// This file is part of elf-mangle.
 ///
@@ -24,12 +24,19 @@
 #include "config.h"
 
 #include "override.h"
+#include "hex_decode.h"
 #include "symbol_list.h"
 #include "known_fields.h"
 #include "nvm_field.h"
 #include "intl.h"
 
-#undef __STRICT_ANSI__	//required on Cygwin for getsubopt()
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
@@ -41,6 +48,19 @@
 /// Compile diagnostic output messages?
 #define DEBUG 0
 
+// Flags for open() system call
+#ifndef O_BINARY
+#define O_BINARY	0
+#endif
+
+// Default to reading binary override files
+#ifndef HAVE_MMAP
+#define HAVE_MMAP 0
+#endif
+
+/// File name suffix for binary override files in a directory
+#define BINARY_SUFFIX	".bin"
+
 
 
 char*
@@ -90,156 +110,442 @@ override_append(char *overrides, const char *append_fmt, ...)
 
 
 
-///@brief Parse a string of hexadecimal byte values and write result into buffer
-///@details Each byte is specified by two hex digits with arbitrary leading white-space
-///@return Number of bytes successfully parsed or negative value on error
+/// Position of one "field=<hexbytes>" definition within an override list's text
+typedef struct override_entry {
+    /// Offset of the definition within the text buffer
+    size_t		token;
+    /// Length of the definition
+    size_t		length;
+} override_entry;
+
+/// Override definitions collected in the order given
+struct override_list {
+    /// Definitions in the order added
+    override_entry*	entries;
+    /// Number of definitions
+    int			num_entries;
+    /// Allocated size of the entries list
+    int			entries_size;
+    /// Text of all added definitions, each chunk zero-terminated
+    char*		text;
+    /// Number of bytes used in the text buffer
+    size_t		text_length;
+    /// Allocated size of the text buffer
+    size_t		text_size;
+};
+
+
+
+///@brief Split newly added text at commas into separate definitions
+///@return Zero on success or negative error code
 static int
-parse_hex_bytes(
-    const char *start,		///< [in] Zero-terminated string of byte values
-    char *output,		///< [out] Buffer to write converted data bytes
-    int max_length)		///< [in] Size of output buffer
+split_entries(
+    override_list *overrides,	///< [in,out] List to extend
+    size_t start,		///< [in] Offset of the new text
+    size_t length)		///< [in] Length of the new text
 {
-    int parsed = 0, converted;
-    unsigned char value;
-
-    if (! start || ! output) return -1;
-
-    while (*start && parsed < max_length) {
-	if (1 == sscanf(start, " %2hhx%n", &value, &converted)) {
-	    output[parsed++] = value;
-	    if (DEBUG) printf("%.*s=%02hhx,\t", converted, start, value);
-	    start += converted;
-	} else {
-	    // Skip trailing whitespace
-	    while (isspace((unsigned char) *start)) ++start;
-	    if (*start) fprintf(
-		stderr, _("Failed after parsing %d hex bytes with `%s' remaining\n"),
-		parsed, start);
-	    break;
+    override_entry *entries;
+    const char *token, *end, *limit;
+    int entries_size;
+
+    limit = overrides->text + start + length;
+    for (token = overrides->text + start; token < limit; token = end + 1) {
+	end = memchr(token, ',', limit - token);
+	if (! end) end = limit;
+	// Skip empty tokens and trailing white-space
+	if (token + strspn(token, " \t\r\n") >= end) continue;
+
+	if (overrides->num_entries >= overrides->entries_size) {
+	    entries_size = overrides->entries_size < 8 ? 16 : overrides->entries_size * 2;
+	    entries = realloc(overrides->entries, entries_size * sizeof(*entries));
+	    if (! entries) return -3;
+	    overrides->entries = entries;
+	    overrides->entries_size = entries_size;
 	}
+	overrides->entries[overrides->num_entries].token = token - overrides->text;
+	overrides->entries[overrides->num_entries].length = end - token;
+	++overrides->num_entries;
     }
-    return parsed;
+    return 0;
 }
 
 
 
-///@brief Mirror token list from known symbols for usage with getsubopt()
-///@return Negative on error, number of filled symbol strings otherwise
-static inline int
-cache_symbols_for_getsubopt(
-    const nvm_symbol *list,	///< [in] List of symbols to apply overrides
-    const int size,		///< [in] Number of symbols in the list
-    const char* symbols[])	///< [out] Cached list of symbols, MUST have (size+1) elements!
+int
+override_list_add(override_list **overrides, const char *append_fmt, ...)
 {
-    int i;
+    override_list *list;
+    va_list args;
+    size_t text_size;
+    char *text;
+    int length;
 
-    for (i = 0; i < size; ++i) {
-	if (list[i].field) symbols[i] = list[i].field->symbol;
-	else {
-	    fprintf(stderr, _("%s: Missing symbol name in list member %d\n"), __func__, i);
-	    return -2;
-	}
+    if (! overrides || ! append_fmt) return -1;
+
+    va_start(args, append_fmt);
+    length = vsnprintf(NULL, 0, append_fmt, args);
+    va_end(args);
+    if (length < 0) return -1;
+
+    if (! *overrides) *overrides = calloc(1, sizeof(**overrides));
+    list = *overrides;
+    if (! list) return -3;
+    // Grow geometrically, so adding many definitions takes linear time
+    if (list->text_length + length + 1 > list->text_size) {
+	text_size = list->text_size < 128 ? 256 : list->text_size * 2;
+	if (text_size < list->text_length + length + 1) text_size = list->text_length + length + 1;
+	text = realloc(list->text, text_size);
+	if (! text) return -3;
+	list->text = text;
+	list->text_size = text_size;
+    }
+
+    va_start(args, append_fmt);
+    vsnprintf(list->text + list->text_length, length + 1, append_fmt, args);
+    va_end(args);
+    if (DEBUG) printf("%s: %s\n", __func__, list->text + list->text_length);
+    if (split_entries(list, list->text_length, length) != 0) return -3;
+    list->text_length += length + 1;
+    return 0;
+}
+
+
+
+int
+override_list_count(const override_list *overrides)
+{
+    return overrides ? overrides->num_entries : 0;
+}
+
+
+
+char*
+override_list_join(const override_list *overrides)
+{
+    const override_entry *entry;
+    size_t length = 0;
+    char *joined, *p;
+
+    if (! overrides) return NULL;
+    for (entry = overrides->entries; entry < overrides->entries + overrides->num_entries;
+	 ++entry) {
+	length += entry->length + 1;
+    }
+    joined = p = malloc(length ? length : 1);
+    if (! joined) return NULL;
+    for (entry = overrides->entries; entry < overrides->entries + overrides->num_entries;
+	 ++entry) {
+	if (p > joined) *p++ = ',';
+	memcpy(p, overrides->text + entry->token, entry->length);
+	p += entry->length;
     }
-    symbols[i] = NULL;	//termination
+    *p = '\0';
+    return joined;
+}
+
 
-    return i;
+
+void
+override_list_free(override_list *overrides)
+{
+    if (! overrides) return;
+    free(overrides->entries);
+    free(overrides->text);
+    free(overrides);
 }
 
 
 
-/// Apply override specification string to the listed symbols' data
+/// Single edit of a compiled override program
+typedef struct override_edit {
+    /// Index of the overridden symbol within the list used for compiling
+    int			symbol;
+    /// Number of bytes to write
+    size_t		length;
+    /// Position of the bytes within the program's data buffer
+    size_t		data;
+    /// Memory mapped file contents to use instead of the data buffer, or NULL
+    const char*		mapped;
+} override_edit;
+
+/// Overrides resolved to symbols, with all values decoded
+struct override_program {
+    /// List of edits in the order to apply
+    override_edit*	edits;
+    /// Number of edits
+    int			num_edits;
+    /// Allocated size of the edits list
+    int			edits_size;
+    /// Decoded bytes of all edits
+    char*		data;
+    /// Number of bytes used in the data buffer
+    size_t		data_length;
+    /// Allocated size of the data buffer
+    size_t		data_size;
+    /// Function to prepare symbols before looking up their names, may be NULL
+    override_resolve_f	resolve;
+    /// Argument passed to the resolve function
+    void*		resolve_arg;
+};
+
+
+
+///@brief Decode a range of hexadecimal byte values and write result into buffer
+///@details Each byte is specified by two hex digits, optionally separated by white-space.
+///         Data exceeding the buffer is ignored, its start is returned in errpos.
+///@return Number of bytes decoded or negative value on error
 static int
-parse_overrides_cached(
-    char* restrict overrides,	///< [in] @sa parse_overrides()
-    const nvm_symbol* restrict list,	///< [in] @sa parse_overrides()
-    const int size,		///< [in] @sa parse_overrides()
-    const char* symbols[])	///< [in] Cached list of symbols, NULL-terminated
+parse_hex_bytes(
+    const char *start,		///< [in] Start of byte values
+    const char *end,		///< [in] End of byte values
+    char *output,		///< [out] Buffer to write converted data bytes
+    size_t max_length,		///< [in] Size of output buffer
+    const char **errmsg,	///< [out] Reason why decoding failed
+    const char **errpos)	///< [out] Offending character or start of ignored data
 {
-    char *substart, *subopt, *value;
-    const char *errmsg = NULL;
-    int i, parsed = 0, length;
-
-    subopt = overrides;
-    while (*subopt != '\0') {
-	substart = subopt;
-	i = getsubopt(&subopt, (char**) symbols, &value);
-	if (i >= 0 && i < size) {
-	    length = parse_hex_bytes(value, list[i].blob_address, list[i].size);
-	    if (DEBUG) printf("parsed %d bytes for field %s\n", length, symbols[i]);
-	    // Skip trailing whitespace
-	    while (isspace((unsigned char) *subopt)) ++subopt;
-	    if (length > 0) {
-		++parsed;
-		continue;
-	    } else errmsg = _("Could not parse byte data");
-	} else errmsg = _("Field not found");
-	fprintf(stderr, _("Unable to parse override `%.*s' (%s)\n"),
-		(int) (subopt - substart), substart , errmsg);
+    size_t error_pos;
+    ssize_t parsed;
+
+    parsed = hex_decode(start, end - start, output, max_length, &error_pos);
+    if (DEBUG) printf("%s: parsed %zd bytes\n", __func__, parsed);
+    if (parsed == HEX_DECODE_TOO_LONG) {
+	// The buffer was filled completely before the extra data
+	*errpos = start + error_pos;
+	return max_length;
+    } else if (parsed < 0) {
+	*errmsg = _("Could not parse byte data");
+	*errpos = start + error_pos;
+	return -1;
+    } else if (! parsed) {
+	*errmsg = _("Could not parse byte data");
+	return -1;
     }
+    return parsed;
+}
+
 
-    if (DEBUG && parsed) printf("%s: parsed %d overrides\n", __func__, parsed);
 
-    return errmsg ? -1 : parsed;
+override_program*
+override_program_new(void)
+{
+    return calloc(1, sizeof(override_program));
 }
 
 
 
-int
-parse_overrides(char* restrict overrides, const nvm_symbol* restrict list, const int size)
+void
+override_program_resolver(override_program *program, override_resolve_f resolve, void *arg)
 {
-    if (! overrides || ! list || size <= 0) return -1;
+    if (! program) return;
+    program->resolve = resolve;
+    program->resolve_arg = arg;
+}
 
-    const char* symbols[size + 1];
 
-    if (DEBUG) printf("%s: \"%s\"\n", __func__, overrides);
 
-    if (cache_symbols_for_getsubopt(list, size, symbols) < 0) return -2;
+///@brief Look up a field name after letting the caller prepare matching symbols
+///@return Address of the first matching symbol or NULL if not found
+static const nvm_symbol*
+find_symbol(
+    const override_program *program,	///< [in] Program with optional resolve function
+    const nvm_symbol *list,		///< [in] List of symbols to search
+    int size,				///< [in] Number of symbols in the list
+    const symbol_index *index,		///< [in] Index of the list or NULL
+    const char *name)			///< [in] Field symbol name to look for
+{
+    if (program->resolve) program->resolve(name, program->resolve_arg);
+    return symbol_list_find_symbol(index, list, size, name);
+}
+
 
-    return parse_overrides_cached(overrides, list, size, symbols);
+
+///@brief Reserve room for a new edit and its data at the end of the program
+///@return Address of the new edit or NULL on error
+static override_edit*
+append_edit(
+    override_program *program,	///< [in,out] Program to extend
+    size_t max_length)		///< [in] Maximum number of data bytes
+{
+    override_edit *edits;
+    char *data;
+    size_t data_size;
+    int edits_size;
+
+    if (program->num_edits >= program->edits_size) {
+	edits_size = program->edits_size < 8 ? 16 : program->edits_size * 2;
+	edits = realloc(program->edits, edits_size * sizeof(*edits));
+	if (! edits) return NULL;
+	program->edits = edits;
+	program->edits_size = edits_size;
+    }
+    if (program->data_length + max_length > program->data_size) {
+	data_size = program->data_size < 256 ? 512 : program->data_size * 2;
+	if (data_size < program->data_length + max_length) {
+	    data_size = program->data_length + max_length;
+	}
+	data = realloc(program->data, data_size);
+	if (! data) return NULL;
+	program->data = data;
+	program->data_size = data_size;
+    }
+    return &program->edits[program->num_edits];
 }
 
 
 
-///@brief Apply override specifications from file to the listed symbols' data
-///@return Number of overrides successfully parsed or negative number for parameter error
+///@brief Compile one override specification token
+///@return Zero on success, negative on error
 static int
-parse_file(
-    FILE* restrict in,		///< [in] Stream opened for reading
-    const nvm_symbol* restrict list,	///< [in] @sa parse_overrides()
-    const int size)		///< [in] @sa parse_overrides()
+compile_token(
+    override_program *program,	///< [in,out] Program to extend
+    const char *start,		///< [in] Start of "field=<hexbytes>" token
+    const char *end,		///< [in] End of token
+    const nvm_symbol *list,	///< [in] List of symbols to resolve field names
+    int size,			///< [in] Number of symbols in the list
+    const symbol_index *index,	///< [in] Index of the list or NULL
+    const char **errmsg,	///< [out] Reason why compiling failed
+    const char **errpos)	///< [out] Offending character for invalid data, if known
 {
-    if (! in || ! list || size <= 0) return -1;
+    const nvm_symbol *symbol;
+    const char *assign, *name_end;
+    override_edit *edit;
+    int length;
+
+    assign = memchr(start, '=', end - start);
+    if (! assign) {
+	*errmsg = _("Missing field value");
+	return -1;
+    }
+    while (start < assign && isspace((unsigned char) *start)) ++start;
+    for (name_end = assign; name_end > start && isspace((unsigned char) name_end[-1]);
+	 --name_end);
+
+    char name[name_end - start + 1];
+    memcpy(name, start, name_end - start);
+    name[name_end - start] = '\0';
+
+    symbol = find_symbol(program, list, size, index, name);
+    if (! symbol) {
+	*errmsg = _("Field not found");
+	return -1;
+    }
 
-    char *line = NULL;
-    const char* symbols[size + 1];
-    int ret = 0, parsed = 0;
-    size_t length = 0;
-    ssize_t consumed;
+    edit = append_edit(program, symbol->size);
+    if (! edit) {
+	*errmsg = strerror(ENOMEM);
+	return -3;
+    }
+    length = parse_hex_bytes(assign + 1, end, program->data + program->data_length,
+			     symbol->size, errmsg, errpos);
+    if (length < 0) return -1;
+    if (*errpos) {
+	// Values written for a larger field are still usable
+	fprintf(stderr, _("Ignoring extra data `%.*s' for field %s (%zu bytes)\n"),
+		(int) (end - *errpos), *errpos, name, symbol->size);
+	*errpos = NULL;
+    }
 
-    if (cache_symbols_for_getsubopt(list, size, symbols) < 0) return -2;
+    edit->symbol = symbol - list;
+    edit->length = length;
+    edit->data = program->data_length;
+    edit->mapped = NULL;
+    program->data_length += length;
+    ++program->num_edits;
+    if (DEBUG) printf("%s: %d bytes for field %s\n", __func__, length, name);
+    return 0;
+}
 
-    while ((consumed = getline(&line, &length, in)) != -1) {
-	if (DEBUG) printf("processing line of %zu characters\n", consumed);
-	ret = parse_overrides_cached(line, list, size, symbols);
-	if (ret < 0) break;
-	parsed += ret;
+
+
+///@brief Compile one override definition and report any error
+///@return Zero on success, negative on error
+static int
+compile_definition(
+    override_program *program,	///< [in,out] Program to extend
+    const char *start,		///< [in] Start of "field=<hexbytes>" token
+    const char *end,		///< [in] End of token
+    const nvm_symbol *list,	///< [in] List of symbols to resolve field names
+    int size,			///< [in] Number of symbols in the list
+    const symbol_index *index)	///< [in] Index of the list or NULL
+{
+    const char *errmsg = NULL, *errpos = NULL;
+    int ret;
+
+    ret = compile_token(program, start, end, list, size, index, &errmsg, &errpos);
+    if (ret == 0) return 0;
+    if (errpos) {
+	fprintf(stderr, _("Unable to parse override `%.*s' (%s at column %d)\n"),
+		(int) (end - start), start, errmsg, (int) (errpos - start) + 1);
+    } else {
+	fprintf(stderr, _("Unable to parse override `%.*s' (%s)\n"),
+		(int) (end - start), start, errmsg);
     }
-    free(line);
+    return ret;
+}
 
-    if (ret < 0) return ret;
 
-    return parsed;
+
+int
+override_program_add(override_program *program, const char *overrides,
+		     const nvm_symbol *list, int size, const symbol_index *index)
+{
+    const char *start, *end;
+    int compiled = 0, failed = 0;
+
+    if (! program || ! overrides || ! list || size <= 0) return -1;
+    if (DEBUG) printf("%s: \"%s\"\n", __func__, overrides);
+
+    for (start = overrides; *start; start = *end ? end + 1 : end) {
+	end = strchr(start, ',');
+	if (! end) end = start + strlen(start);
+	// Skip empty tokens and trailing white-space
+	if (start + strspn(start, " \t\r\n") >= end) continue;
+
+	if (compile_definition(program, start, end, list, size, index) == 0) ++compiled;
+	else ++failed;
+    }
+
+    if (DEBUG && compiled) printf("%s: compiled %d overrides\n", __func__, compiled);
+    return failed ? -1 : compiled;
 }
 
 
 
 int
-parse_override_file(const char *filename, const nvm_symbol *list, const int size)
+override_program_add_list(override_program *program, const override_list *overrides,
+			  const nvm_symbol *list, int size, const symbol_index *index)
 {
-    FILE* restrict in;
-    int parsed = 0;
+    const override_entry *entry;
+    const char *start;
+    int compiled = 0, failed = 0;
+
+    if (! program || ! overrides || ! list || size <= 0) return -1;
+
+    // Definitions were already split when collected
+    for (entry = overrides->entries; entry < overrides->entries + overrides->num_entries;
+	 ++entry) {
+	start = overrides->text + entry->token;
+	if (compile_definition(program, start, start + entry->length, list, size, index) == 0) {
+	    ++compiled;
+	} else ++failed;
+    }
+
+    if (DEBUG && compiled) printf("%s: compiled %d overrides\n", __func__, compiled);
+    return failed ? -1 : compiled;
+}
 
-    if (! filename || ! list || size <= 0) return -1;
+
+
+int
+override_program_add_file(override_program *program, const char *filename,
+			  const nvm_symbol *list, int size, const symbol_index *index)
+{
+    char *line = NULL;
+    size_t length = 0;
+    int ret = 0, compiled = 0;
+    FILE *in;
+
+    if (! program || ! filename || ! list || size <= 0) return -1;
     if (DEBUG) printf("%s: \"%s\"\n", __func__, filename);
 
     if (strcmp(filename, "-") == 0) in = stdin;
@@ -249,23 +555,368 @@ parse_override_file(const char *filename, const nvm_symbol *list, const int size
 	return -3;
     }
 
-    parsed = parse_file(in, list, size);
-
+    while (getline(&line, &length, in) != -1) {
+	ret = override_program_add(program, line, list, size, index);
+	if (ret < 0) break;
+	compiled += ret;
+    }
+    free(line);
     if (in != stdin) fclose(in);
 
-    if (DEBUG) printf("%s: returns %d\n", __func__, parsed);
-    return parsed;
+    if (DEBUG) printf("%s: returns %d\n", __func__, ret < 0 ? ret : compiled);
+    return ret < 0 ? ret : compiled;
+}
+
+
+
+///@brief Read all remaining bytes from a file descriptor
+///@return Zero on success or negative error code
+static int
+read_all(
+    int fd,			///< [in] Open file descriptor
+    char *buffer,		///< [out] Buffer to fill
+    size_t length)		///< [in] Number of bytes to read
+{
+    ssize_t bytes_read;
+
+    while (length > 0) {
+	bytes_read = read(fd, buffer, length);
+	if (bytes_read < 0 && errno == EINTR) continue;
+	if (bytes_read <= 0) return -2;
+	buffer += bytes_read;
+	length -= bytes_read;
+    }
+    return 0;
+}
+
+
+
+///@brief Compile the contents of a binary file as override for one symbol
+///@details The file is memory mapped if possible, so its contents are only
+///         copied into the symbol's data when applying the program.
+///@return Zero on success or negative error code
+static int
+add_binary_file(
+    override_program *program,	///< [in,out] Program to extend
+    const char *filename,	///< [in] Binary file name
+    const nvm_symbol *list,	///< [in] List of symbols used for compiling
+    const nvm_symbol *symbol)	///< [in] Overridden symbol within the list
+{
+    override_edit *edit;
+    struct stat st;
+    char *mapped = NULL;
+    size_t length;
+    int fd, ret = 0;
+
+    fd = open(filename, O_RDONLY | O_BINARY);
+    if (fd == -1 || fstat(fd, &st) != 0) {
+	fprintf(stderr, _("Cannot open binary override file \"%s\" (%s)\n"),
+		filename, strerror(errno));
+	if (fd != -1) close(fd);
+	return -2;
+    }
+    length = st.st_size;
+    if (st.st_size < 0 || (uintmax_t) st.st_size > symbol->size) {
+	fprintf(stderr, _("Binary override file \"%s\" exceeds field %s,"
+			  " %jd of %zu bytes\n"),
+		filename, symbol->field->symbol, (intmax_t) st.st_size, symbol->size);
+	close(fd);
+	return -2;
+    } else if (length < symbol->size) {
+	fprintf(stderr, _("Binary override file \"%s\" is too small for field %s,"
+			  " %zu of %zu bytes missing\n"),
+		filename, symbol->field->symbol, symbol->size - length, symbol->size);
+    }
+
+#if HAVE_MMAP
+    if (length > 0) {
+	mapped = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (mapped == MAP_FAILED) {
+	    mapped = NULL;
+	    if (DEBUG) printf("%s: mmap() failed (%s)\n", __func__, strerror(errno));
+	}
+    }
+#endif
+    edit = append_edit(program, mapped ? 0 : length);
+    errno = 0;
+    if (! edit) ret = -3;
+    else if (! mapped && read_all(fd, program->data + program->data_length, length) != 0) {
+	fprintf(stderr, _("Cannot read binary override file \"%s\" (%s)\n"),
+		filename, errno ? strerror(errno) : _("File truncated"));
+	ret = -2;
+    }
+    close(fd);
+
+    if (ret < 0) {
+#if HAVE_MMAP
+	if (mapped) munmap(mapped, length);
+#endif
+	return ret;
+    }
+    edit->symbol = symbol - list;
+    edit->length = length;
+    edit->data = program->data_length;
+    edit->mapped = mapped;
+    if (! mapped) program->data_length += length;
+    ++program->num_edits;
+    if (DEBUG) printf("%s: %zu bytes for field %s from %s (%s)\n", __func__, length,
+		      symbol->field->symbol, filename, mapped ? "mapped" : "read");
+    return 0;
+}
+
+
+
+///@brief Compile all binary override files from a directory
+///@return Number of overrides compiled or negative number on error
+static int
+add_binary_directory(
+    override_program *program,	///< [in,out] Program to extend
+    const char *dirname,	///< [in] Directory containing FIELD.bin files
+    const nvm_symbol *list,	///< [in] List of symbols to resolve field names
+    int size,			///< [in] Number of symbols in the list
+    const symbol_index *index)	///< [in] Index of the list or NULL
+{
+    const nvm_symbol *symbol;
+    const struct dirent *entry;
+    size_t name_length;
+    DIR *dir;
+    int ret, compiled = 0, failed = 0;
+
+    dir = opendir(dirname);
+    if (! dir) {
+	fprintf(stderr, _("Cannot open binary override directory \"%s\" (%s)\n"),
+		dirname, strerror(errno));
+	return -2;
+    }
+
+    while ((entry = readdir(dir))) {
+	name_length = strlen(entry->d_name);
+	if (name_length <= strlen(BINARY_SUFFIX)
+	    || strcmp(entry->d_name + name_length - strlen(BINARY_SUFFIX), BINARY_SUFFIX) != 0) {
+	    continue;
+	}
+
+	char field[name_length - strlen(BINARY_SUFFIX) + 1];
+	char path[strlen(dirname) + 1 + name_length + 1];
+	memcpy(field, entry->d_name, sizeof(field) - 1);
+	field[sizeof(field) - 1] = '\0';
+	snprintf(path, sizeof(path), "%s/%s", dirname, entry->d_name);
+
+	symbol = find_symbol(program, list, size, index, field);
+	if (! symbol) {
+	    fprintf(stderr, _("Binary override file \"%s\" names unknown field `%s'\n"),
+		    path, field);
+	    ret = -2;
+	} else ret = add_binary_file(program, path, list, symbol);
+	if (ret == -3) {
+	    failed = ret;
+	    break;
+	} else if (ret < 0) failed = -1;
+	else ++compiled;
+    }
+    closedir(dir);
+
+    if (DEBUG) printf("%s: %d files from %s\n", __func__, compiled, dirname);
+    return failed ? failed : compiled;
+}
+
+
+
+int
+override_program_add_binary(override_program *program, const char *definition,
+			    const nvm_symbol *list, int size, const symbol_index *index)
+{
+    const nvm_symbol *symbol;
+    const char *assign;
+    struct stat st;
+
+    if (! program || ! definition || ! list || size <= 0) return -1;
+
+    if (stat(definition, &st) == 0 && S_ISDIR(st.st_mode)) {
+	return add_binary_directory(program, definition, list, size, index);
+    }
+
+    assign = strchr(definition, '=');
+    if (! assign) {
+	fprintf(stderr, _("Unable to parse binary override `%s' (%s)\n"),
+		definition, _("Missing file name"));
+	return -1;
+    }
+    char name[assign - definition + 1];
+    memcpy(name, definition, assign - definition);
+    name[assign - definition] = '\0';
+
+    symbol = find_symbol(program, list, size, index, name);
+    if (! symbol) {
+	fprintf(stderr, _("Unable to parse binary override `%s' (%s)\n"),
+		definition, _("Field not found"));
+	return -1;
+    }
+    return add_binary_file(program, assign + 1, list, symbol) < 0 ? -1 : 1;
+}
+
+
+
+int
+override_program_apply(const override_program *program, const nvm_symbol *list)
+{
+    const override_edit *edit;
+
+    if (! program || ! list) return -1;
+
+    for (edit = program->edits; edit < program->edits + program->num_edits; ++edit) {
+	memcpy(list[edit->symbol].blob_address,
+	       edit->mapped ? edit->mapped : program->data + edit->data, edit->length);
+    }
+    return program->num_edits;
+}
+
+
+
+void
+override_program_free(override_program *program)
+{
+#if HAVE_MMAP
+    const override_edit *edit;
+#endif
+
+    if (! program) return;
+#if HAVE_MMAP
+    for (edit = program->edits; edit < program->edits + program->num_edits; ++edit) {
+	if (edit->mapped) munmap((void*) edit->mapped, edit->length);
+    }
+#endif
+    free(program->edits);
+    free(program->data);
+    free(program);
+}
+
+
+
+///@brief Compile overrides, apply them to the listed symbols' data and discard them
+///@return Number of overrides applied or negative number for parameter error
+static int
+apply_once(
+    const override_list *overrides,	///< [in] Override definitions or NULL
+    const char *filename,	///< [in] Override specification file name or NULL
+    const nvm_symbol *list,	///< [in] List of symbols to apply overrides
+    int size,			///< [in] Number of symbols in the list
+    const symbol_index *index)	///< [in] Index of the list or NULL
+{
+    override_program *program;
+    int ret;
+
+    program = override_program_new();
+    if (! program) return -3;
+    ret = overrides ? override_program_add_list(program, overrides, list, size, index)
+	: override_program_add_file(program, filename, list, size, index);
+    if (ret >= 0) override_program_apply(program, list);
+    override_program_free(program);
+    return ret;
+}
+
+
+
+int
+parse_overrides(const override_list* restrict overrides, const nvm_symbol* restrict list,
+		const int size, const symbol_index* restrict index)
+{
+    if (! overrides) return -1;
+    return apply_once(overrides, NULL, list, size, index);
+}
+
+
+
+int
+parse_override_file(const char *filename, const nvm_symbol *list, const int size,
+		    const symbol_index *index)
+{
+    if (! filename) return -1;
+    return apply_once(NULL, filename, list, size, index);
 }
 
 
 
 #ifdef TEST_OVERRIDES
+#include <time.h>
+
+/// Measure compiling and applying many overrides for a large symbol list
+static void
+benchmark_overrides(int num_symbols, int num_overrides)
+{
+    nvm_field *fields = calloc(num_symbols, sizeof(*fields));
+    nvm_symbol *symbols = calloc(num_symbols, sizeof(*symbols));
+    char *names = malloc(num_symbols * 16), *blob = calloc(num_symbols, 4);
+    char *joined = NULL;
+    override_list *overrides = NULL;
+    override_program *program;
+    symbol_index *index;
+    struct timespec start, end;
+    int i, parsed;
+
+    if (! fields || ! symbols || ! names || ! blob) return;
+    for (i = 0; i < num_symbols; ++i) {
+	snprintf(names + i * 16, 16, "sym%d", i);
+	fields[i].symbol = names + i * 16;
+	symbols[i].offset = i * 4;
+	symbols[i].size = 4;
+	symbols[i].blob_address = blob + i * 4;
+	symbols[i].field = &fields[i];
+    }
+    index = symbol_list_index(symbols, num_symbols);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < num_overrides; ++i) {
+	joined = override_append(joined, "sym%d=%08x", (i * 7919) % num_symbols, i);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("%d overrides appended to string in %.3f ms\n", num_overrides,
+	   (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < num_overrides; ++i) {
+	override_list_add(&overrides, "sym%d=%08x", (i * 7919) % num_symbols, i);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("%d overrides added to list in %.3f ms\n", override_list_count(overrides),
+	   (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    program = override_program_new();
+    parsed = override_program_add_list(program, overrides, symbols, num_symbols, index);
+    override_program_apply(program, symbols);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("%d overrides on %d symbols: %d compiled in %.3f ms\n",
+	   num_overrides, num_symbols, parsed,
+	   (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < 1000; ++i) override_program_apply(program, symbols);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("\tapplied again in %.3f us\n",
+	   ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / 1e3 / 1000);
+
+    override_program_free(program);
+    symbol_list_free_index(index);
+    symbol_list_free(symbols, num_symbols);
+    override_list_free(overrides);
+    free(joined);
+    free(blob);
+    free(names);
+    free(symbols);
+    free(fields);
+}
+
+
+
 int
 main(int argc, char **argv)
 {
 #define CONVERT	"BeeF"
     const char hexbytes[] = "4265 65  464F"; //BeeFO
     char *overrides = NULL, content[sizeof(CONVERT)] = { 0 }, buf[sizeof(CONVERT)] = { 0 };
+    override_list *list = NULL;
+    const char *errmsg = NULL, *errpos = NULL;
     int parsed;
     nvm_field fields[] = {
 	{ .symbol = "a" },
@@ -292,21 +943,32 @@ main(int argc, char **argv)
     overrides = override_append(overrides, "c=%d", 3);
     if (overrides) puts(overrides);
 
-    parsed = parse_hex_bytes(hexbytes, content, strlen(CONVERT));
+    parsed = parse_hex_bytes(hexbytes, hexbytes + strlen(hexbytes),
+			     content, strlen(CONVERT), &errmsg, &errpos);
     printf("[%s] \"%s\" (%d bytes) %s\n", hexbytes, content, parsed,
 	   strcmp(content, CONVERT) ? "FAIL" : "match");
 
     overrides = override_append(overrides, "d=%d,e=%s", parsed, content);
     if (overrides) puts(overrides);
 
-    parsed = parse_overrides(overrides, symbols, sizeof(symbols) / sizeof(*symbols));
+    override_list_add(&list, "%s", overrides);
+    override_list_add(&list, ",, f=01,");
+    free(overrides);
+    overrides = override_list_join(list);
+    printf("%d in list: %s\n", override_list_count(list), overrides);
+
+    parsed = parse_overrides(list, symbols, sizeof(symbols) / sizeof(*symbols), NULL);
     printf("Parsed %d overrides.\n", parsed);
 
+    override_list_free(list);
     free(overrides);
 
+    benchmark_overrides(1000, 1000);
+    benchmark_overrides(100000, 10000);
+
     if (argc < 2) return 0;
 
-    parsed = parse_override_file(argv[1], symbols, sizeof(symbols) / sizeof(*symbols));
+    parsed = parse_override_file(argv[1], symbols, sizeof(symbols) / sizeof(*symbols), NULL);
     printf("Parsed %d overrides from file.\n", parsed);
 
     return 0;
@@ -1,6 +1,6 @@
 ///@file
 ///@brief	Override symbol data from key-value string specification
-///@copyright	Copyright (C) 2014, 2023  Andre Colomb
+///@copyright	Copyright (C) 2014, 2023, 2026  Andre Colomb
 ///
 /// This file is part of elf-mangle.
 ///
@@ -27,21 +27,64 @@
 
 // Forward declarations
 typedef struct nvm_symbol nvm_symbol;
+typedef struct symbol_index symbol_index;
+
+/// Opaque type holding overrides resolved to symbols, with decoded values
+typedef struct override_program override_program;
+
+/// Opaque type collecting override definitions in the order given
+typedef struct override_list override_list;
+
+///@brief Function to prepare the symbols with a given name before looking them up
+typedef void (*override_resolve_f)(
+    const char *name,		///< [in] Symbol name about to be looked up
+    void *arg			///< [in] Argument passed to override_program_resolver()
+);
 
 ///@brief Append to the override specification with delimiter if necessary
 ///@note The string must be stored on the heap and may be reallocated to a new address
+///@deprecated Repeated appending takes quadratic time, use override_list_add() instead
 ///@return New location of the override specification string
 char* override_append(
     char *overrides,		///< [in] The currently allocated override string
     const char *append_fmt,	///< [in] Format string for printf() with additional parameters
     ...) __attribute__((format (printf, 2, 3)));
 
-///@brief Apply override specification string to the listed symbols' data
+///@brief Add formatted override definitions to a list
+///@details The formatted text may hold several comma-separated "field=<hexbytes>"
+///         definitions, which are split up once while adding.  Buffers grow
+///         geometrically, so the time spent is linear in the added length.
+///@return Zero on success or negative error code
+int override_list_add(
+    override_list **overrides,	///< [in,out] List to extend, created if pointing to NULL
+    const char *append_fmt,	///< [in] Format string for printf() with additional parameters
+    ...) __attribute__((format (printf, 2, 3)));
+
+///@brief Count the definitions in an override list
+///@return Number of definitions, zero for a NULL list
+int override_list_count(
+    const override_list *overrides	///< [in] Override definitions
+);
+
+///@brief Join all definitions into one comma-separated specification string
+///@return Newly allocated string or NULL on error
+char* override_list_join(
+    const override_list *overrides	///< [in] Override definitions
+);
+
+///@brief Release an override list
+void override_list_free(
+    override_list *overrides		///< [in] List to release, may be NULL
+);
+
+///@brief Apply listed override definitions to the listed symbols' data
+///@details Shorthand to compile, apply and release an override program.
 ///@return Number of overrides successfully parsed or negative number for parameter error
 int parse_overrides(
-    char *overrides,		///< [in] Override specification string
+    const override_list *overrides,	///< [in] Override definitions
     const nvm_symbol *list,	///< [in] List of symbols to apply overrides
-    int size			///< [in] Number of symbols in the list
+    int size,			///< [in] Number of symbols in the list
+    const symbol_index *index	///< [in] Index of the list for fast lookups or NULL
 );
 
 ///@brief Apply override specifications from file to the listed symbols' data
@@ -51,7 +94,87 @@ int parse_overrides(
 int parse_override_file(
     const char *filename,	///< [in] Override specification file name
     const nvm_symbol *list,	///< [in] List of symbols to apply overrides
-    int size			///< [in] Number of symbols in the list
+    int size,			///< [in] Number of symbols in the list
+    const symbol_index *index	///< [in] Index of the list for fast lookups or NULL
+);
+
+///@brief Create an empty override program
+///@return Address of the new program or NULL on error
+override_program* override_program_new(void);
+
+///@brief Call a function for each field name before looking it up while compiling
+///@details Lets the caller resolve lazily parsed symbols on demand, as values
+///         are decoded according to the field size.
+void override_program_resolver(
+    override_program *program,	///< [in,out] Program to configure
+    override_resolve_f resolve,	///< [in] Function to call, NULL for none
+    void *arg			///< [in] Argument passed to the function
+);
+
+///@brief Compile an override specification string into a program
+///@details Field names are looked up once using the list's index and all byte
+///         values decoded, so errors are reported before any data is changed.
+///         The string is not modified.
+///@return Number of overrides compiled or negative number on error
+int override_program_add(
+    override_program *program,	///< [in,out] Program to extend
+    const char *overrides,	///< [in] Comma-separated "field=<hexbytes>" pairs
+    const nvm_symbol *list,	///< [in] List of symbols to resolve field names
+    int size,			///< [in] Number of symbols in the list
+    const symbol_index *index	///< [in] Index of the list for fast lookups or NULL
+);
+
+///@brief Compile listed override definitions into a program
+///@details Like override_program_add(), but using the definitions as split up
+///         while collecting them.
+///@return Number of overrides compiled or negative number on error
+int override_program_add_list(
+    override_program *program,	///< [in,out] Program to extend
+    const override_list *overrides,	///< [in] Override definitions
+    const nvm_symbol *list,	///< [in] List of symbols to resolve field names
+    int size,			///< [in] Number of symbols in the list
+    const symbol_index *index	///< [in] Index of the list for fast lookups or NULL
+);
+
+///@brief Compile override specifications from file into a program
+///@return Number of overrides compiled or negative number on error
+int override_program_add_file(
+    override_program *program,	///< [in,out] Program to extend
+    const char *filename,	///< [in] Override specification file name, - for standard input
+    const nvm_symbol *list,	///< [in] List of symbols to resolve field names
+    int size,			///< [in] Number of symbols in the list
+    const symbol_index *index	///< [in] Index of the list for fast lookups or NULL
+);
+
+///@brief Compile binary file contents as overrides into a program
+///@details The definition either names a field and a file, separated by an
+///         equal sign, or a directory.  Each file named FIELD.bin within the
+///         directory then overrides the respective field.  Files must not
+///         be larger than the field, smaller ones only override its start.
+///         Where possible, the files are memory mapped and only copied when
+///         applying the program.
+///@return Number of overrides compiled or negative number on error
+int override_program_add_binary(
+    override_program *program,	///< [in,out] Program to extend
+    const char *definition,	///< [in] "field=<file>" pair or directory name
+    const nvm_symbol *list,	///< [in] List of symbols to resolve field names
+    int size,			///< [in] Number of symbols in the list
+    const symbol_index *index	///< [in] Index of the list for fast lookups or NULL
+);
+
+///@brief Copy all compiled override values into the listed symbols' data
+///@details The list must be in the same order as when compiling, but may refer
+///         to different copies of the binary data.  Later overrides of the same
+///         field take precedence.
+///@return Number of overrides applied or negative on error
+int override_program_apply(
+    const override_program *program,	///< [in] Compiled overrides
+    const nvm_symbol *list		///< [in] List of symbols to write to
+);
+
+///@brief Release an override program
+void override_program_free(
+    override_program *program		///< [in] Program to release, may be NULL
 );
 
 #endif //OVERRIDE_H_
@@ -42,7 +42,7 @@ get_custom_post_processors(void);
 
 int
 post_process_image(const char* blob, const size_t blob_size,
-		   const nvm_symbol *list, const int size)
+		   const nvm_symbol *list, const int size, const symbol_index *index)
 {
     const post_process_f *entry;
     int r, modified = 0;
@@ -54,7 +54,7 @@ post_process_image(const char* blob, const size_t blob_size,
     for (; *entry; ++entry) {
 	const post_process_f f = *entry;
 	// Call post-processor and accumulate return value
-	r = f(blob, blob_size, list, size);
+	r = f(blob, blob_size, list, size, index);
 	if (r > 0) modified += r;
     }
 
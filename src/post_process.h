@@ -29,6 +29,7 @@
 
 // Forward declarations
 typedef struct nvm_symbol nvm_symbol;
+typedef struct symbol_index symbol_index;
 
 
 ///@brief Function pointer to apply image post-processing
@@ -37,7 +38,8 @@ typedef int (*post_process_f)(
     const char* blob,			///< [in] Binary data to process
     size_t blob_size,			///< [in] Size of binary data
     const nvm_symbol *list,		///< [in] List of symbols to apply modifications
-    int size				///< [in] Number of symbols in the list
+    int size,				///< [in] Number of symbols in the list
+    const symbol_index *index		///< [in] Index of the list for fast lookups or NULL
 );
 
 ///@brief Apply all available post-processor functions
@@ -46,7 +48,8 @@ int post_process_image(
     const char* blob,			///< [in] Binary data to process
     size_t blob_size,			///< [in] Size of binary data
     const nvm_symbol *list,		///< [in] List of symbols to apply overrides
-    int size				///< [in] Number of symbols in the list
+    int size,				///< [in] Number of symbols in the list
+    const symbol_index *index		///< [in] Index of the list for fast lookups or NULL
 );
 
 #endif //POST_PROCESS_H_
@@ -0,0 +1,364 @@
+///@file
+///@brief	Per-device field values read from CSV or TSV tables
+///@copyright	Copyright (C) 2026  Andre Colomb
+///
+/// This file is part of elf-mangle.
+///
+/// This file is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU Lesser General Public License as
+/// published by the Free Software Foundation, either version 3 of the
+/// License, or (at your option) any later version.
+///
+/// elf-mangle is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+/// Lesser General Public License for more details.
+///
+/// You should have received a copy of the GNU Lesser General Public
+/// License along with this program.  If not, see
+/// <http://www.gnu.org/licenses/>.
+///
+///@author	Andre Colomb <src@andre.colomb.de>
+
+
+#include "config.h"
+
+#include "provision.h"
+#include "hex_decode.h"
+#include "symbol_list.h"
+#include "nvm_field.h"
+#include "intl.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <errno.h>
+
+/// Compile diagnostic output messages?
+#define DEBUG 0
+
+
+
+/// Decoded field values for all devices, one fixed-size record per row
+struct provision_table {
+    /// Number of field value columns, not counting the image file name
+    int			num_columns;
+    /// Index of each column's symbol within the list used for reading
+    int*		symbols;
+    /// Position of each column's data within a row record
+    size_t*		offsets;
+    /// Size of one row record, the sum of all columns' symbol sizes
+    size_t		row_size;
+    /// Number of device rows
+    int			num_rows;
+    /// Number of rows allocated
+    int			rows_size;
+    /// Output image file name for each row
+    char**		images;
+    /// Number of decoded bytes for each row and column
+    size_t*		lengths;
+    /// Row records of decoded bytes
+    char*		data;
+};
+
+
+
+///@brief Split a line of text into cells at the delimiter, in place
+///@details Surrounding white-space and double quotes are removed from each cell.
+///@return Number of cells found, may exceed the number stored
+static int
+split_cells(
+    char *line,			///< [in,out] Line of text, modified for terminating cells
+    char delimiter,		///< [in] Character separating cells
+    char *cells[],		///< [out] Start of each cell
+    int max_cells)		///< [in] Maximum number of cells to store
+{
+    char *end, *next;
+    int count = 0;
+
+    for (; line; line = next) {
+	next = strchr(line, delimiter);
+	if (next) *next++ = '\0';
+	end = line + strlen(line);
+	while (isspace((unsigned char) *line)) ++line;
+	while (end > line && isspace((unsigned char) end[-1])) --end;
+	if (end - line >= 2 && *line == '"' && end[-1] == '"') {
+	    ++line;
+	    --end;
+	}
+	*end = '\0';
+	if (count < max_cells) cells[count] = line;
+	++count;
+    }
+    return count;
+}
+
+
+
+///@brief Resolve the header's field names to symbols and lay out row records
+///@return Zero on success or negative error code
+static int
+parse_header(
+    provision_table *table,	///< [in,out] Table to set up
+    char *cells[],		///< [in] Header cells, first one naming the image column
+    int num_cells,		///< [in] Number of header cells
+    const nvm_symbol *list,	///< [in] List of symbols to resolve field names
+    int size,			///< [in] Number of symbols in the list
+    const symbol_index *index)	///< [in] Index of the symbol list or NULL
+{
+    const nvm_symbol *symbol;
+    int column;
+
+    table->num_columns = num_cells - 1;
+    table->symbols = calloc(table->num_columns, sizeof(*table->symbols));
+    table->offsets = calloc(table->num_columns, sizeof(*table->offsets));
+    if (! table->symbols || ! table->offsets) return -3;
+
+    for (column = 0; column < table->num_columns; ++column) {
+	symbol = symbol_list_find_symbol(index, list, size, cells[column + 1]);
+	if (! symbol) {
+	    fprintf(stderr, _("Field `%s' not found in map.\n"), cells[column + 1]);
+	    return -2;
+	}
+	table->symbols[column] = symbol - list;
+	table->offsets[column] = table->row_size;
+	table->row_size += symbol->size;
+    }
+    return 0;
+}
+
+
+
+///@brief Decode one device's values into a new row record
+///@return Zero on success or negative error code
+static int
+parse_row(
+    provision_table *table,	///< [in,out] Table to extend
+    char *cells[],		///< [in] Row cells, first one naming the image file
+    const nvm_symbol *list)	///< [in] List of symbols to check value sizes
+{
+    char **images, *data;
+    size_t *lengths, *row_lengths, error_pos;
+    ssize_t length;
+    int column, size;
+
+    if (table->num_rows >= table->rows_size) {
+	size = table->rows_size < 8 ? 16 : table->rows_size * 2;
+	images = realloc(table->images, size * sizeof(*images));
+	if (images) table->images = images;
+	lengths = realloc(table->lengths, size * table->num_columns * sizeof(*lengths));
+	if (lengths) table->lengths = lengths;
+	data = realloc(table->data, size * table->row_size + 1);	//never zero-sized
+	if (data) table->data = data;
+	if (! images || ! lengths || ! data) return -3;
+	table->rows_size = size;
+    }
+
+    row_lengths = table->lengths + table->num_rows * table->num_columns;
+    data = table->data + table->num_rows * table->row_size;
+    for (column = 0; column < table->num_columns; ++column) {
+	length = hex_decode(cells[column + 1], strlen(cells[column + 1]),
+			    data + table->offsets[column], list[table->symbols[column]].size,
+			    &error_pos);
+	if (length < 0) {
+	    fprintf(stderr, _("Could not parse byte data `%s' for field %s (%s at column %zu)\n"),
+		    cells[column + 1], list[table->symbols[column]].field->symbol,
+		    length == HEX_DECODE_TOO_LONG ? _("too long") : _("invalid hex digits"),
+		    error_pos + 1);
+	    return -2;
+	}
+	row_lengths[column] = length;
+    }
+
+    table->images[table->num_rows] = strdup(cells[0]);
+    if (! table->images[table->num_rows]) return -3;
+    ++table->num_rows;
+    return 0;
+}
+
+
+
+///@brief Read header and device rows from an open stream
+///@return Zero on success or negative error code
+static int
+parse_file(
+    FILE *in,			///< [in] Stream opened for reading
+    const char *filename,	///< [in] File name for error messages
+    provision_table *table,	///< [in,out] Table to fill
+    const nvm_symbol *list,	///< [in] @sa provision_read()
+    int size,			///< [in] @sa provision_read()
+    const symbol_index *index)	///< [in] @sa provision_read()
+{
+    char *line = NULL, **cells = NULL, delimiter = ',';
+    size_t length = 0;
+    ssize_t consumed;
+    int line_number = 0, num_cells = 0, count, ret = 0;
+
+    while (ret == 0 && (consumed = getline(&line, &length, in)) != -1) {
+	++line_number;
+	while (consumed > 0 && (line[consumed - 1] == '\n' || line[consumed - 1] == '\r')) {
+	    line[--consumed] = '\0';
+	}
+	if (! cells) {
+	    // Header line determines the format and number of columns
+	    if (strchr(line, '\t')) delimiter = '\t';
+	    for (count = 0, num_cells = 1; line[count]; ++count) {
+		if (line[count] == delimiter) ++num_cells;
+	    }
+	    cells = malloc(num_cells * sizeof(*cells));
+	    if (! cells) ret = -3;
+	    else if (num_cells < 2) {
+		fprintf(stderr, _("%s:%d: Expected image file and field name columns\n"),
+			filename, line_number);
+		ret = -2;
+	    } else {
+		split_cells(line, delimiter, cells, num_cells);
+		ret = parse_header(table, cells, num_cells, list, size, index);
+	    }
+	    continue;
+	}
+
+	if (consumed == 0 || strspn(line, " \t") == (size_t) consumed) continue;
+	count = split_cells(line, delimiter, cells, num_cells);
+	if (count != num_cells || ! *cells[0]) {
+	    fprintf(stderr, _("%s:%d: Expected %d columns starting with the image file name\n"),
+		    filename, line_number, num_cells);
+	    ret = -2;
+	} else if ((ret = parse_row(table, cells, list)) == -2) {
+	    fprintf(stderr, _("%s:%d: Invalid field value\n"), filename, line_number);
+	}
+    }
+    free(line);
+    free(cells);
+
+    if (ret == 0 && ! cells) {
+	fprintf(stderr, _("%s: Missing header line\n"), filename);
+	ret = -2;
+    }
+    return ret;
+}
+
+
+
+provision_table*
+provision_read(const char *filename, const nvm_symbol *list, int size,
+	       const symbol_index *index)
+{
+    provision_table *table;
+    FILE *in;
+    int ret;
+
+    if (! filename || ! list || size <= 0) return NULL;
+
+    if (strcmp(filename, "-") == 0) in = stdin;
+    else in = fopen(filename, "r");
+    if (! in) {
+	fprintf(stderr, _("Cannot open provisioning file \"%s\" (%s)\n"),
+		filename, strerror(errno));
+	return NULL;
+    }
+
+    table = calloc(1, sizeof(*table));
+    ret = table ? parse_file(in, filename, table, list, size, index) : -3;
+    if (in != stdin) fclose(in);
+
+    if (ret == -3) fprintf(stderr, _("Could not allocate memory for provisioning table.\n"));
+    if (ret < 0) {
+	provision_free(table);
+	return NULL;
+    }
+    if (DEBUG) printf("%s: %d rows of %d columns, %zu bytes each\n", __func__,
+		      table->num_rows, table->num_columns, table->row_size);
+    return table;
+}
+
+
+
+int
+provision_rows(const provision_table *table)
+{
+    if (! table) return 0;
+    return table->num_rows;
+}
+
+
+
+const char*
+provision_image_name(const provision_table *table, int row)
+{
+    if (! table || row < 0 || row >= table->num_rows) return NULL;
+    return table->images[row];
+}
+
+
+
+int
+provision_apply(const provision_table *table, int row, const nvm_symbol *list)
+{
+    const size_t *lengths;
+    const char *data;
+    int column, written = 0;
+
+    if (! table || row < 0 || row >= table->num_rows || ! list) return -1;
+
+    lengths = table->lengths + row * table->num_columns;
+    data = table->data + row * table->row_size;
+    for (column = 0; column < table->num_columns; ++column) {
+	if (! lengths[column]) continue;	//empty cell
+	memcpy(list[table->symbols[column]].blob_address, data + table->offsets[column],
+	       lengths[column]);
+	++written;
+    }
+    return written;
+}
+
+
+
+void
+provision_free(provision_table *table)
+{
+    int row;
+
+    if (! table) return;
+    for (row = 0; row < table->num_rows; ++row) free(table->images[row]);
+    free(table->images);
+    free(table->lengths);
+    free(table->data);
+    free(table->symbols);
+    free(table->offsets);
+    free(table);
+}
+
+
+
+#ifdef TEST_PROVISION
+int
+main(int argc, char **argv)
+{
+    char buf[8] = { 0 };
+    nvm_field fields[] = {
+	{ .symbol = "serial" },
+	{ .symbol = "mac" },
+    };
+    nvm_symbol symbols[] = {
+	{ 0, 2, buf, 0, &fields[0] },
+	{ 2, 6, buf + 2, 0, &fields[1] },
+    };
+    provision_table *table;
+    int row, i;
+
+    if (argc < 2) return 0;
+
+    table = provision_read(argv[1], symbols, sizeof(symbols) / sizeof(*symbols), NULL);
+    if (! table) return 1;
+    for (row = 0; row < provision_rows(table); ++row) {
+	printf("%s: %d fields", provision_image_name(table, row),
+	       provision_apply(table, row, symbols));
+	for (i = 0; i < (int) sizeof(buf); ++i) printf(" %02hhx", buf[i]);
+	putchar('\n');
+    }
+    provision_free(table);
+    return 0;
+}
+#endif
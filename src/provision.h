@@ -0,0 +1,80 @@
+///@file
+///@brief	Per-device field values read from CSV or TSV tables
+///@copyright	Copyright (C) 2026  Andre Colomb
+///
+/// This file is part of elf-mangle.
+///
+/// This file is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU Lesser General Public License as
+/// published by the Free Software Foundation, either version 3 of the
+/// License, or (at your option) any later version.
+///
+/// elf-mangle is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+/// Lesser General Public License for more details.
+///
+/// You should have received a copy of the GNU Lesser General Public
+/// License along with this program.  If not, see
+/// <http://www.gnu.org/licenses/>.
+///
+///@author	Andre Colomb <src@andre.colomb.de>
+
+
+#ifndef PROVISION_H_
+#define PROVISION_H_
+
+
+// Forward declarations
+typedef struct nvm_symbol nvm_symbol;
+typedef struct symbol_index symbol_index;
+
+/// Opaque type holding decoded field values for each device
+typedef struct provision_table provision_table;
+
+
+///@brief Read a table of per-device field values
+///@details The first line names the columns, separated by tabs if it contains
+///         any, otherwise by commas.  The first column holds each device's
+///         output image file name, every further column a field symbol name.
+///         Each following line lists the values for one device, as bytes
+///         encoded in hexadecimal like for overrides.  Empty cells leave the
+///         field unchanged.  Columns are resolved to symbols and all values
+///         decoded while reading, so applying a row only copies memory.
+///@return Address of the new table or NULL on error
+provision_table* provision_read(
+    const char *filename,	///< [in] Table file name, - for standard input
+    const nvm_symbol *list,	///< [in] List of symbols to resolve field names
+    int size,			///< [in] Number of symbols in the list
+    const symbol_index *index	///< [in] Index of the list for fast lookups or NULL
+);
+
+///@brief Check how many devices are listed in a table
+///@return Number of rows or zero on error
+int provision_rows(
+    const provision_table *table	///< [in] Table of field values
+);
+
+///@brief Access the output image file name for a device
+///@return File name or NULL on error
+const char* provision_image_name(
+    const provision_table *table,	///< [in] Table of field values
+    int row				///< [in] Index of the device row
+);
+
+///@brief Copy one device's field values into the listed symbols' data
+///@details The list must be in the same order as when reading the table, but
+///         may refer to different copies of the binary data.
+///@return Number of fields written or negative on error
+int provision_apply(
+    const provision_table *table,	///< [in] Table of field values
+    int row,				///< [in] Index of the device row
+    const nvm_symbol *list		///< [in] List of symbols to write to
+);
+
+///@brief Release a table of field values
+void provision_free(
+    provision_table *table		///< [in] Table to release, may be NULL
+);
+
+#endif //PROVISION_H_
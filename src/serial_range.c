@@ -0,0 +1,293 @@
+///@file
+///@brief	Counter values written to a field for a range of images
+///@copyright	Copyright (C) 2026  Andre Colomb
+///
+/// This file is part of elf-mangle.
+///
+/// This file is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU Lesser General Public License as
+/// published by the Free Software Foundation, either version 3 of the
+/// License, or (at your option) any later version.
+///
+/// elf-mangle is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+/// Lesser General Public License for more details.
+///
+/// You should have received a copy of the GNU Lesser General Public
+/// License along with this program.  If not, see
+/// <http://www.gnu.org/licenses/>.
+///
+///@author	Andre Colomb <src@andre.colomb.de>
+
+
+#include "config.h"
+
+#include "serial_range.h"
+#include "options.h"
+#include "symbol_list.h"
+#include "nvm_field.h"
+#include "intl.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <limits.h>
+#include <inttypes.h>
+
+/// Compile diagnostic output messages?
+#define DEBUG 0
+
+/// Characters allowed as printf() flags in image file name templates
+#define TEMPLATE_FLAGS		"-+ #0"
+/// Conversion characters allowed in image file name templates
+#define TEMPLATE_CONVERSIONS	"diuxXo"
+
+
+
+///@brief Parse an unsigned number in decimal or hexadecimal notation
+///@return Address of the first character after the number or NULL on error
+static const char*
+parse_number(
+    const char *text,		///< [in] Start of the number
+    uintmax_t *value)		///< [out] Parsed value
+{
+    char *end;
+
+    // Reject signs and white-space, which strtoumax() would skip
+    if (! isdigit((unsigned char) *text)) return NULL;
+    errno = 0;
+    *value = strtoumax(text, &end, 0);
+    if (errno || *value > INTMAX_MAX) return NULL;
+    return end;
+}
+
+
+
+int
+serial_range_parse(serial_range *range, const char *spec)
+{
+    uintmax_t first, last, step = 1;
+    const char *p;
+
+    if (! range || ! spec) return -1;
+
+    p = parse_number(spec, &first);
+    if (! p || *p++ != '-') return -2;
+    p = parse_number(p, &last);
+    if (p && *p == ':') p = parse_number(p + 1, &step);
+    if (! p || *p || last < first || step == 0) return -2;
+    if ((last - first) / step >= INT_MAX) return -2;
+
+    range->first = first;
+    range->last = last;
+    range->step = step;
+    range->count = (last - first) / step + 1;
+    if (DEBUG) printf("%s: %ju to %ju by %ju, %d values\n", __func__,
+		      first, last, step, range->count);
+    return 0;
+}
+
+
+
+int
+serial_range_parse_field(serial_range *range, const char *spec)
+{
+    const char *option, *end;
+    uintmax_t width;
+    size_t length;
+
+    if (! range || ! spec) return -1;
+
+    end = strchr(spec, ':');
+    if (end == spec) return -2;
+    range->field = spec;	//terminated by colon or NUL
+    range->big_endian = 0;
+    range->width = 0;
+
+    for (option = end; option; option = end) {
+	++option;
+	end = strchr(option, ':');
+	length = end ? (size_t) (end - option) : strlen(option);
+	if (length == 2 && strncmp(option, "be", length) == 0) range->big_endian = 1;
+	else if (length == 2 && strncmp(option, "le", length) == 0) range->big_endian = 0;
+	else if (parse_number(option, &width) == option + length && width > 0
+		 && width <= INT_MAX) {
+	    range->width = width;
+	} else return -2;
+    }
+    return 0;
+}
+
+
+
+uintmax_t
+serial_range_value(const serial_range *range, int index)
+{
+    return range->first + index * range->step;
+}
+
+
+
+int
+serial_range_resolve(const serial_range *range, const nvm_symbol *list, int size,
+		     const symbol_index *index)
+{
+    const nvm_symbol *symbol;
+    size_t length = range && range->field ? strcspn(range->field, ":") : 0, width;
+    char name[length + 1];
+
+    if (! range || ! range->field || ! list || size <= 0) return -1;
+
+    memcpy(name, range->field, length);
+    name[length] = '\0';
+
+    symbol = symbol_list_find_symbol(index, list, size, name);
+    if (! symbol) {
+	fprintf(stderr, _("Field `%s' not found in map.\n"), name);
+	return -2;
+    }
+    width = range->width ? range->width : symbol->size;
+    if (width > symbol->size) {
+	fprintf(stderr, _("Serial number width of %zu bytes exceeds field %s (%zu bytes)\n"),
+		width, name, symbol->size);
+	return -2;
+    }
+    if (width < sizeof(uintmax_t) && range->last >> (width * CHAR_BIT)) {
+	fprintf(stderr, _("Serial number %ju does not fit in %zu bytes of field %s\n"),
+		range->last, width, name);
+	return -2;
+    }
+    return symbol - list;
+}
+
+
+
+void
+serial_range_write(const serial_range *range, int index, const nvm_symbol *symbol)
+{
+    unsigned char *data = (unsigned char*) symbol->blob_address;
+    uintmax_t value = serial_range_value(range, index);
+    size_t width = range->width ? range->width : symbol->size, i;
+
+    for (i = 0; i < width; ++i) {
+	data[range->big_endian ? width - 1 - i : i] = value & UCHAR_MAX;
+	value = i + 1 < sizeof(value) ? value >> CHAR_BIT : 0;
+    }
+}
+
+
+
+///@brief Locate the integer conversion in an image file name template
+///@return Start of the conversion or NULL if not exactly one is found
+static const char*
+find_conversion(
+    const char *name_template,	///< [in] Image file name template
+    size_t *length)		///< [out] Length of the conversion specification
+{
+    const char *p, *found = NULL;
+    size_t n;
+
+    for (p = strchr(name_template, '%'); p; p = strchr(p, '%')) {
+	if (strncmp(p, SECTION_PLACEHOLDER, strlen(SECTION_PLACEHOLDER)) == 0) {
+	    p += strlen(SECTION_PLACEHOLDER);
+	    continue;
+	}
+	if (p[1] == '%') {
+	    p += 2;		//literal percent sign
+	    continue;
+	}
+	n = 1 + strspn(p + 1, TEMPLATE_FLAGS);
+	n += strspn(p + n, "0123456789");
+	if (p[n] == '.') n += 1 + strspn(p + n + 1, "0123456789");
+	if (found || ! p[n] || ! strchr(TEMPLATE_CONVERSIONS, p[n])) return NULL;
+	found = p;
+	*length = n + 1;
+	p += n + 1;
+    }
+    return found;
+}
+
+
+
+int
+serial_range_check_template(const char *name_template)
+{
+    size_t length;
+
+    if (! name_template) return -1;
+    return find_conversion(name_template, &length) ? 0 : -2;
+}
+
+
+
+char*
+serial_range_file_name(const char *name_template, uintmax_t value)
+{
+    const char *conversion;
+    char *name, format[32];
+    size_t length, prefix, suffix;
+    int formatted;
+
+    conversion = find_conversion(name_template, &length);
+    if (! conversion || length + 2 > sizeof(format)) return NULL;
+
+    // Widen the conversion for maximum size integers
+    memcpy(format, conversion, length - 1);
+    format[length - 1] = 'j';
+    format[length] = conversion[length - 1];
+    format[length + 1] = '\0';
+
+    prefix = conversion - name_template;
+    suffix = strlen(conversion + length);
+    if (strchr("di", conversion[length - 1])) formatted = snprintf(NULL, 0, format, (intmax_t) value);
+    else formatted = snprintf(NULL, 0, format, value);
+    if (formatted < 0) return NULL;
+
+    name = malloc(prefix + formatted + suffix + 1);
+    if (! name) return NULL;
+    memcpy(name, name_template, prefix);
+    if (strchr("di", conversion[length - 1])) {
+	snprintf(name + prefix, formatted + 1, format, (intmax_t) value);
+    } else snprintf(name + prefix, formatted + 1, format, value);
+    memcpy(name + prefix + formatted, conversion + length, suffix + 1);
+    return name;
+}
+
+
+
+#ifdef TEST_SERIAL_RANGE
+int
+main(int argc, char **argv)
+{
+    const char *templates[] = {
+	"unit_%05d.hex", "%s_%x.bin", "dev%d_%d", "plain.hex", "bad%n", "%%d", "%-8X|",
+	"unit_%%_%05d.hex", "%d%%%s",
+    };
+    char buf[4] = { 0 };
+    nvm_field field = { .symbol = "serial" };
+    nvm_symbol symbol = { 0, sizeof(buf), buf, 0, &field };
+    serial_range range = { 0 };
+    char *name;
+    unsigned t;
+    int index;
+
+    printf("range %d, field %d\n", serial_range_parse(&range, argc > 1 ? argv[1] : "0x10-40:8"),
+	   serial_range_parse_field(&range, argc > 2 ? argv[2] : "serial:be:3"));
+    printf("resolved %d\n", serial_range_resolve(&range, &symbol, 1, NULL));
+    for (index = 0; index < range.count; ++index) {
+	serial_range_write(&range, index, &symbol);
+	printf("%ju: %02hhx %02hhx %02hhx %02hhx\n", serial_range_value(&range, index),
+	       buf[0], buf[1], buf[2], buf[3]);
+    }
+    for (t = 0; t < sizeof(templates) / sizeof(*templates); ++t) {
+	name = serial_range_check_template(templates[t]) == 0
+	    ? serial_range_file_name(templates[t], 42) : NULL;
+	printf("%s -> %s\n", templates[t], name ? name : "(invalid)");
+	free(name);
+    }
+    return 0;
+}
+#endif
@@ -0,0 +1,118 @@
+///@file
+///@brief	Counter values written to a field for a range of images
+///@copyright	Copyright (C) 2026  Andre Colomb
+///
+/// This file is part of elf-mangle.
+///
+/// This file is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU Lesser General Public License as
+/// published by the Free Software Foundation, either version 3 of the
+/// License, or (at your option) any later version.
+///
+/// elf-mangle is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+/// Lesser General Public License for more details.
+///
+/// You should have received a copy of the GNU Lesser General Public
+/// License along with this program.  If not, see
+/// <http://www.gnu.org/licenses/>.
+///
+///@author	Andre Colomb <src@andre.colomb.de>
+
+
+#ifndef SERIAL_RANGE_H_
+#define SERIAL_RANGE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+// Forward declarations
+typedef struct nvm_symbol nvm_symbol;
+typedef struct symbol_index symbol_index;
+
+
+/// Range of counter values and how to encode them in a field
+typedef struct serial_range {
+    /// Symbol name of the field to write, NULL if not chosen
+    const char*		field;
+    /// First counter value
+    uintmax_t		first;
+    /// Last counter value, included in the range
+    uintmax_t		last;
+    /// Increment between consecutive values
+    uintmax_t		step;
+    /// Number of values in the range, zero if no range given
+    int			count;
+    /// Store values with the most significant byte first?
+    char		big_endian;
+    /// Number of bytes to write, zero for the whole field
+    size_t		width;
+} serial_range;
+
+
+///@brief Parse a range of counter values
+///@details The range is given as "FIRST-LAST", optionally followed by a colon
+///         and the STEP between values.  Numbers may be decimal or prefixed
+///         with 0x for hexadecimal.
+///@return Zero on success or negative error code
+int serial_range_parse(
+    serial_range *range,	///< [in,out] Range to set up
+    const char *spec		///< [in] Range specification
+);
+
+///@brief Parse the field name and encoding for counter values
+///@details The field symbol name may be followed by colon-separated options,
+///         "be" or "le" for the byte order (little-endian by default) and a
+///         decimal number of bytes to write.
+///@return Zero on success or negative error code
+int serial_range_parse_field(
+    serial_range *range,	///< [in,out] Range to set up
+    const char *spec		///< [in] Field specification
+);
+
+///@brief Calculate the counter value for one image
+///@return Counter value
+uintmax_t serial_range_value(
+    const serial_range *range,	///< [in] Range of values
+    int index			///< [in] Index of the image within the range
+);
+
+///@brief Find the field within a symbol list and check that all values fit
+///@return Index of the field's symbol within the list or negative on error
+int serial_range_resolve(
+    const serial_range *range,	///< [in] Range of values
+    const nvm_symbol *list,	///< [in] List of symbols to search
+    int size,			///< [in] Number of symbols in the list
+    const symbol_index *index	///< [in] Index of the list for fast lookups or NULL
+);
+
+///@brief Write the counter value for one image into the field's data
+void serial_range_write(
+    const serial_range *range,	///< [in] Range of values
+    int index,			///< [in] Index of the image within the range
+    const nvm_symbol *symbol	///< [in] Resolved field symbol to write to
+);
+
+///@brief Check an image file name template for a single integer conversion
+///@details The template must contain exactly one printf()-style conversion
+///         like %d, %u, %x, %X or %o, optionally with flags and field width.
+///         A section name placeholder is not counted, and %% stands for a
+///         literal percent sign.
+///@return Zero if valid or negative error code
+int serial_range_check_template(
+    const char *name_template	///< [in] Image file name template
+);
+
+///@brief Expand the integer conversion in an image file name template
+///@details Any %% is kept, so that it cannot form a section name
+///         placeholder.  It is reduced to a percent sign while substituting
+///         the section name.
+///@return Newly allocated file name or NULL on error
+char* serial_range_file_name(
+    const char *name_template,	///< [in] Image file name template, checked before
+    uintmax_t value		///< [in] Counter value to insert
+);
+
+#endif //SERIAL_RANGE_H_
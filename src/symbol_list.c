@@ -1,6 +1,6 @@
 ///@file
 ///@brief	Track lists of processed symbols
-///@copyright	Copyright (C) 2014, 2023  Andre Colomb
+///@copyright	Copyright (C) 2014, 2023, 2026  Andre Colomb
 ///
 /// This file is part of elf-mangle.
 ///
@@ -29,20 +29,55 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
 
+/// Compile diagnostic output messages?
+#define DEBUG 0
 
+/// Capacity to start with when growing an empty list
+#define MIN_CAPACITY	16
 
+/// Marker for empty hash table slots and chain ends
+#define NO_SYMBOL	(-1)
+
+
+
+/// Hash tables to find symbols within a list by field descriptor or name
+struct symbol_index {
+    /// Indexed list of symbols
+    const nvm_symbol*	list;
+    /// Number of symbols in the indexed list
+    int			size;
+    /// Number of hash table slots minus one, for masking hash values
+    size_t		mask;
+    /// Hash table slots with the first symbol per field descriptor
+    int*		by_field;
+    /// Hash table slots with the first symbol per name
+    int*		by_name;
+    /// Next symbol in the list with the same field descriptor, per symbol
+    int*		next_field;
+    /// Next symbol in the list with the same name, per symbol
+    int*		next_name;
+};
+
+
+
+/// The capacity is doubled on each call, so appending many elements one by
+/// one takes amortized constant time each.  Excess capacity can be released
+/// later using symbol_list_truncate().
 nvm_symbol*
 symbol_list_append(nvm_symbol *(list[]), int *size)
 {
     nvm_symbol *new_list;
+    int new_size;
 
     if (! list || ! size) return NULL;
 
-    new_list = realloc(*list, (*size + 1) * sizeof(nvm_symbol));
+    new_size = *size < MIN_CAPACITY / 2 ? MIN_CAPACITY : *size * 2;
+    new_list = realloc(*list, new_size * sizeof(nvm_symbol));
     if (new_list) {
 	*list = new_list;
-	++(*size);
+	*size = new_size;
     }
     return new_list;
 }
@@ -112,6 +147,100 @@ symbol_list_foreach_count(const nvm_symbol list[], const int size,
 
 
 
+/// Calculate the hash value of a field descriptor address
+static inline size_t
+hash_field(const nvm_field *field)
+{
+    return (size_t) (((uintptr_t) field >> 3) * 2654435761U);
+}
+
+
+
+/// Check whether an index covers a range of symbols
+static inline int
+covers(const symbol_index *index, const nvm_symbol list[], int size)
+{
+    return index && list >= index->list && list + size <= index->list + index->size;
+}
+
+
+
+symbol_index*
+symbol_list_index(const nvm_symbol list[], const int size)
+{
+    symbol_index *index;
+    size_t capacity, pos;
+    int i, *slot;
+
+    if (! list || size <= 0) return NULL;
+
+    // Keep the load factor at or below 1/2
+    for (capacity = MIN_CAPACITY; capacity < (size_t) size * 2; capacity *= 2);
+    index = malloc(sizeof(*index) + (2 * capacity + 2 * size) * sizeof(int));
+    if (! index) return NULL;
+    index->list = list;
+    index->size = size;
+    index->mask = capacity - 1;
+    index->by_field = (int*) (index + 1);
+    index->by_name = index->by_field + capacity;
+    index->next_field = index->by_name + capacity;
+    index->next_name = index->next_field + size;
+    for (pos = 0; pos < 2 * capacity; ++pos) index->by_field[pos] = NO_SYMBOL;
+
+    // Insert backwards, so each chain lists its symbols in ascending order
+    for (i = size - 1; i >= 0; --i) {
+	index->next_field[i] = index->next_name[i] = NO_SYMBOL;
+	if (! list[i].field) continue;
+
+	for (pos = hash_field(list[i].field) & index->mask;
+	     *(slot = &index->by_field[pos]) != NO_SYMBOL
+		 && list[*slot].field != list[i].field;
+	     pos = (pos + 1) & index->mask);
+	index->next_field[i] = *slot;
+	*slot = i;
+
+	for (pos = field_hash_name(list[i].field->symbol, 0) & index->mask;
+	     *(slot = &index->by_name[pos]) != NO_SYMBOL
+		 && strcmp(list[*slot].field->symbol, list[i].field->symbol) != 0;
+	     pos = (pos + 1) & index->mask);
+	index->next_name[i] = *slot;
+	*slot = i;
+    }
+    if (DEBUG) printf("%s: %d symbols at %p, %zu slots\n", __func__, size, list, capacity);
+
+    return index;
+}
+
+
+
+void
+symbol_list_free_index(symbol_index *index)
+{
+    free(index);
+}
+
+
+
+///@brief Pick the first symbol of a chain lying within the searched range
+///@return Address of the matching symbol or NULL if not in range
+static const nvm_symbol*
+first_in_range(
+    const symbol_index *index,	///< [in] Index of the containing list
+    const int next[],		///< [in] Chain links to follow
+    int i,			///< [in] First symbol of the chain
+    const nvm_symbol list[],	///< [in] First symbol of the searched range
+    int size)			///< [in] Number of symbols in the searched range
+{
+    int begin = list - index->list;
+
+    for (; i != NO_SYMBOL && i < begin + size; i = next[i]) {
+	if (i >= begin) return &index->list[i];
+    }
+    return NULL;
+}
+
+
+
 ///@brief Iterator function to compare field descriptor
 ///@see symbol_list_iterator_f
 static const nvm_symbol*
@@ -126,9 +255,24 @@ find_symbol_iterator_field(
 
 
 const nvm_symbol*
-symbol_list_find_field(const nvm_symbol list[], const int size,
+symbol_list_find_field(const symbol_index *index, const nvm_symbol list[], const int size,
 		       const nvm_field *field)
 {
+    size_t pos;
+    int i;
+
+    if (! list || size <= 0) return NULL;
+
+    if (field && covers(index, list, size)) {
+	for (pos = hash_field(field) & index->mask; (i = index->by_field[pos]) != NO_SYMBOL;
+	     pos = (pos + 1) & index->mask) {
+	    if (index->list[i].field == field) {
+		return first_in_range(index, index->next_field, i, list, size);
+	    }
+	}
+	return NULL;
+    }
+
     return symbol_list_foreach(list, size, find_symbol_iterator_field, field);
 }
 
@@ -148,8 +292,120 @@ find_symbol_iterator_symbol(
 
 
 const nvm_symbol*
-symbol_list_find_symbol(const nvm_symbol list[], const int size,
+symbol_list_find_symbol(const symbol_index *index, const nvm_symbol list[], const int size,
 			const char *symbol)
 {
+    size_t pos;
+    int i;
+
+    if (! list || size <= 0) return NULL;
+
+    if (symbol && covers(index, list, size)) {
+	for (pos = field_hash_name(symbol, 0) & index->mask;
+	     (i = index->by_name[pos]) != NO_SYMBOL; pos = (pos + 1) & index->mask) {
+	    if (strcmp(index->list[i].field->symbol, symbol) == 0) {
+		return first_in_range(index, index->next_name, i, list, size);
+	    }
+	}
+	return NULL;
+    }
+
     return symbol_list_foreach(list, size, find_symbol_iterator_symbol, symbol);
 }
+
+
+
+#ifdef TEST_SYMBOL_LIST
+#include <time.h>
+
+/// Find each symbol of a reversed copy in the source list, like transfer_fields()
+static int
+find_all(const symbol_index *index, const nvm_symbol list_src[], const nvm_symbol list_dst[],
+	 int size)
+{
+    int n, found = 0;
+
+    for (n = 0; n < size; ++n) {
+	if (symbol_list_find_field(index, list_src, size, list_dst[n].field)) ++found;
+	if (symbol_list_find_symbol(index, list_src, size, list_dst[n].field->symbol)) ++found;
+    }
+    return found;
+}
+
+
+
+/// Benchmark growing symbol lists the same way as during ELF parsing.
+///
+/// With amortized constant time per appended element, the time per
+/// symbol should stay about the same for each list size.  The same holds
+/// for looking up all symbols between two indexed lists, while the linear
+/// search without index is only run for smaller lists.
+int
+main(void)
+{
+    static const int counts[] = { 12500, 25000, 50000, 100000, 200000 };
+    struct timespec start, end;
+    nvm_symbol *list, *list_dst;
+    symbol_index *index;
+    nvm_field *fields;
+    char *names;
+    int i, n, list_size, found;
+    double elapsed;
+
+    for (i = 0; i < (int) (sizeof(counts) / sizeof(*counts)); ++i) {
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	list_size = 0;
+	list = NULL;
+	for (n = 0; n < counts[i]; ++n) {
+	    if (n >= list_size && ! symbol_list_append(&list, &list_size)) return 1;
+	    list[n].offset = n;
+	    list[n].size = 1;
+	}
+	if (! symbol_list_truncate(&list, n)) return 1;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	elapsed = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+	printf("%7d symbols: %10.3f ms total, %6.2f ns per symbol appended\n",
+	       counts[i], elapsed / 1e6, elapsed / counts[i]);
+
+	// Distinct fields in the source list, referenced in reverse order
+	fields = calloc(counts[i], sizeof(*fields));
+	names = malloc(counts[i] * 24);
+	list_dst = malloc(counts[i] * sizeof(*list_dst));
+	if (! fields || ! names || ! list_dst) return 1;
+	for (n = 0; n < counts[i]; ++n) {
+	    snprintf(names + n * 24, 24, "nvm_sym_%d", n);
+	    fields[n].symbol = names + n * 24;
+	    list[n].field = &fields[n];
+	    list_dst[counts[i] - 1 - n] = list[n];
+	}
+
+	if (counts[i] <= 25000) {
+	    clock_gettime(CLOCK_MONOTONIC, &start);
+	    found = find_all(NULL, list, list_dst, counts[i]);
+	    clock_gettime(CLOCK_MONOTONIC, &end);
+	    elapsed = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+	    printf("%7d symbols: %10.3f ms total, %9.2f ns per symbol found linearly%s\n",
+		   counts[i], elapsed / 1e6, elapsed / counts[i],
+		   found == 2 * counts[i] ? "" : " (FAILED)");
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	index = symbol_list_index(list, counts[i]);
+	if (! index) return 1;
+	found = find_all(index, list, list_dst, counts[i]);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	elapsed = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+	printf("%7d symbols: %10.3f ms total, %9.2f ns per symbol found by index%s\n",
+	       counts[i], elapsed / 1e6, elapsed / counts[i],
+	       found == 2 * counts[i] ? "" : " (FAILED)");
+
+	symbol_list_free_index(index);
+	free(list_dst);
+	free(names);
+	free(fields);
+	free(list);
+    }
+    return 0;
+}
+#endif
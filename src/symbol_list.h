@@ -1,6 +1,6 @@
 ///@file
 ///@brief	Track lists of processed symbols
-///@copyright	Copyright (C) 2014, 2023  Andre Colomb
+///@copyright	Copyright (C) 2014, 2023, 2026  Andre Colomb
 ///
 /// This file is part of elf-mangle.
 ///
@@ -29,6 +29,7 @@
 
 // Forward declarations
 typedef struct nvm_field nvm_field;
+typedef struct symbol_index symbol_index;
 
 
 /// Description of a meaningful location within binary data
@@ -55,12 +56,12 @@ typedef const nvm_symbol* (*symbol_list_iterator_f)(
 );
 
 
-///@brief Append an element to the list
+///@brief Grow the list to make room for appending at least one element
 ///@note All references to symbols in the list become invalid on success
 ///@return New location of the first symbol in the list or NULL on error
 nvm_symbol* symbol_list_append(
     nvm_symbol *(list[]),		///< [in,out] Start location of the list
-    int *size				///< [out] New list size
+    int *size				///< [in,out] Allocated list size
 );
 
 ///@brief Truncate the list to the specified number of elements, releasing excess memory
@@ -72,7 +73,7 @@ nvm_symbol* symbol_list_truncate(
 );
 
 ///@brief Release memory allocated for list members
-///@note This applies to the original value member
+///@note This applies to the original value member only, not to any index
 void symbol_list_free(
     nvm_symbol list[],			///< [in,out] Start location of the list
     int size				///< [out] New list size
@@ -97,17 +98,39 @@ int symbol_list_foreach_count(
     const void *arg			///< [in] Custom data passed to iterator function
 );
 
+///@brief Build hash tables to find symbols in the list in constant time
+///@details symbol_list_find_field() and symbol_list_find_symbol() use the
+///         index for the whole list and any range within it.
+///@note The index must be rebuilt after modifying the symbols' field
+///      descriptors, and released before the list memory is released or moved.
+///@return Newly allocated index or NULL on error
+symbol_index* symbol_list_index(
+    const nvm_symbol list[],		///< [in] List of symbols to index
+    int size				///< [in] Number of symbols in the list
+);
+
+///@brief Release an index built by symbol_list_index()
+void symbol_list_free_index(
+    symbol_index *index			///< [in] Index to release, may be NULL
+);
+
 ///@brief Find the first symbol with a given field descriptor
+///@details Uses the index if it covers the searched range, otherwise searches
+///         linearly.
 ///@return Address of the first matching symbol or NULL on error
 const nvm_symbol* symbol_list_find_field(
+    const symbol_index *index,		///< [in] Index of the containing list or NULL
     const nvm_symbol list[],		///< [in] List of symbols to search through
     int size,				///< [in] Number of symbols in the list
     const nvm_field *field		///< [in] Field descriptor to look for
 );
 
 ///@brief Find the first symbol whose field descriptor matches a given name
+///@details Uses the index if it covers the searched range, otherwise searches
+///         linearly.
 ///@return Address of the first matching symbol or NULL on error
 const nvm_symbol* symbol_list_find_symbol(
+    const symbol_index *index,		///< [in] Index of the containing list or NULL
     const nvm_symbol list[],		///< [in] List of symbols to search through
     int size,				///< [in] Number of symbols in the list
     const char *symbol			///< [in] Symbol name to look for
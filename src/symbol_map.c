@@ -1,6 +1,6 @@
 ///@file
 ///@brief	Parsing of ELF files as symbol map sources
-///@copyright	Copyright (C) 2014, 2015, 2023  Andre Colomb
+///@copyright	Copyright (C) 2014, 2015, 2023, 2026  Andre Colomb
 ///
 /// This file is part of elf-mangle.
 ///
@@ -25,6 +25,7 @@
 
 #include "symbol_map.h"
 #include "symbol_list.h"
+#include "layout_file.h"
 #include "known_fields.h"
 #include "field_list.h"
 #include "nvm_field.h"
@@ -32,12 +33,20 @@
 
 #include <gelf.h>
 
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
+#include <sys/stat.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <inttypes.h>
 
 /// Compile diagnostic output messages?
 #define DEBUG 0
@@ -47,19 +56,80 @@
 #define O_BINARY	0
 #endif
 
+// Default to libelf's own file reading
+#ifndef HAVE_MMAP
+#define HAVE_MMAP 0
+#endif
 
+// Default to sequential symbol table scanning
+#ifndef HAVE_PTHREADS
+#define HAVE_PTHREADS 0
+#endif
 
 
-/// Internal state of a symbol map
-struct nvm_symbol_map_source {
-    /// File descriptor for the ELF file
-    int			fd;
-    /// Handle to process the file with libelf
-    Elf*		elf;
+
+
+// Note type of the GNU build ID, missing from some libelf headers
+#ifndef NT_GNU_BUILD_ID
+#define NT_GNU_BUILD_ID	3
+#endif
+
+/// Maximum length of a build ID in bytes
+#define BUILD_ID_MAX_SIZE	((SYMBOL_MAP_BUILD_ID_SIZE - 1) / 2)
+
+/// Minimum number of symbol table entries worth scanning in a separate thread
+#define MIN_THREAD_SYMBOLS	16384
+
+
+
+/// Binary data and symbols of one examined section
+typedef struct map_section {
+    /// Name of the section
+    const char*		name;
     /// Address of the binary data
     char*		blob;
     /// Size of the binary data
     size_t		blob_size;
+    /// Address where the binary data is loaded on the target
+    size_t		load_address;
+    /// Binary data lies within the memory mapping instead of separate memory
+    char		blob_mapped;
+    /// Index of the section's first symbol in the parsed list
+    int			first_symbol;
+    /// Number of consecutive symbols belonging to the section
+    int			num_symbols;
+    /// Hash over the resolved symbol layout, zero if not computed yet
+    uint64_t		fingerprint;
+    /// All fields are unique and copied verbatim, without custom functions
+    char		plain_copy;
+} map_section;
+
+/// Internal state of a symbol map
+struct nvm_symbol_map_source {
+    /// File descriptor for the map file
+    int			fd;
+    /// Handle to process the file with libelf, NULL until needed
+    Elf*		elf;
+    /// Memory mapped file contents, NULL if read by libelf itself
+    char*		map_address;
+    /// Size of the memory mapped file contents
+    size_t		map_size;
+    /// GNU build ID of the ELF file in hex notation, kept when its contents are replaced
+    char		build_id[2 * BUILD_ID_MAX_SIZE + 1];
+    /// Sections examined by the last parsing
+    map_section*	sections;
+    /// Number of examined sections
+    int			num_sections;
+    /// Index of the symbol list from the last parsing, NULL if not indexed
+    symbol_index*	index;
+    /// Placeholder fields of symbols not resolved yet, NULL if parsed eagerly
+    nvm_field*		raw_fields;
+    /// Number of placeholder fields
+    int			num_raw_fields;
+    /// Symbol sizes still need adjustment by field resize functions
+    char		raw_sizes;
+    /// Symbols resolved by name since indexing, so the index by field is outdated
+    char		stale_index;
 };
 
 
@@ -67,79 +137,454 @@ struct nvm_symbol_map_source {
 /// List of unknown fields found during parsing
 static nvm_field_list fields_unknown;
 
+/// Directory to store compiled layouts for reuse, NULL to disable caching
+static const char *layout_cache_directory;
 
+/// Number of threads to scan the symbol table with
+static int scan_threads = 1;
 
-///@brief Examine the overall ELF structure to find needed sections
+/// Defer field resolution until symbol_map_resolve() is called?
+static char lazy_resolution;
+
+#if HAVE_PTHREADS
+/// Serialize concurrent access to the unknown fields list
+static pthread_mutex_t fields_unknown_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+
+
+///@brief Look up the field descriptor for a symbol name
+///@details Unknown symbols get a new field descriptor, which is shared with
+///         any equally named symbols parsed later.  Safe to call from
+///         concurrent scanning threads.
+///@return Address of the field descriptor or NULL on error
+static const nvm_field*
+bind_field(
+    const char *name,		///< [in] Symbol name
+    size_t size)		///< [in] Expected size to record for unknown fields
+{
+    const nvm_field *field;
+
+    field = find_known_field(name);
+    if (field) return field;
+
+#if HAVE_PTHREADS
+    pthread_mutex_lock(&fields_unknown_lock);
+#endif
+    // Look up field in case it was found during previous parsing
+    field = field_list_find(name, &fields_unknown);
+    if (! field) {		//unknown symbol encountered
+	field = field_list_add(&fields_unknown, size, name, NULL);
+    }
+#if HAVE_PTHREADS
+    pthread_mutex_unlock(&fields_unknown_lock);
+#endif
+    return field;
+}
+
+
+
+/// Keep a separate copy of the symbol's current content
+static inline void
+save_original_value(nvm_symbol *symbol)
+{
+    void *copy;
+
+    copy = malloc(symbol->size);
+    if (copy) symbol->original_value = memcpy(copy, symbol->blob_address, symbol->size);
+}
+
+
+
+/// Update symbol size based on content where applicable, limited to the blob boundary
+static inline void
+adjust_size(nvm_symbol *symbol, size_t blob_size)
+{
+    if (symbol->field && symbol->field->expected_size != symbol->size
+	&& symbol->field->resize_func) {
+	symbol->size = symbol->field->resize_func(symbol->blob_address, symbol->size);
+	if (symbol->size > blob_size - symbol->offset) symbol->size = blob_size - symbol->offset;
+    }
+}
+
+
+
+/// Spread the bits of a 64-bit value over the whole word (SplitMix64 finalizer)
+static inline uint64_t
+mix_bits(uint64_t value)
+{
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+
+
+
+///@brief Compute the layout fingerprint of each completely resolved section
+///@details Every symbol contributes a hash of its name, offset, size and how
+///         its field gets copied.  The contributions are summed up, so the
+///         result does not depend on symbol order, just as hashing the tuples
+///         in sorted order but without the need to sort.  The list's index
+///         should be up to date, as each symbol is checked to be the first
+///         one bound to its field.
 static void
-find_symtab_and_section(
+fingerprint_sections(
+    const nvm_symbol_map_source *source,	///< [in] Handle of the parsed map source
+    const nvm_symbol *symbol_list,		///< [in] Combined list of parsed symbols
+    int num_symbols)				///< [in] Number of symbols in the list
+{
+    map_section *section;
+    const nvm_symbol *symbol, *list;
+    const unsigned char *c;
+    uint64_t hash, sum, binding;
+
+    for (section = source->sections;
+	 section < source->sections + source->num_sections; ++section) {
+	list = symbol_list + section->first_symbol;
+	if (section->first_symbol + section->num_symbols > num_symbols) continue;
+	sum = 0;
+	section->plain_copy = 1;
+	for (symbol = list; symbol < list + section->num_symbols; ++symbol) {
+	    // Placeholder fields do not tell how the data is copied
+	    if (source->raw_fields && symbol->field >= source->raw_fields
+		&& symbol->field < source->raw_fields + source->num_raw_fields) break;
+
+	    // FNV-1a over the name including its terminator
+	    hash = 14695981039346656037ULL;
+	    c = (const unsigned char*) symbol->field->symbol;
+	    do {
+		hash = (hash ^ *c) * 1099511628211ULL;
+	    } while (*c++);
+
+	    if (! symbol->field->copy_func || symbol->field->copy_func == copy_field_verbatim) {
+		binding = 0;
+	    } else {
+		binding = symbol->field->copy_func == copy_field_noop ? 1 : 2;
+		section->plain_copy = 0;
+	    }
+	    // Equally named symbols only ever receive the first one's data
+	    if (section->plain_copy
+		&& symbol_list_find_field(source->index, list, section->num_symbols,
+					  symbol->field) != symbol) {
+		section->plain_copy = 0;
+	    }
+	    hash = mix_bits(hash ^ symbol->offset);
+	    hash = mix_bits(hash ^ symbol->size);
+	    sum += mix_bits(hash ^ binding);
+	}
+	if (symbol < list + section->num_symbols) {
+	    section->fingerprint = 0;
+	    section->plain_copy = 0;
+	    continue;
+	}
+	section->fingerprint = mix_bits(mix_bits(sum ^ section->num_symbols) ^ section->blob_size);
+	if (! section->fingerprint) section->fingerprint = 1;	//zero means not computed
+	if (DEBUG) printf("%s: %s %016" PRIx64 " plain=%d\n", __func__, section->name,
+			  section->fingerprint, section->plain_copy);
+    }
+}
+
+
+
+///@brief Examine the overall ELF structure to find needed sections
+///@return Number of requested data sections not found
+static int
+find_symtab_and_sections(
     Elf *elf,			///< [in] Elf object handle
     Elf_Scn **symtab,		///< [out] Section handle for the symbol table
     size_t *strings_index,	///< [out] Number of the string table section
-    const char *section_name,	///< [in] Name of the data section to examine
-    Elf_Scn **section,		///< [out] Section handle for the requested data section
-    GElf_Shdr *header)		///< [out] Section header of the requested data section
+    const map_section sections[],	///< [in] Data sections to examine
+    const int num_sections,	///< [in] Number of data sections
+    Elf_Scn *scn_found[],	///< [out] Section handles for the requested data sections
+    GElf_Shdr headers[])	///< [out] Section headers of the requested data sections
 {
     size_t shstrndx;
     Elf_Scn *scn = NULL;
     GElf_Shdr shdr;
+    const char *name;
+    int i, missing = num_sections;
 
     // Require all output arguments
-    if (! symtab || ! section || ! header) return;
-    *symtab = *section = NULL;
+    if (! symtab || ! scn_found || ! headers) return missing;
+    *symtab = NULL;
+    for (i = 0; i < num_sections; ++i) scn_found[i] = NULL;
     // Get the section header string table index
     if (elf_getshdrstrndx(elf, &shstrndx) < 0) {
 	fprintf(stderr, _("Could not access section header string table: %s\n"),
 		elf_errmsg(-1));
-	return;
+	return missing;
     }
 
     // Scan through the section table
     while ((scn = elf_nextscn(elf, scn)) != NULL) {
 	// Get the section header
 	if (gelf_getshdr(scn, &shdr) != NULL) {
-	    if (DEBUG) printf(_("%s: [%zu] %s\n"), __func__,
-			      elf_ndxscn(scn), elf_strptr(elf, shstrndx, shdr.sh_name));
+	    name = elf_strptr(elf, shstrndx, shdr.sh_name);
+	    if (DEBUG) printf(_("%s: [%zu] %s\n"), __func__, elf_ndxscn(scn), name);
 	    if (shdr.sh_type == SHT_SYMTAB) {
 		*symtab = scn;
 		*strings_index = shdr.sh_link;
-	    } else if (strcmp(elf_strptr(elf, shstrndx, shdr.sh_name),
-			      section_name) == 0) {
-		*section = scn;
-		*header = shdr;
+	    } else if (name) {
+		for (i = 0; i < num_sections; ++i) {
+		    if (! scn_found[i] && strcmp(name, sections[i].name) == 0) {
+			scn_found[i] = scn;
+			headers[i] = shdr;
+			--missing;
+			break;
+		    }
+		}
 	    }
-	    if (*symtab && *section) break;
+	    if (*symtab && ! missing) break;
 	} else {
 	    fprintf(stderr, _("Header of ELF section %zu inaccessible: %s\n"),
 		    elf_ndxscn(scn), elf_errmsg(-1));
 	}
     }
     if (! *symtab) fprintf(stderr, _("No ELF symbol table found\n"));
-    if (! *section) fprintf(stderr, _("No ELF section named '%s' found\n"),
-			    section_name);
+    for (i = 0; i < num_sections; ++i) {
+	if (! scn_found[i]) fprintf(stderr, _("No ELF section named '%s' found\n"),
+				    sections[i].name);
+    }
+    return missing;
 }
 
 
 
-///@brief Allocate memory for the section's binary data
-///@return Address of the allocated memory or NULL on error
+///@brief Provide memory for the section's binary data
+///@details If the file is memory mapped, the section content is used in place.
+///         Only pages actually modified later get copied by the private mapping.
+///@return Address of the binary data memory or NULL on error
 static char*
 allocate_blob(
-    nvm_symbol_map_source *source,	///< [in,out] Handle of the map source
-    GElf_Shdr *header)			///< [in] Section header of the data section
+    const nvm_symbol_map_source *source,	///< [in] Handle of the map source
+    map_section *section,		///< [in,out] Examined section to hold the data
+    const GElf_Shdr *header)		///< [in] Section header of the data section
 {
     if (! header) return NULL;
 
+    section->blob_size = header->sh_size;
+    if (source->map_address && header->sh_type != SHT_NOBITS
+	&& header->sh_offset <= source->map_size
+	&& header->sh_size <= source->map_size - header->sh_offset) {
+	section->blob = source->map_address + header->sh_offset;
+	section->blob_mapped = 1;
+	return section->blob;
+    }
+
     // Allocate fresh blob memory because ELF object data may be memory mapped
-    source->blob_size = header->sh_size;
-    source->blob = malloc(source->blob_size);
-    if (! source->blob) fprintf(stderr, _("Could not allocate image data: %s\n"),
-				strerror(errno));
-    return source->blob;
+    section->blob = malloc(section->blob_size);
+    if (! section->blob) fprintf(stderr, _("Could not allocate image data: %s\n"),
+				 strerror(errno));
+    return section->blob;
+}
+
+
+
+/// Symbols found in one section by one scanning thread
+typedef struct scan_bucket {
+    /// List of discovered symbols
+    nvm_symbol*		list;
+    /// Number of symbols in the list
+    int			count;
+    /// Allocated list size
+    int			size;
+    /// Raw names of the listed symbols, only used for lazy resolution
+    const char**	names;
+} scan_bucket;
+
+/// Symbol table information shared by all scanning threads
+typedef struct scan_context {
+    /// Symbol table data
+    Elf_Data*		symtab_data;
+    /// String table data, checked for NUL termination
+    const Elf_Data*	strings_data;
+    /// Section numbers of the requested data sections
+    const size_t*	indices;
+    /// Section headers of the requested data sections
+    const GElf_Shdr*	headers;
+    /// Examined sections with allocated blob memory
+    const map_section*	sections;
+    /// Number of data sections
+    int			num_sections;
+    /// Need a separate copy of the original content value?
+    int			save_values;
+    /// Only record symbol names, deferring field resolution?
+    int			lazy;
+} scan_context;
+
+/// Partition of the symbol table scanned by one thread
+typedef struct scan_range {
+    /// Shared symbol table information
+    const scan_context*	context;
+    /// Index of the first symbol table entry to scan
+    int			begin;
+    /// Index after the last symbol table entry to scan
+    int			end;
+    /// Symbols found, one bucket per requested section
+    scan_bucket*	buckets;
+    /// Zero on success or negative error code
+    int			error;
+} scan_range;
+
+
+
+///@brief Sort the symbols within one partition of the symbol table into buckets
+///@return Always NULL, errors are reported in the range structure
+static void*
+scan_symbols(
+    void *arg)			///< [in,out] Partition to scan, a scan_range structure
+{
+    scan_range *range = arg;
+    const scan_context *ctx = range->context;
+    scan_bucket *bucket;
+    nvm_symbol *current;
+    const char *name, **names;
+    GElf_Sym sym;
+    int sym_index, i;
+
+    for (sym_index = range->begin; sym_index < range->end; ++sym_index) {
+	if (! gelf_getsym(ctx->symtab_data, sym_index, &sym) ||	//no symbol found
+	    sym.st_size == 0) continue;				//empty symbol
+	// Find the examined section containing the symbol, if any
+	for (i = 0; i < ctx->num_sections && sym.st_shndx != ctx->indices[i]; ++i);
+	if (i == ctx->num_sections) continue;			//symbol in wrong section
+	if (sym.st_name >= ctx->strings_data->d_size) continue;	//invalid name
+	name = (const char*) ctx->strings_data->d_buf + sym.st_name;
+
+	bucket = &range->buckets[i];
+	if (bucket->count >= bucket->size) {	//list is full
+	    if (DEBUG) printf("%s: count %d size %d %p\n", __func__,
+			      bucket->count, bucket->size, bucket->list);
+	    if (! symbol_list_append(&bucket->list, &bucket->size)) {
+		range->error = -3;
+		break;
+	    }
+	    if (ctx->lazy) {
+		names = realloc(bucket->names, bucket->size * sizeof(*names));
+		if (! names) {
+		    range->error = -3;
+		    break;
+		}
+		bucket->names = names;
+	    }
+	}
+	current = bucket->list + bucket->count;
+	current->offset = sym.st_value - ctx->headers[i].sh_addr;
+	current->size = sym.st_size;
+	current->blob_address = ctx->sections[i].blob + current->offset;
+	current->original_value = NULL;
+	current->field = NULL;
+	if (ctx->lazy) bucket->names[bucket->count++] = name;
+	else {
+	    ++bucket->count;
+	    if (ctx->save_values) save_original_value(current);
+	    current->field = bind_field(name, sym.st_size);
+	    adjust_size(current, ctx->sections[i].blob_size);
+	}
+    }
+    return NULL;
+}
+
+
+
+///@brief Scan all partitions, in separate threads where possible
+///@details The calling thread scans the last partition itself.  If a thread
+///         cannot be started, its partition is scanned sequentially instead.
+static void
+scan_partitions(
+    scan_range ranges[],	///< [in,out] Partitions of the symbol table
+    const int num_ranges)	///< [in] Number of partitions
+{
+#if HAVE_PTHREADS
+    pthread_t threads[num_ranges];
+    char started[num_ranges];
+    int i;
+
+    for (i = 0; i < num_ranges - 1; ++i) {
+	started[i] = pthread_create(&threads[i], NULL, scan_symbols, &ranges[i]) == 0;
+	if (! started[i]) scan_symbols(&ranges[i]);
+    }
+    scan_symbols(&ranges[num_ranges - 1]);
+    for (i = 0; i < num_ranges - 1; ++i) {
+	if (started[i]) pthread_join(threads[i], NULL);
+    }
+#else // !HAVE_PTHREADS
+    int i;
+
+    for (i = 0; i < num_ranges; ++i) scan_symbols(&ranges[i]);
+#endif
+}
+
+
+
+///@brief Concatenate the buckets from all partitions into one contiguous list
+///@details Within each section, partitions are joined in order, so symbols
+///         keep the order of the symbol table regardless of thread scheduling.
+///         For lazy resolution, each symbol is linked to a placeholder field
+///         holding its raw name and size.
+///@return Total number of symbols or negative value on error
+static int
+join_buckets(
+    map_section sections[],	///< [in,out] Examined sections to record symbol ranges
+    const int num_sections,	///< [in] Number of examined sections
+    scan_range ranges[],	///< [in] Scanned partitions, buckets released afterwards
+    const int num_ranges,	///< [in] Number of partitions
+    nvm_symbol **symbol_list,	///< [out] Combined list of discovered symbols
+    nvm_field **raw_fields)	///< [out] Placeholder fields, NULL unless resolving lazily
+{
+    int i, r, n, total = 0, error = 0;
+    nvm_symbol *current;
+    nvm_field *raw = NULL;
+    scan_bucket *bucket;
+
+    for (r = 0; r < num_ranges; ++r) if (ranges[r].error) error = ranges[r].error;
+    for (i = 0; i < num_sections; ++i) {
+	sections[i].first_symbol = total;
+	sections[i].num_symbols = 0;
+	for (r = 0; r < num_ranges; ++r) sections[i].num_symbols += ranges[r].buckets[i].count;
+	total += sections[i].num_symbols;
+    }
+
+    *symbol_list = NULL;
+    if (! error && total && ! (*symbol_list = malloc(total * sizeof(nvm_symbol)))) error = -3;
+    if (! error && total && raw_fields && ! (raw = calloc(total, sizeof(nvm_field)))) {
+	error = -3;
+    }
+
+    current = *symbol_list;
+    for (i = 0; i < num_sections; ++i) {
+	for (r = 0; r < num_ranges; ++r) {
+	    bucket = &ranges[r].buckets[i];
+	    if (error) symbol_list_free(bucket->list, bucket->count);
+	    else if (bucket->count) {
+		memcpy(current, bucket->list, bucket->count * sizeof(nvm_symbol));
+		for (n = 0; raw && n < bucket->count; ++n, ++current, ++raw) {
+		    raw->expected_size = current->size;
+		    raw->symbol = bucket->names[n];
+		    current->field = raw;
+		}
+		if (! raw) current += bucket->count;
+	    }
+	    free(bucket->list);
+	    free(bucket->names);
+	}
+    }
+    if (error) {
+	free(*symbol_list);
+	*symbol_list = NULL;
+    }
+    if (raw_fields) *raw_fields = error || ! total ? NULL : raw - total;
+    return error ? error : total;
 }
 
 
 
-///@brief Parse ELF symbol table and extract information about data section
+///@brief Parse ELF symbol table and extract information about data sections
+///@details All symbols are sorted into the requested sections during a single
+///         pass over the symbol table, which may be split up among several
+///         threads.  The resulting list holds each section's symbols
+///         contiguously, in the order of requested sections.  With lazy
+///         resolution, only placeholder fields are recorded.
 ///@return
 /// - Number of symbols parsed successfully
 /// - Zero if no symbols were found
@@ -149,94 +594,162 @@ parse_elf_symbols(
     Elf *elf,			///< [in] Elf object handle
     Elf_Scn *symtab,		///< [in] Section handle for the symbol table
     const size_t strings_index,	///< [in] Number of the string table section
-    Elf_Scn *section,		///< [in] Section handle for the requested data section
-    const GElf_Shdr *header,	///< [in] Section header of the requested data section
+    Elf_Scn *scn_found[],	///< [in] Section handles for the requested data sections
+    const GElf_Shdr headers[],	///< [in] Section headers of the requested data sections
+    map_section sections[],	///< [in,out] Examined sections with allocated blob memory
+    const int num_sections,	///< [in] Number of data sections
     const int save_values,	///< [in] Need a separate copy of the original content value?
     nvm_symbol **symbol_list,	///< [out] List of discovered symbols
-    char *blob_data)		///< [out] Binary data contained in ELF section
+    nvm_field **raw_fields)	///< [out] Placeholder fields, NULL to resolve eagerly
 {
-    int symbol_count = 0, sym_index, syms_total, list_size;
-    Elf_Data *symtab_data, *section_data;
-    GElf_Sym sym;
-    nvm_symbol *current;
-    void *copy = NULL;
-    const char *name;
+    size_t indices[num_sections];
+    scan_context context = {
+	.indices	= indices,
+	.headers	= headers,
+	.sections	= sections,
+	.num_sections	= num_sections,
+	.save_values	= save_values,
+	.lazy		= raw_fields != NULL,
+    };
+    int syms_total, num_ranges, i, ret;
+    Elf_Data *section_data;
+    scan_range *ranges;
+    scan_bucket *buckets;
 
-    // Require both output arguments
-    if (! symbol_list || ! blob_data) return -1;
+    // Require output argument
+    if (! symbol_list) return -1;
+    *symbol_list = NULL;
 
-    // Get the symbol table and section data
-    if (! (symtab_data = elf_getdata(symtab, NULL))) return -2;
-    if (! (section_data = elf_rawdata(section, NULL))) return -2;
-    if (! section_data->d_buf) return -2;
-    // Initialize blob with default data from section content
-    memcpy(blob_data, section_data->d_buf, section_data->d_size);
+    // Get the symbol table, string table and section data
+    if (! (context.symtab_data = elf_getdata(symtab, NULL))) return -2;
+    if (! (context.strings_data = elf_getdata(elf_getscn(elf, strings_index), NULL))) return -2;
+    if (! context.strings_data->d_buf || context.strings_data->d_size == 0
+	|| ((const char*) context.strings_data->d_buf)[context.strings_data->d_size - 1]) {
+	return -2;
+    }
+    for (i = 0; i < num_sections; ++i) {
+	if (! (section_data = elf_rawdata(scn_found[i], NULL))) return -2;
+	if (! section_data->d_buf) return -2;
+	// Initialize blob with default data from section content, unless used in place
+	if (sections[i].blob != section_data->d_buf) {
+	    memcpy(sections[i].blob, section_data->d_buf, section_data->d_size);
+	}
+	indices[i] = elf_ndxscn(scn_found[i]);
+    }
 
     // Calculate the number of entries in the symbol table
-    syms_total = symtab_data->d_size / gelf_fsize(elf, ELF_T_SYM, 1, EV_CURRENT);
-    if (! syms_total) {
-	*symbol_list = NULL;
-	return symbol_count;
-    }
+    syms_total = context.symtab_data->d_size / gelf_fsize(elf, ELF_T_SYM, 1, EV_CURRENT);
 
-    // Pre-allocate symbol list with number of expected entries
-    list_size = known_fields_expected();
-    if (! (*symbol_list = calloc(list_size, sizeof(nvm_symbol)))) return -3;
-    current = symbol_list[0];
+    // Split up the symbol table only if each thread has enough work
+    num_ranges = syms_total / MIN_THREAD_SYMBOLS;
+    if (num_ranges > scan_threads) num_ranges = scan_threads;
+    if (num_ranges < 1) num_ranges = 1;
 
-    for (sym_index = 0; sym_index < syms_total; ++sym_index) {
-	if (! gelf_getsym(symtab_data, sym_index, &sym) ||	//no symbol found
-	    sym.st_shndx != elf_ndxscn(section) ||		//symbol in wrong section
-	    sym.st_size == 0) continue;				//empty symbol
-	if (symbol_count >= list_size) {	//list is full
-	    if (DEBUG) printf("%s: count %d size %d %p\n", __func__,
-			      symbol_count, list_size, *symbol_list);
-	    if (! symbol_list_append(symbol_list, &list_size)) {
-		// Negate count found thus far to indicate error
-		symbol_count = -symbol_count;
-		break;
-	    }
-	}
-	current = (*symbol_list) + symbol_count++;
-	current->offset = sym.st_value - header->sh_addr;
-	current->size = sym.st_size;
-	current->blob_address = blob_data + current->offset;
-	if (! save_values) current->original_value = NULL;
-	else {
-	    copy = malloc(sym.st_size);
-	    if (copy) current->original_value = memcpy(
-		copy, current->blob_address, sym.st_size);
-	}
-	name = elf_strptr(elf, strings_index, sym.st_name);
-	current->field = find_known_field(name);
-	// Look up field in case it was found during previous parsing
-	if (! current->field) current->field = field_list_find(name, &fields_unknown);
-	if (! current->field) {		//unknown symbol encountered
-	    current->field = field_list_add(&fields_unknown, sym.st_size, name, NULL);
-	}
-	// Update symbol size based on content where applicable
-	if (current->field && current->field->expected_size != current->size
-	    && current->field->resize_func) {
-	    current->size = current->field->resize_func(current->blob_address, current->size);
-	    // Limit to blob boundary
-	    if (current->size > section_data->d_size - current->offset)
-		current->size = section_data->d_size - current->offset;
+    ranges = calloc(num_ranges, sizeof(*ranges));
+    buckets = calloc(num_ranges * num_sections, sizeof(*buckets));
+    if (! ranges || ! buckets) {
+	free(ranges);
+	free(buckets);
+	return -3;
+    }
+    for (i = 0; i < num_ranges; ++i) {
+	ranges[i].context = &context;
+	ranges[i].begin = (long long) syms_total * i / num_ranges;
+	ranges[i].end = (long long) syms_total * (i + 1) / num_ranges;
+	ranges[i].buckets = buckets + i * num_sections;
+    }
+    if (DEBUG) printf("%s: %d symbols in %d partitions\n", __func__, syms_total, num_ranges);
+
+    // Pre-allocate the first list with number of expected entries
+    if (num_ranges == 1 && ! context.lazy && (buckets[0].size = known_fields_expected()) > 0) {
+	if (! (buckets[0].list = calloc(buckets[0].size, sizeof(nvm_symbol)))) {
+	    buckets[0].size = 0;
 	}
     }
 
-    // Release excess memory when fewer symbols than expected are found
-    if (symbol_count < list_size) {
-	if (DEBUG) printf("%s: count %d < size %d %p\n", __func__,
-			  symbol_count, list_size, *symbol_list);
-	// Clamp to zero in case of error indication (negative symbol_count)
-	if (! symbol_list_truncate(symbol_list, symbol_count < 0 ? 0 : symbol_count)) {
-	    if (DEBUG) printf("%s: truncation failed, freeing %p\n", __func__, *symbol_list);
-	    // Shrinking should not fail, but clean up just in case
-	    symbol_list_free(*symbol_list, list_size);
+    scan_partitions(ranges, num_ranges);
+    ret = join_buckets(sections, num_sections, ranges, num_ranges, symbol_list, raw_fields);
+
+    free(buckets);
+    free(ranges);
+    return ret;
+}
+
+
+
+///@brief Extract symbols and binary data from a compiled layout
+///@details The binary data is used in place, modifications only affect the
+///         private memory mapping.  All examined sections must be contained
+///         in the layout.
+///@return
+/// - Number of symbols parsed successfully
+/// - Zero if no symbols were found
+/// - Negative value on error
+static int
+parse_layout_symbols(
+    nvm_symbol_map_source *source,	///< [in,out] Handle of the map source
+    const layout_file_header *layout,	///< [in] Validated layout within the mapping
+    const int save_values,		///< [in] Need a separate copy of the original content value?
+    nvm_symbol **symbol_list)		///< [out] List of discovered symbols
+{
+    const layout_file_section *layout_section;
+    const layout_file_symbol *record;
+    map_section *section;
+    nvm_symbol *current;
+    nvm_field *raw = NULL;
+    int symbol_count = 0;
+
+    // Require output argument
+    if (! symbol_list) return -1;
+    *symbol_list = NULL;
+
+    for (section = source->sections;
+	 section < source->sections + source->num_sections; ++section) {
+	layout_section = layout_file_find_section(layout, section->name);
+	if (! layout_section) return -2;
+	section->blob = source->map_address + layout_section->blob_offset;
+	section->blob_size = layout_section->blob_size;
+	section->load_address = layout_section->load_address;
+	section->blob_mapped = 1;
+	section->first_symbol = symbol_count;
+	section->num_symbols = layout_section->num_symbols;
+	symbol_count += section->num_symbols;
+    }
+
+    if (! symbol_count) return symbol_count;
+    if (! (*symbol_list = calloc(symbol_count, sizeof(nvm_symbol)))) return -3;
+    if (lazy_resolution && ! save_values) {
+	if (! (raw = calloc(symbol_count, sizeof(nvm_field)))) {
 	    free(*symbol_list);
 	    *symbol_list = NULL;
 	    return -3;
 	}
+	// Symbol sizes are already adjusted when compiling the layout
+	source->raw_fields = raw;
+	source->num_raw_fields = symbol_count;
+	source->raw_sizes = 0;
+    }
+
+    current = *symbol_list;
+    for (section = source->sections;
+	 section < source->sections + source->num_sections; ++section) {
+	record = layout_file_symbols(layout)
+	    + layout_file_find_section(layout, section->name)->first_symbol;
+	for (; current < *symbol_list + section->first_symbol + section->num_symbols;
+	     ++current, ++record) {
+	    current->offset = record->offset;
+	    current->size = record->size;
+	    current->blob_address = section->blob + current->offset;
+	    if (raw) {
+		raw->expected_size = record->expected_size;
+		raw->symbol = layout_file_string(layout, record->name);
+		current->field = raw++;
+		continue;
+	    }
+	    if (save_values) save_original_value(current);
+	    current->field = bind_field(layout_file_string(layout, record->name),
+					record->expected_size);
+	}
     }
 
     return symbol_count;
@@ -244,111 +757,1153 @@ parse_elf_symbols(
 
 
 
-nvm_symbol_map_source*
-symbol_map_open_file(const char *filename)
+///@brief Map the whole file into memory
+///@details Only the pages actually accessed are ever read from disk.  For an
+///         ELF file, that means the ELF and section headers, the symbol and
+///         string tables and the requested data section.  Other contents such
+///         as debugging information do not contribute to the processing cost.
+///@return Address of the mapped contents or NULL on error
+static char*
+map_file(
+    nvm_symbol_map_source *source,	///< [in,out] Handle of the map source
+    int fd)				///< [in] File descriptor to map
 {
-    nvm_symbol_map_source *source;
-    const char *errmsg = "";
+#if HAVE_MMAP
+    struct stat st;
+    void *mapped;
 
-    if (! filename) return NULL;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) return NULL;
 
-    source = malloc(sizeof(*source));
-    if (source) {
-	source->fd = open(filename, O_RDONLY | O_BINARY);
-	source->elf = NULL;
-	source->blob = NULL;
-	source->blob_size = 0;
+    // Private writable mapping, as libelf may convert data in place
+    mapped = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) {
+	if (DEBUG) printf("%s: mmap() failed (%s)\n", __func__, strerror(errno));
+	return NULL;
+    }
+    source->map_address = mapped;
+    source->map_size = st.st_size;
+#else // !HAVE_MMAP
+    (void) fd;
+#endif
+    return source->map_address;
+}
 
-	if (source->fd != -1) {
-	    elf_version(EV_CURRENT);
-	    source->elf = elf_begin(source->fd, ELF_C_READ, NULL);
-	    if (source->elf) {
-		if (elf_kind(source->elf) == ELF_K_ELF) {
-		    // Skip any clean-up code below if successful
-		    return source;
-		} else errmsg = _("Not an ELF object");	//wrong object kind
-		elf_end(source->elf);
-	    } else errmsg = elf_errmsg(-1);		//ELF object not opened
-	    close(source->fd);
-	} else errmsg = strerror(errno);		//file not opened
-	free(source);
-    } else errmsg = strerror(errno);			//malloc() failed
-    // All cleaned up after error
 
-    fprintf(stderr, _("Cannot open symbol map \"%s\" (%s)\n"), filename, errmsg);
+
+///@brief Prepare libelf access to the opened ELF file, unless already done
+///@return NULL on success or error message
+static const char*
+begin_elf_file(
+    nvm_symbol_map_source *source)	///< [in,out] Handle of the map source
+{
+    if (source->elf) return NULL;
+
+    elf_version(EV_CURRENT);
+    if (source->map_address) source->elf = elf_memory(source->map_address, source->map_size);
+    else source->elf = elf_begin(source->fd, ELF_C_READ, NULL);
+
+    if (! source->elf) return elf_errmsg(-1);		//ELF object not opened
+    if (elf_kind(source->elf) != ELF_K_ELF) return _("Not an ELF object");
     return NULL;
 }
 
 
 
-int
-symbol_map_parse(nvm_symbol_map_source *source,
-		 const char *section_name,
-		 nvm_symbol **symbol_list,
-		 int save_values)
+///@brief Release libelf resources and any memory mapping
+static void
+end_map_file(
+    nvm_symbol_map_source *source)	///< [in,out] Handle of the map source
 {
-    size_t string_index = 0;
-    Elf_Scn *symtab, *section;
-    GElf_Shdr header = { 0 };
-    int symbol_count;
+    if (source->elf) elf_end(source->elf);
+    source->elf = NULL;
+#if HAVE_MMAP
+    if (source->map_address) munmap(source->map_address, source->map_size);
+#endif
+    source->map_address = NULL;
+    source->map_size = 0;
+}
+
 
-    if (! source) return -1;
 
-    find_symtab_and_section(source->elf, &symtab, &string_index,
-			    section_name, &section, &header);
-    if (! section || ! symtab) return -2;
+///@brief Read the numbers locating the section header table, without libelf
+///@return Size of each section header table entry or zero on error
+static size_t
+read_section_table(
+    const char *image,		///< [in] Memory mapped ELF file contents
+    size_t size,		///< [in] Size of the file contents
+    uint64_t *offset,		///< [out] File offset of the section header table
+    size_t *count)		///< [out] Number of section header table entries
+{
+    Elf32_Ehdr ehdr32;
+    Elf64_Ehdr ehdr64;
+    size_t entry_size;
 
-    if (! allocate_blob(source, &header)) return -3;
+    switch (image[EI_CLASS]) {
+    case ELFCLASS32:
+	if (size < sizeof(ehdr32)) return 0;
+	memcpy(&ehdr32, image, sizeof(ehdr32));
+	*offset = ehdr32.e_shoff;
+	*count = ehdr32.e_shnum;
+	entry_size = ehdr32.e_shentsize;
+	if (entry_size < sizeof(Elf32_Shdr)) return 0;
+	break;
 
-    symbol_count = parse_elf_symbols(source->elf, symtab, string_index,
-				     section, &header, save_values,
-				     symbol_list, source->blob);
+    case ELFCLASS64:
+	if (size < sizeof(ehdr64)) return 0;
+	memcpy(&ehdr64, image, sizeof(ehdr64));
+	*offset = ehdr64.e_shoff;
+	*count = ehdr64.e_shnum;
+	entry_size = ehdr64.e_shentsize;
+	if (entry_size < sizeof(Elf64_Shdr)) return 0;
+	break;
 
-    if (symbol_count == 0) fprintf(stderr, _("No symbols found in ELF map section `%s'\n"),
-				   section_name);
-    if (symbol_count < 0) fprintf(stderr, _("Error reading symbols from ELF map section `%s'"
-					    " (code %d)\n"),
-				  section_name, symbol_count);
-    return symbol_count;
+    default:
+	return 0;
+    }
+
+    // Section header table must lie completely within the file
+    if (*offset > size || *count > (size - *offset) / entry_size) return 0;
+    return entry_size;
 }
 
 
 
-char*
-symbol_map_blob_address(const nvm_symbol_map_source *source)
+/// Read a section header of either ELF class into the generic representation
+static inline void
+read_section_header(const char *raw, const char elf_class, GElf_Shdr *shdr)
 {
-    if (! source) return NULL;
-    return source->blob;
+    Elf32_Shdr shdr32;
+
+    if (elf_class == ELFCLASS64) memcpy(shdr, raw, sizeof(*shdr));
+    else {
+	memcpy(&shdr32, raw, sizeof(shdr32));
+	shdr->sh_type = shdr32.sh_type;
+	shdr->sh_offset = shdr32.sh_offset;
+	shdr->sh_size = shdr32.sh_size;
+	shdr->sh_addralign = shdr32.sh_addralign;
+    }
 }
 
 
 
-size_t
-symbol_map_blob_size(const nvm_symbol_map_source *source)
+///@brief Find the GNU build ID note in a memory mapped ELF file, without libelf
+///@details Only files in the host's native byte order are examined.
+///@return Number of hex digits written or zero if none found
+static size_t
+find_build_id(
+    const char *image,		///< [in] Memory mapped ELF file contents
+    size_t size,		///< [in] Size of the file contents
+    char *hex,			///< [out] Buffer for the build ID in hex notation
+    size_t hex_size)		///< [in] Size of the output buffer, including NUL
 {
-    if (! source) return 0;
-    return source->blob_size;
+    static const char digits[] = "0123456789abcdef";
+    static const char owner[] = ELF_NOTE_GNU;
+    const uint16_t probe = 1;
+    GElf_Shdr shdr = { 0 };
+    Elf32_Nhdr nhdr;
+    uint64_t table, offset, end, align, desc;
+    size_t index, count, entry_size, i;
+    unsigned char byte;
+
+    if (! image || size < EI_NIDENT || memcmp(image, ELFMAG, SELFMAG) != 0) return 0;
+    // Check for host byte order
+    if (image[EI_DATA] != (*(const char*) &probe ? ELFDATA2LSB : ELFDATA2MSB)) return 0;
+    if (! (entry_size = read_section_table(image, size, &table, &count))) return 0;
+
+    for (index = 0; index < count; ++index) {
+	read_section_header(image + table + index * entry_size, image[EI_CLASS], &shdr);
+	if (shdr.sh_type != SHT_NOTE
+	    || shdr.sh_offset > size || shdr.sh_size > size - shdr.sh_offset) continue;
+	align = shdr.sh_addralign == 8 ? 8 : 4;
+
+	// Walk through all notes in the section
+	end = shdr.sh_offset + shdr.sh_size;
+	for (offset = shdr.sh_offset; offset + sizeof(nhdr) <= end; ) {
+	    memcpy(&nhdr, image + offset, sizeof(nhdr));
+	    offset += sizeof(nhdr);
+	    desc = offset + ((nhdr.n_namesz + align - 1) & ~(align - 1));
+	    if (desc > end || nhdr.n_descsz > end - desc) break;
+
+	    if (nhdr.n_type == NT_GNU_BUILD_ID && nhdr.n_namesz == sizeof(owner)
+		&& memcmp(image + offset, owner, sizeof(owner)) == 0
+		&& nhdr.n_descsz > 0 && nhdr.n_descsz * 2 < hex_size) {
+		for (i = 0; i < nhdr.n_descsz; ++i) {
+		    byte = image[desc + i];
+		    hex[2 * i + 0] = digits[(byte >> 4) & 0x0F];
+		    hex[2 * i + 1] = digits[(byte >> 0) & 0x0F];
+		}
+		hex[2 * i] = '\0';
+		return 2 * i;
+	    }
+	    offset = desc + ((nhdr.n_descsz + align - 1) & ~(align - 1));
+	}
+    }
+    return 0;
 }
 
 
 
-void
-symbol_map_print_size(const nvm_symbol_map_source *source,
-		      int parseable)
+///@brief Determine the kind of map file and prepare it for parsing
+///@return NULL on success or error message
+static const char*
+prepare_map_file(
+    nvm_symbol_map_source *source,	///< [in,out] Handle of the map source
+    int use_mmap)			///< [in] Try memory mapped access first?
+{
+    if (use_mmap && map_file(source, source->fd)) {
+	// Compiled layouts need no libelf access at all
+	if (layout_file_identify(source->map_address, source->map_size)) return NULL;
+	// Defer libelf access until parsing, a cached layout might make it unnecessary
+	if (source->map_size >= SELFMAG
+	    && memcmp(source->map_address, ELFMAG, SELFMAG) == 0) {
+	    // Keep the build ID, the contents may be replaced by a cached layout
+	    find_build_id(source->map_address, source->map_size,
+			  source->build_id, sizeof(source->build_id));
+	    return NULL;
+	}
+	return _("Not an ELF object");
+    }
+
+    // Fall back to reading through libelf
+    return begin_elf_file(source);
+}
+
+
+
+///@brief Compose the cache file name for a layout compiled from the source
+///@details The name consists of the build ID and all examined section names,
+///         so each combination of sections is cached separately.
+///@return Allocated file name (must be free()d) or NULL if caching is not possible
+static char*
+layout_cache_name(
+    const nvm_symbol_map_source *source)	///< [in] Handle of the map source
 {
-    printf(parseable ? "total: %zu bytes\n" : _("Section image size: %zu bytes\n"),
-	   symbol_map_blob_size(source));
+    char *name, *end;
+    const char *section_name;
+    size_t length;
+    int i;
+
+    if (! layout_cache_directory || ! source->num_sections || ! *source->build_id) return NULL;
+
+    length = strlen(layout_cache_directory) + strlen(source->build_id) + sizeof("/-.layout");
+    for (i = 0; i < source->num_sections; ++i) {
+	length += strlen(source->sections[i].name) + 1;
+    }
+    name = malloc(length);
+    if (! name) return NULL;
+
+    end = name + sprintf(name, "%s/%s", layout_cache_directory, source->build_id);
+    for (i = 0; i < source->num_sections; ++i) {
+	section_name = source->sections[i].name;
+	// Section names usually start with a dot, skip it in the file name
+	if (*section_name == '.') ++section_name;
+	end += sprintf(end, "%c%s", i ? '+' : '-', section_name);
+    }
+    strcpy(end, ".layout");
+    return name;
 }
 
 
 
-void
-symbol_map_close(nvm_symbol_map_source *source)
+///@brief Check that a compiled layout contains all examined sections
+///@return NULL if usable or error message
+static const char*
+check_layout_sections(
+    const nvm_symbol_map_source *source,	///< [in] Handle of the map source
+    const layout_file_header *layout,		///< [in] Validated layout file header
+    const char **missing)			///< [out] Name of the first missing section
 {
-    if (source) {
-	free(source->blob);
-	if (source->elf) elf_end(source->elf);
-	if (source->fd >= 0) close(source->fd);
+    int i;
+
+    for (i = 0; i < source->num_sections; ++i) {
+	if (! layout_file_find_section(layout, source->sections[i].name)) {
+	    *missing = source->sections[i].name;
+	    return _("Section not contained in layout");
+	}
     }
-    free(source);
+    return NULL;
+}
+
+
+
+///@brief Replace the mapped ELF file contents with a cached compiled layout
+///@return Validated layout or NULL if no usable one is cached
+static const layout_file_header*
+load_cached_layout(
+    nvm_symbol_map_source *source,	///< [in,out] Handle of the map source
+    const char *cache_name)		///< [in] File name of the cached layout
+{
+    nvm_symbol_map_source cached = { .fd = -1 };
+    const layout_file_header *layout;
+    const char *errmsg, *missing;
+
+    cached.fd = open(cache_name, O_RDONLY | O_BINARY);
+    if (cached.fd == -1) return NULL;	//not cached yet
+    map_file(&cached, cached.fd);
+    close(cached.fd);
+
+    layout = layout_file_check(cached.map_address, cached.map_size, &errmsg);
+    if (layout) errmsg = check_layout_sections(source, layout, &missing);
+    if (errmsg) {
+	if (DEBUG) printf("%s: ignoring \"%s\" (%s)\n", __func__, cache_name, errmsg);
+	end_map_file(&cached);
+	return NULL;
+    }
+
+    // ELF file contents are not needed anymore
+    end_map_file(source);
+    source->map_address = cached.map_address;
+    source->map_size = cached.map_size;
+    return layout;
 }
+
+
+
+///@brief Determine the address where a section's data is loaded on the target
+///@details The physical address within the containing loadable segment is
+///         used, which differs from the section address for initialized data
+///         copied from flash memory.  Without program headers, as in
+///         relocatable object files, the section address is used.
+///@return Load address of the section's data
+static size_t
+section_load_address(
+    Elf *elf,			///< [in] Handle of the ELF file
+    const GElf_Shdr *header)	///< [in] Section header of the data section
+{
+    GElf_Phdr phdr;
+    size_t count = 0, i;
+
+    if (header->sh_type != SHT_NOBITS && elf_getphdrnum(elf, &count) == 0) {
+	for (i = 0; i < count; ++i) {
+	    if (gelf_getphdr(elf, i, &phdr) && phdr.p_type == PT_LOAD
+		&& header->sh_offset >= phdr.p_offset
+		&& header->sh_offset - phdr.p_offset < phdr.p_filesz) {
+		return phdr.p_paddr + (header->sh_offset - phdr.p_offset);
+	    }
+	}
+    }
+    return header->sh_addr;
+}
+
+
+
+///@brief Extract symbols and binary data from the ELF file
+///@return @see parse_elf_symbols()
+static int
+parse_elf_file(
+    nvm_symbol_map_source *source,	///< [in,out] Handle of the map source
+    const int save_values,		///< [in] Need a separate copy of the original content value?
+    nvm_symbol **symbol_list)		///< [out] List of discovered symbols
+{
+    size_t string_index = 0;
+    Elf_Scn *symtab, *scn_found[source->num_sections];
+    GElf_Shdr headers[source->num_sections];
+    const char *errmsg;
+    int i, lazy, ret;
+
+    errmsg = begin_elf_file(source);
+    if (errmsg) {
+	fprintf(stderr, _("Cannot access ELF map (%s)\n"), errmsg);
+	return -2;
+    }
+
+    if (find_symtab_and_sections(source->elf, &symtab, &string_index,
+				 source->sections, source->num_sections,
+				 scn_found, headers) > 0 || ! symtab) return -2;
+
+    for (i = 0; i < source->num_sections; ++i) {
+	if (! allocate_blob(source, &source->sections[i], &headers[i])) return -3;
+	source->sections[i].load_address = section_load_address(source->elf, &headers[i]);
+    }
+
+    lazy = lazy_resolution && ! save_values;
+    ret = parse_elf_symbols(source->elf, symtab, string_index, scn_found, headers,
+			    source->sections, source->num_sections, save_values,
+			    symbol_list, lazy ? &source->raw_fields : NULL);
+    if (lazy && ret > 0) {
+	source->num_raw_fields = ret;
+	source->raw_sizes = 1;
+    }
+    return ret;
+}
+
+
+
+/// Release the binary data of all sections examined by a previous parsing
+static void
+release_sections(nvm_symbol_map_source *source)
+{
+    int i;
+
+    for (i = 0; i < source->num_sections; ++i) {
+	if (! source->sections[i].blob_mapped) free(source->sections[i].blob);
+    }
+    free(source->sections);
+    source->sections = NULL;
+    source->num_sections = 0;
+    symbol_list_free_index(source->index);
+    source->index = NULL;
+    free(source->raw_fields);
+    source->raw_fields = NULL;
+    source->num_raw_fields = 0;
+    source->stale_index = 0;
+}
+
+
+
+///@brief Open the given file as symbol map, optionally memory mapped
+///@return Handle of this source for further processing
+static nvm_symbol_map_source*
+open_map_file(
+    const char *filename,	///< [in] File path to open
+    int use_mmap)		///< [in] Try memory mapped access first?
+{
+    nvm_symbol_map_source *source;
+    const char *errmsg = "";
+
+    if (! filename) return NULL;
+
+    source = malloc(sizeof(*source));
+    if (source) {
+	source->fd = open(filename, O_RDONLY | O_BINARY);
+	source->elf = NULL;
+	source->map_address = NULL;
+	source->map_size = 0;
+	source->build_id[0] = '\0';
+	source->sections = NULL;
+	source->num_sections = 0;
+	source->index = NULL;
+	source->raw_fields = NULL;
+	source->num_raw_fields = 0;
+	source->stale_index = 0;
+
+	if (source->fd != -1) {
+	    errmsg = prepare_map_file(source, use_mmap);
+	    // Skip any clean-up code below if successful
+	    if (! errmsg) return source;
+	    end_map_file(source);
+	    close(source->fd);
+	} else errmsg = strerror(errno);		//file not opened
+	free(source);
+    } else errmsg = strerror(errno);			//malloc() failed
+    // All cleaned up after error
+
+    fprintf(stderr, _("Cannot open symbol map \"%s\" (%s)\n"), filename, errmsg);
+    return NULL;
+}
+
+
+
+nvm_symbol_map_source*
+symbol_map_open_file(const char *filename)
+{
+    return open_map_file(filename, HAVE_MMAP);
+}
+
+
+
+void
+symbol_map_layout_cache(const char *directory)
+{
+    layout_cache_directory = directory;
+}
+
+
+
+void
+symbol_map_scan_threads(int threads)
+{
+    scan_threads = HAVE_PTHREADS && threads > 1 ? threads : 1;
+}
+
+
+
+void
+symbol_map_lazy_resolution(int enable)
+{
+    lazy_resolution = enable;
+}
+
+
+
+///@brief Write a compiled layout describing all examined sections
+///@return Zero on success or negative error code
+static int
+emit_layout(
+    const nvm_symbol_map_source *source,	///< [in] Handle of the parsed map source
+    const nvm_symbol *symbol_list,		///< [in] Combined list of parsed symbols
+    const char *filename)			///< [in] Output file path
+{
+    layout_file_contents contents[source->num_sections];
+    int i;
+
+    for (i = 0; i < source->num_sections; ++i) {
+	contents[i].section_name = source->sections[i].name;
+	contents[i].blob = source->sections[i].blob;
+	contents[i].blob_size = source->sections[i].blob_size;
+	contents[i].load_address = source->sections[i].load_address;
+	contents[i].list = symbol_list + source->sections[i].first_symbol;
+	contents[i].num_symbols = source->sections[i].num_symbols;
+    }
+    return layout_file_write(filename, contents, source->num_sections);
+}
+
+
+
+int
+symbol_map_parse(nvm_symbol_map_source *source,
+		 const char *const section_names[], int num_sections,
+		 nvm_symbol **symbol_list,
+		 int save_values)
+{
+    const layout_file_header *layout = NULL;
+    const char *errmsg = NULL, *missing = NULL;
+    char *cache_name = NULL;
+    int symbol_count, i;
+
+    if (! source || ! section_names || num_sections <= 0) return -1;
+
+    release_sections(source);
+    source->sections = calloc(num_sections, sizeof(*source->sections));
+    if (! source->sections) return -3;
+    source->num_sections = num_sections;
+    for (i = 0; i < num_sections; ++i) source->sections[i].name = section_names[i];
+
+    if (layout_file_identify(source->map_address, source->map_size)) {
+	// Compiled layout file given directly
+	layout = layout_file_check(source->map_address, source->map_size, &errmsg);
+	if (layout) errmsg = check_layout_sections(source, layout, &missing);
+	if (errmsg) {
+	    fprintf(stderr, _("Cannot use layout file for section `%s' (%s)\n"),
+		    missing ? missing : section_names[0], errmsg);
+	    return -2;
+	}
+    } else {
+	cache_name = layout_cache_name(source);
+	if (cache_name) layout = load_cached_layout(source, cache_name);
+    }
+
+    if (layout) symbol_count = parse_layout_symbols(source, layout, save_values, symbol_list);
+    else {
+	symbol_count = parse_elf_file(source, save_values, symbol_list);
+	// Blobs still hold the sections' default data for compiling the layout
+	if (cache_name && symbol_count >= 0) {
+	    symbol_map_resolve(source, *symbol_list, symbol_count);
+	    emit_layout(source, *symbol_list, cache_name);
+	}
+    }
+    free(cache_name);
+
+    // Speed up finding symbols by field or name, a failure only costs time
+    if (symbol_count > 0) source->index = symbol_list_index(*symbol_list, symbol_count);
+    if (symbol_count >= 0 && ! source->raw_fields) {
+	fingerprint_sections(source, *symbol_list, symbol_count);
+    }
+
+    for (i = 0; i < num_sections; ++i) {
+	if (symbol_count >= 0 && source->sections[i].num_symbols == 0) fprintf(
+	    stderr, _("No symbols found in ELF map section `%s'\n"), section_names[i]);
+	if (symbol_count < 0) fprintf(stderr, _("Error reading symbols from ELF map section `%s'"
+						" (code %d)\n"),
+				      section_names[i], symbol_count);
+    }
+    return symbol_count;
+}
+
+
+
+///@brief Bind a lazily parsed symbol to its field descriptor
+///@return One if resolved, zero if it was already
+static int
+resolve_symbol(
+    const nvm_symbol_map_source *source,	///< [in] Handle of the parsed map source
+    const map_section *section,		///< [in] Section containing the symbol
+    nvm_symbol *symbol)			///< [in,out] Symbol to resolve
+{
+    const nvm_field *raw = symbol->field;
+
+    // Skip symbols already resolved
+    if (raw < source->raw_fields
+	|| raw >= source->raw_fields + source->num_raw_fields) return 0;
+    symbol->field = bind_field(raw->symbol, raw->expected_size);
+    if (source->raw_sizes) adjust_size(symbol, section->blob_size);
+    return 1;
+}
+
+
+
+int
+symbol_map_resolve(nvm_symbol_map_source *source,
+		   nvm_symbol *symbol_list, int num_symbols)
+{
+    const map_section *section;
+    nvm_symbol *symbol;
+    int resolved = 0;
+
+    if (! source || num_symbols < 0 || (num_symbols && ! symbol_list)) return -1;
+    if (! source->raw_fields) return resolved;	//parsed eagerly
+
+    for (section = source->sections;
+	 section < source->sections + source->num_sections; ++section) {
+	for (symbol = symbol_list + section->first_symbol;
+	     symbol < symbol_list + section->first_symbol + section->num_symbols
+		 && symbol < symbol_list + num_symbols; ++symbol) {
+	    resolved += resolve_symbol(source, section, symbol);
+	}
+    }
+    if (DEBUG) printf("%s: resolved %d symbols\n", __func__, resolved);
+    // Any index still refers to the placeholder fields
+    if (resolved || source->stale_index) {
+	symbol_list_free_index(source->index);
+	source->index = symbol_list_index(symbol_list, num_symbols);
+	source->stale_index = 0;
+	fingerprint_sections(source, symbol_list, num_symbols);
+    }
+    return resolved;
+}
+
+
+
+int
+symbol_map_resolve_symbol(nvm_symbol_map_source *source,
+			  nvm_symbol *symbol_list, int num_symbols, const char *name)
+{
+    const map_section *section;
+    const nvm_symbol *found;
+    int count, resolved = 0;
+
+    if (! source || ! name || num_symbols < 0 || (num_symbols && ! symbol_list)) return -1;
+    if (! source->raw_fields) return resolved;	//parsed eagerly
+
+    // Lookups by name find the first match of each section
+    for (section = source->sections;
+	 section < source->sections + source->num_sections; ++section) {
+	if (section->first_symbol >= num_symbols) break;
+	count = section->num_symbols;
+	if (count > num_symbols - section->first_symbol) {
+	    count = num_symbols - section->first_symbol;
+	}
+	found = symbol_list_find_symbol(source->index, symbol_list + section->first_symbol,
+					count, name);
+	if (found) resolved += resolve_symbol(source, section,
+					      symbol_list + (found - symbol_list));
+    }
+    // Names are unchanged, but the index by field still refers to the placeholders
+    if (resolved) source->stale_index = 1;
+    if (DEBUG) printf("%s: resolved %d symbols named %s\n", __func__, resolved, name);
+    return resolved;
+}
+
+
+
+int
+symbol_map_write_layout(const nvm_symbol_map_source *source,
+			const nvm_symbol *symbol_list, int num_symbols,
+			const char *filename)
+{
+    if (! source || ! source->num_sections) return -1;
+    if (num_symbols != source->sections[source->num_sections - 1].first_symbol
+	+ source->sections[source->num_sections - 1].num_symbols) return -1;
+
+    return emit_layout(source, symbol_list, filename);
+}
+
+
+
+size_t
+symbol_map_build_id(const nvm_symbol_map_source *source, char *hex, size_t hex_size)
+{
+    size_t length;
+
+    if (! source || ! hex) return 0;
+    length = strlen(source->build_id);
+    if (! length || length >= hex_size) return 0;
+    memcpy(hex, source->build_id, length + 1);
+    return length;
+}
+
+
+
+uint64_t
+symbol_map_fingerprint(const nvm_symbol_map_source *source, int section)
+{
+    if (! source || section < 0 || section >= source->num_sections) return 0;
+    return source->sections[section].fingerprint;
+}
+
+
+
+int
+symbol_map_plain_copy(const nvm_symbol_map_source *source, int section)
+{
+    if (! source || section < 0 || section >= source->num_sections) return 0;
+    return source->sections[section].fingerprint && source->sections[section].plain_copy;
+}
+
+
+
+int
+symbol_map_sections(const nvm_symbol_map_source *source)
+{
+    if (! source) return 0;
+    return source->num_sections;
+}
+
+
+
+const char*
+symbol_map_section_name(const nvm_symbol_map_source *source, int section)
+{
+    if (! source || section < 0 || section >= source->num_sections) return NULL;
+    return source->sections[section].name;
+}
+
+
+
+int
+symbol_map_section_symbols(const nvm_symbol_map_source *source, int section, int *first)
+{
+    if (! source || section < 0 || section >= source->num_sections) return 0;
+    if (first) *first = source->sections[section].first_symbol;
+    return source->sections[section].num_symbols;
+}
+
+
+
+const symbol_index*
+symbol_map_index(const nvm_symbol_map_source *source)
+{
+    return source ? source->index : NULL;
+}
+
+
+
+char*
+symbol_map_blob_address(const nvm_symbol_map_source *source, int section)
+{
+    if (! source || section < 0 || section >= source->num_sections) return NULL;
+    return source->sections[section].blob;
+}
+
+
+
+size_t
+symbol_map_load_address(const nvm_symbol_map_source *source, int section)
+{
+    if (! source || section < 0 || section >= source->num_sections) return 0;
+    return source->sections[section].load_address;
+}
+
+
+
+size_t
+symbol_map_blob_size(const nvm_symbol_map_source *source, int section)
+{
+    if (! source || section < 0 || section >= source->num_sections) return 0;
+    return source->sections[section].blob_size;
+}
+
+
+
+void
+symbol_map_print_size(const nvm_symbol_map_source *source, int section,
+		      int parseable)
+{
+    if (symbol_map_sections(source) > 1) {
+	// Distinguish multiple sections by name
+	printf(parseable ? "%s total: %zu bytes\n" : _("Section %s image size: %zu bytes\n"),
+	       symbol_map_section_name(source, section), symbol_map_blob_size(source, section));
+    } else {
+	printf(parseable ? "total: %zu bytes\n" : _("Section image size: %zu bytes\n"),
+	       symbol_map_blob_size(source, section));
+    }
+}
+
+
+
+void
+symbol_map_close(nvm_symbol_map_source *source)
+{
+    if (source) {
+	release_sections(source);
+	end_map_file(source);
+	if (source->fd >= 0) close(source->fd);
+    }
+    free(source);
+}
+
+
+
+#ifdef TEST_SYMBOL_MAP
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+
+/// Open and parse the given map repeatedly with one access method
+static int
+benchmark_open_parse(const char *filename, const char *section_name,
+		     int use_mmap, int rounds)
+{
+    nvm_symbol_map_source *source;
+    nvm_symbol *list;
+    int i, num = -1;
+
+    for (i = 0; i < rounds; ++i) {
+	list = NULL;
+	source = open_map_file(filename, use_mmap);
+	num = symbol_map_parse(source, &section_name, 1, &list, 0);
+	if (num > 0) symbol_list_free(list, num);
+	free(list);
+	symbol_map_close(source);
+	if (num < 0) break;
+    }
+    return num;
+}
+
+
+
+/// Section layout of the synthetic ELF file, in file order after the header
+enum synthetic_section {
+    synNull, synData, synNote, synSymtab, synStrtab, synShstrtab, synJunk, synCount
+};
+
+
+
+/// Write a synthetic ELF file with a small symbol table and a large padding section
+static int
+write_synthetic_elf(const char *filename, const char *section_name,
+		    int num_symbols, size_t padding)
+{
+    static const unsigned char build_id[20] = { 0x5e, 0x1f, 0x3a, 0x9e };
+    static const char owner[] = ELF_NOTE_GNU;
+    const uint16_t probe = 1;
+    Elf64_Ehdr ehdr = { .e_ident = { ELFMAG0, ELFMAG1, ELFMAG2, ELFMAG3, ELFCLASS64 } };
+    Elf64_Shdr shdr[synCount] = { { 0 } };
+    Elf64_Nhdr nhdr = { sizeof(owner), sizeof(build_id), NT_GNU_BUILD_ID };
+    Elf64_Sym sym = { 0 };
+    char shstrtab[256], name[32];
+    size_t shstrtab_size = 1;
+    uint64_t offset;
+    int i, n;
+    FILE *out;
+
+    ehdr.e_ident[EI_DATA] = *(const char*) &probe ? ELFDATA2LSB : ELFDATA2MSB;
+    ehdr.e_ident[EI_VERSION] = EV_CURRENT;
+    ehdr.e_type = ET_EXEC;
+    ehdr.e_version = EV_CURRENT;
+    ehdr.e_ehsize = sizeof(ehdr);
+    ehdr.e_shentsize = sizeof(*shdr);
+    ehdr.e_shnum = synCount;
+    ehdr.e_shstrndx = synShstrtab;
+
+    // Section names go into the section header string table
+    shstrtab[0] = '\0';
+    for (i = synData; i < synCount; ++i) {
+	shdr[i].sh_name = shstrtab_size;
+	shstrtab_size += 1 + sprintf(shstrtab + shstrtab_size, "%s",
+				     i == synData ? section_name
+				     : i == synNote ? ".note.gnu.build-id"
+				     : i == synSymtab ? ".symtab"
+				     : i == synStrtab ? ".strtab"
+				     : i == synShstrtab ? ".shstrtab" : ".debug_junk");
+    }
+    shdr[synData].sh_type = SHT_PROGBITS;
+    shdr[synData].sh_size = 4 * num_symbols;
+    shdr[synNote].sh_type = SHT_NOTE;
+    shdr[synNote].sh_size = sizeof(nhdr) + sizeof(owner) + sizeof(build_id);
+    shdr[synNote].sh_addralign = 4;
+    shdr[synSymtab].sh_type = SHT_SYMTAB;
+    shdr[synSymtab].sh_size = (num_symbols + 1) * sizeof(sym);
+    shdr[synSymtab].sh_entsize = sizeof(sym);
+    shdr[synSymtab].sh_link = synStrtab;
+    shdr[synSymtab].sh_info = 1;
+    shdr[synSymtab].sh_addralign = 8;
+    shdr[synStrtab].sh_type = SHT_STRTAB;
+    for (n = 0; n < num_symbols; ++n) {
+	shdr[synStrtab].sh_size += sprintf(name, "nvm_synthetic_%d", n) + 1;
+    }
+    ++shdr[synStrtab].sh_size;
+    shdr[synShstrtab].sh_type = SHT_STRTAB;
+    shdr[synShstrtab].sh_size = shstrtab_size;
+    shdr[synJunk].sh_type = SHT_PROGBITS;
+    shdr[synJunk].sh_size = padding;
+    shdr[synJunk].sh_addralign = 4096;
+
+    // Arrange sections after the header, section headers at the very end
+    offset = sizeof(ehdr);
+    for (i = synData; i < synCount; ++i) {
+	if (shdr[i].sh_addralign > 1) {
+	    offset = (offset + shdr[i].sh_addralign - 1) & ~(shdr[i].sh_addralign - 1);
+	}
+	shdr[i].sh_offset = offset;
+	offset += shdr[i].sh_size;
+    }
+    ehdr.e_shoff = (offset + 7) & ~7;
+
+    out = fopen(filename, "wb");
+    if (! out) return -1;
+    fwrite(&ehdr, sizeof(ehdr), 1, out);
+    fseek(out, shdr[synData].sh_offset, SEEK_SET);
+    for (n = 0; n < num_symbols; ++n) fwrite(&n, 4, 1, out);
+    fseek(out, shdr[synNote].sh_offset, SEEK_SET);
+    fwrite(&nhdr, sizeof(nhdr), 1, out);
+    fwrite(owner, sizeof(owner), 1, out);
+    fwrite(build_id, sizeof(build_id), 1, out);
+    fseek(out, shdr[synSymtab].sh_offset, SEEK_SET);
+    fwrite(&sym, sizeof(sym), 1, out);
+    sym.st_info = ELF64_ST_INFO(STB_GLOBAL, STT_OBJECT);
+    sym.st_shndx = synData;
+    sym.st_size = 4;
+    for (sym.st_name = 1, n = 0; n < num_symbols; ++n) {
+	sym.st_value = 4 * n;
+	fwrite(&sym, sizeof(sym), 1, out);
+	sym.st_name += sprintf(name, "nvm_synthetic_%d", n) + 1;
+    }
+    fseek(out, shdr[synStrtab].sh_offset, SEEK_SET);
+    fputc('\0', out);
+    for (n = 0; n < num_symbols; ++n) fprintf(out, "nvm_synthetic_%d%c", n, '\0');
+    fseek(out, shdr[synShstrtab].sh_offset, SEEK_SET);
+    fwrite(shstrtab, shstrtab_size, 1, out);
+    // Padding stays a hole in the file, so it costs no disk space
+    fseek(out, ehdr.e_shoff, SEEK_SET);
+    fwrite(shdr, sizeof(shdr), 1, out);
+    return fclose(out);
+}
+
+
+
+/// Benchmark libelf reading against memory mapped access for a map file.
+///
+/// The difference shows best with a large ELF file, where most of the
+/// content is irrelevant for the examined section.  Without a file name,
+/// a synthetic one is generated with a thousand symbols and a padding
+/// section of the given size in MiB.
+int
+main(int argc, char **argv)
+{
+    static const char *method[] = { "libelf read", "mmap" };
+    static const char synthetic[] = "/tmp/symbol_map_test.elf";
+    const char *filename = argc > 1 && strcmp(argv[1], "-") ? argv[1] : synthetic;
+    const char *section_name = argc > 2 ? argv[2] : ".eeprom";
+    const int rounds = argc > 3 ? atoi(argv[3]) : 10;
+    struct timespec start, end;
+    struct rusage usage;
+    int use_mmap, status;
+    double elapsed;
+    pid_t pid;
+
+    if (rounds <= 0) {
+	fprintf(stderr, "Usage: %s [ELF-FILE|- [SECTION [ROUNDS [PADDING-MIB]]]]\n", argv[0]);
+	return 1;
+    }
+    if (filename == synthetic) {
+	if (write_synthetic_elf(synthetic, section_name, 1000,
+				(size_t) (argc > 4 ? atoi(argv[4]) : 512) << 20) != 0) return 2;
+    }
+
+    for (use_mmap = 0; use_mmap <= HAVE_MMAP; ++use_mmap) {
+	fflush(stdout);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	// Separate process for each method to measure memory usage independently
+	pid = fork();
+	if (pid == 0) exit(benchmark_open_parse(filename, section_name, use_mmap, rounds) < 0);
+	if (pid < 0 || wait4(pid, &status, 0, &usage) != pid) return 2;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	elapsed = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+	printf("%-12s %9.3f ms per round, max RSS %6ld kB, %6ld page faults%s\n",
+	       method[use_mmap], elapsed / rounds, usage.ru_maxrss,
+	       usage.ru_minflt + usage.ru_majflt,
+	       WIFEXITED(status) && WEXITSTATUS(status) == 0 ? "" : " (FAILED)");
+    }
+    if (filename == synthetic) remove(synthetic);
+    return 0;
+}
+#endif
+
+
+
+#ifdef TEST_LAZY_RESOLUTION
+#include "override.h"
+
+/// Parsed symbol list to resolve overridden fields in
+struct define_resolver {
+    nvm_symbol_map_source*	source;
+    nvm_symbol*			list;
+    int				num;
+};
+
+/// Resolve only the symbols named by an override, like the tool does
+static void
+resolve_define(const char *name, void *arg)
+{
+    const struct define_resolver *resolver = arg;
+
+    symbol_map_resolve_symbol(resolver->source, resolver->list, resolver->num, name);
+}
+
+
+
+/// Apply an override definition to the first section after parsing
+static char*
+apply_define(const char *filename, const char *section_name, const char *define,
+	     int lazy, int resolve, size_t *size)
+{
+    nvm_symbol_map_source *source;
+    nvm_symbol *list = NULL;
+    override_list *overrides = NULL;
+    override_program *program;
+    struct define_resolver resolver;
+    char *data = NULL;
+    int num, ret = -1;
+
+    symbol_map_lazy_resolution(lazy);
+    source = symbol_map_open_file(filename);
+    num = symbol_map_parse(source, &section_name, 1, &list, 0);
+    // Resolve all symbols at once, or by name on demand
+    if (num > 0 && resolve == 1) symbol_map_resolve(source, list, num);
+    program = override_program_new();
+    resolver = (struct define_resolver) { source, list, num };
+    if (resolve == 2) override_program_resolver(program, resolve_define, &resolver);
+    if (num > 0 && program && override_list_add(&overrides, "%s", define) == 0) {
+	ret = override_program_add_list(program, overrides, list, num,
+					symbol_map_index(source));
+    }
+    if (ret > 0 && override_program_apply(program, list) > 0) {
+	*size = symbol_map_blob_size(source, 0);
+	data = malloc(*size);
+	if (data) memcpy(data, symbol_map_blob_address(source, 0), *size);
+    }
+
+    override_program_free(program);
+    override_list_free(overrides);
+    if (num > 0) symbol_list_free(list, num);
+    free(list);
+    symbol_map_close(source);
+    return data;
+}
+
+
+
+/// Check that a definition yields the same data in eager and lazy mode
+static int
+compare_define(const char *filename, const char *section_name, const char *define)
+{
+    static const char *mode[] = {
+	"eager", "lazy unresolved", "lazy resolved", "lazy by name",
+    };
+    char *eager, *lazy;
+    size_t eager_size = 0, lazy_size = 0;
+    int i, failed = 0;
+
+    eager = apply_define(filename, section_name, define, 0, 0, &eager_size);
+    printf("%-16s %s\n", mode[0], eager ? "applied" : "failed");
+    for (i = 1; i <= 3; ++i) {
+	lazy = apply_define(filename, section_name, define, 1, i - 1, &lazy_size);
+	printf("%-16s %s\n", mode[i], ! lazy || ! eager ? "failed"
+	       : lazy_size == eager_size && memcmp(lazy, eager, eager_size) == 0
+	       ? "same as eager" : "DIFFERENT from eager");
+	// Unresolved sizes may differ, the tool resolves before overriding
+	if (i >= 2 && (! lazy || ! eager || lazy_size != eager_size
+		       || memcmp(lazy, eager, eager_size) != 0)) failed = 1;
+	free(lazy);
+    }
+    free(eager);
+    return failed;
+}
+
+
+
+/// Apply a field definition like for --define to the given map's section
+/// in eager and lazy mode, checking that both yield the same data.
+int
+main(int argc, char **argv)
+{
+    if (argc != 4) {
+	fprintf(stderr, "Usage: %s ELF-FILE SECTION FIELD=HEX\n", argv[0]);
+	return 1;
+    }
+    return compare_define(argv[1], argv[2], argv[3]) ? 2 : 0;
+}
+#endif
+
+
+
+#ifdef TEST_PLAN_CACHE
+#include "transform.h"
+
+/// Check that the build ID survives replacing the ELF file by a cached layout,
+/// so the migration plan cached under it is found again
+static int
+check_cached_build_id(const char *filename, const char *section_name)
+{
+    static const char *run[] = { "compiling layout", "cached layout" };
+    char directory[] = "/tmp/symbol_map_test.XXXXXX", *cache_name = NULL;
+    char build_id[2][SYMBOL_MAP_BUILD_ID_SIZE] = { "", "" };
+    char plan_name[sizeof(directory) + 2 * SYMBOL_MAP_BUILD_ID_SIZE + sizeof(".plan")];
+    nvm_symbol_map_source *source;
+    nvm_symbol *list;
+    transfer_plan *plan;
+    int i, num, cached, loaded, failed = 0;
+
+    if (! mkdtemp(directory)) return 1;
+    symbol_map_layout_cache(directory);
+    *plan_name = '\0';
+    for (i = 0; i < 2; ++i) {
+	list = NULL;
+	source = symbol_map_open_file(filename);
+	num = symbol_map_parse(source, &section_name, 1, &list, 0);
+	cached = source && layout_file_identify(source->map_address, source->map_size);
+	if (! cache_name && source) cache_name = layout_cache_name(source);
+	// Migration plans are cached under the build IDs, so they must not change
+	if (num < 0 || cached != i
+	    || ! symbol_map_build_id(source, build_id[i], sizeof(build_id[i]))
+	    || strcmp(build_id[i], build_id[0]) != 0) failed = 1;
+	printf("%-16s build ID %s\n", run[i], *build_id[i] ? build_id[i] : "(none)");
+
+	// Like the tool, read the plan between identical builds or compile it
+	loaded = 0;
+	if (*build_id[i] && snprintf(plan_name, sizeof(plan_name), "%s/%s-%s.plan", directory,
+				     build_id[i], build_id[i]) < (int) sizeof(plan_name)) {
+	    plan = transfer_plan_read(plan_name);
+	    loaded = plan && transfer_plan_sections(plan) == 1
+		&& transfer_plan_matches(plan, 0, symbol_map_blob_size(source, 0),
+					 symbol_map_blob_size(source, 0));
+	    if (! plan && num >= 0 && (plan = transfer_plan_new())
+		&& transfer_plan_add_section(plan, list, num, symbol_map_index(source),
+					     symbol_map_blob_size(source, 0), list, num,
+					     symbol_map_blob_size(source, 0)) >= 0) {
+		transfer_plan_write(plan, plan_name);
+	    }
+	    transfer_plan_free(plan);
+	}
+	printf("%-16s migration plan %s\n", run[i], loaded ? "loaded" : "compiled");
+	if (loaded != i) failed = 1;
+
+	if (num > 0) symbol_list_free(list, num);
+	free(list);
+	symbol_map_close(source);
+    }
+    symbol_map_layout_cache(NULL);
+    if (cache_name) unlink(cache_name);
+    if (*plan_name) unlink(plan_name);
+    free(cache_name);
+    rmdir(directory);
+    printf("plan cache after cached layout %s\n", failed ? "FAILED" : "ok");
+    return failed;
+}
+
+
+
+/// Check that a migration plan cached under the given map's build ID is
+/// found again once the map is replaced by its cached layout.
+int
+main(int argc, char **argv)
+{
+    if (argc < 2) {
+	fprintf(stderr, "Usage: %s ELF-FILE [SECTION]\n", argv[0]);
+	return 1;
+    }
+    return check_cached_build_id(argv[1], argc > 2 ? argv[2] : ".eeprom") ? 2 : 0;
+}
+#endif
@@ -1,6 +1,6 @@
 ///@file
 ///@brief	Parsing of symbol maps with binary data
-///@copyright	Copyright (C) 2014, 2023  Andre Colomb
+///@copyright	Copyright (C) 2014, 2023, 2026  Andre Colomb
 ///
 /// This file is part of elf-mangle.
 ///
@@ -25,48 +25,196 @@
 #define SYMBOL_MAP_H_
 
 #include <stddef.h>
+#include <stdint.h>
 
 // Forward declarations
 typedef struct nvm_symbol nvm_symbol;
+typedef struct symbol_index symbol_index;
 
 
 /// Opaque type to keep state of symbol map source internals
 typedef struct nvm_symbol_map_source nvm_symbol_map_source;
 
+/// Buffer size for the longest supported build ID in hex notation, including NUL
+#define SYMBOL_MAP_BUILD_ID_SIZE	(2 * 64 + 1)
+
 
 ///@brief Open the given file as symbol map
+///@details Both ELF files and compiled layout files are accepted.
 ///@return Handle of this source for further processing
 nvm_symbol_map_source* symbol_map_open_file(
     const char *filename		///< [in] File path to open
 );
 
+///@brief Set up a directory for caching compiled layouts of ELF files
+///@details Layouts are keyed by the GNU build ID note of each ELF file and the
+///         section names.  Subsequent parsing of the same sections from an ELF
+///         file with equal build ID uses the cached layout without accessing
+///         libelf.
+void symbol_map_layout_cache(
+    const char *directory		///< [in] Cache directory or NULL to disable
+);
+
+///@brief Set up parallel scanning of large ELF symbol tables
+///@details The symbol table is split into consecutive partitions, each scanned
+///         by a separate thread.  Small symbol tables are not split up.  The
+///         resulting symbol order is the same as with sequential scanning.
+void symbol_map_scan_threads(
+    int threads				///< [in] Maximum number of threads to use
+);
+
+///@brief Defer resolving symbol fields until actually needed
+///@details With lazy resolution, parsing records only the raw symbol name, size
+///         and location.  Each symbol refers to a placeholder field holding just
+///         the symbol name and expected size, which suffices to find symbols by
+///         name.  Known field descriptors, content-based size adjustment and
+///         sharing of field descriptors between maps require calling
+///         symbol_map_resolve() first.  Has no effect if parsing needs to save
+///         the original values.
+void symbol_map_lazy_resolution(
+    int enable				///< [in] Non-zero to resolve lazily
+);
+
 ///@brief Examine symbol map contents, store symbol list and binary data
+///@details Symbols from all requested sections are collected in a single pass.
+///         Each section's symbols are stored contiguously in the resulting list,
+///         in the order of requested sections.  The list is indexed for fast
+///         lookups, the index being owned by the map source and valid until
+///         the next parsing or closing the source.
+///@see symbol_map_section_symbols(), symbol_map_index()
 ///@return
 /// - Number of symbols parsed successfully
 /// - Zero if no symbols were found
 /// - Negative value on error (*symbol_list will be unaltered or NULL)
 int symbol_map_parse(
     nvm_symbol_map_source *source,	///< [in,out] Handle of the map source
-    const char *section_name,		///< [in] Section within the source to parse
+    const char *const section_names[],	///< [in] Sections within the source to parse
+    int num_sections,			///< [in] Number of sections to parse
     nvm_symbol **symbol_list,		///< [out] List of symbols found
     int save_values			///< [in] Need separate copies of the original values?
 );
 
-///@brief Access the source's binary data
+///@brief Resolve the field descriptors of lazily parsed symbols
+///@details Symbols already resolved are skipped, so this is cheap to call
+///         repeatedly.  Sizes are adjusted based on the current blob content,
+///         so resolution should happen before modifying any data.  The list's
+///         index is rebuilt if any symbols were resolved.
+///@return Number of symbols resolved or negative on error
+int symbol_map_resolve(
+    nvm_symbol_map_source *source,	///< [in,out] Handle of the parsed map source
+    nvm_symbol *symbol_list,		///< [in,out] List of symbols from parsing
+    int num_symbols			///< [in] Number of symbols in the list
+);
+
+///@brief Resolve the field descriptors of lazily parsed symbols with a given name
+///@details Only the first symbol of that name in each section is resolved,
+///         which is the one any lookup by name finds.  The list's index stays
+///         valid for lookups by name, but not by field until the next call of
+///         symbol_map_resolve().  As for that, resolve before modifying the
+///         symbols' data.
+///@return Number of symbols resolved or negative on error
+int symbol_map_resolve_symbol(
+    nvm_symbol_map_source *source,	///< [in,out] Handle of the parsed map source
+    nvm_symbol *symbol_list,		///< [in,out] List of symbols from parsing
+    int num_symbols,			///< [in] Number of symbols in the list
+    const char *name			///< [in] Symbol name to resolve
+);
+
+///@brief Write a compiled layout file for all parsed sections
+///@details Must be called before the binary data is modified, as it is stored
+///         to serve as default content when using the layout file as map.
+///@return Zero on success or negative error code
+int symbol_map_write_layout(
+    const nvm_symbol_map_source *source,///< [in] Handle of the map source
+    const nvm_symbol *symbol_list,	///< [in] List of symbols from parsing
+    int num_symbols,			///< [in] Number of symbols in the list
+    const char *filename		///< [in] Output file path
+);
+
+///@brief Get the GNU build ID note of a memory mapped ELF map file
+///@details The build ID is read when opening the file, so it remains available
+///         after parsing switched to a cached compiled layout.
+///@return Length of the build ID in hex notation or zero if not available
+size_t symbol_map_build_id(
+    const nvm_symbol_map_source *source,///< [in] Handle of the map source
+    char *hex,				///< [out] Buffer for the build ID in hex notation
+    size_t hex_size			///< [in] Size of the buffer, including NUL
+);
+
+///@brief Get the layout fingerprint of an examined section
+///@details The fingerprint covers the blob size and each symbol's name, offset,
+///         size and copy behavior, regardless of symbol order.  Equal
+///         fingerprints indicate identical layouts, so data can be migrated
+///         by copying all symbols' bytes in place.  It is computed during
+///         parsing, or by symbol_map_resolve() when resolving lazily.
+///@return Fingerprint value or zero if not available
+uint64_t symbol_map_fingerprint(
+    const nvm_symbol_map_source *source,///< [in] Handle of the map source
+    int section				///< [in] Index of the examined section
+);
+
+///@brief Check whether an examined section's fields are all copied verbatim
+///@details Fields with custom or no-op copy functions, as well as several
+///         symbols with the same name, rule out migrating by plain copying.
+///@return Non-zero if the fingerprint is available and plain copying suffices
+int symbol_map_plain_copy(
+    const nvm_symbol_map_source *source,///< [in] Handle of the map source
+    int section				///< [in] Index of the examined section
+);
+
+///@brief Check how many sections were examined by parsing
+///@return Number of sections or zero on error
+int symbol_map_sections(
+    const nvm_symbol_map_source *source	///< [in] Handle of the map source
+);
+
+///@brief Access the name of an examined section
+///@return Section name or NULL on error
+const char* symbol_map_section_name(
+    const nvm_symbol_map_source *source,///< [in] Handle of the map source
+    int section				///< [in] Index of the examined section
+);
+
+///@brief Locate the symbols of an examined section within the parsed list
+///@return Number of symbols belonging to the section
+int symbol_map_section_symbols(
+    const nvm_symbol_map_source *source,///< [in] Handle of the map source
+    int section,			///< [in] Index of the examined section
+    int *first				///< [out] Index of the section's first symbol
+);
+
+///@brief Access the index of the symbol list from the last parsing
+///@return Index for symbol_list_find_field() and symbol_list_find_symbol() or NULL
+const symbol_index* symbol_map_index(
+    const nvm_symbol_map_source *source	///< [in] Handle of the map source
+);
+
+///@brief Access an examined section's binary data
 ///@return Address of the binary data or NULL on error
 char* symbol_map_blob_address(
-    const nvm_symbol_map_source *source	///< [in,out] Handle of the map source
+    const nvm_symbol_map_source *source,///< [in] Handle of the map source
+    int section				///< [in] Index of the examined section
 );
 
-///@brief Check the size of the source's binary data
+///@brief Check the size of an examined section's binary data
 ///@return Size of binary data or zero on error
 size_t symbol_map_blob_size(
-    const nvm_symbol_map_source *source	///< [in,out] Handle of the map source
+    const nvm_symbol_map_source *source,///< [in] Handle of the map source
+    int section				///< [in] Index of the examined section
+);
+
+///@brief Check where an examined section's binary data is loaded on the target
+///@details Image files with absolute addresses hold the data starting there.
+///@return Load address of the binary data or zero on error
+size_t symbol_map_load_address(
+    const nvm_symbol_map_source *source,///< [in] Handle of the map source
+    int section				///< [in] Index of the examined section
 );
 
-///@brief Print out the size of the source's binary data
+///@brief Print out the size of an examined section's binary data
 void symbol_map_print_size(
     const nvm_symbol_map_source *source,///< [in] Handle of the map source
+    int section,			///< [in] Index of the examined section
     int parseable			///< [in] Avoid localized output
 );
 
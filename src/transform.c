@@ -1,6 +1,6 @@
 ///@file
 ///@brief	Copy symbol data between different lists
-///@copyright	Copyright (C) 2014, 2015  Andre Colomb
+///@copyright	Copyright (C) 2014, 2015, 2026  Andre Colomb
 ///
 /// This file is part of elf-mangle.
 ///
@@ -25,16 +25,164 @@
 
 #include "transform.h"
 #include "symbol_list.h"
+#include "known_fields.h"
 #include "nvm_field.h"
+#include "atomic_file.h"
 #include "intl.h"
 
+#include <sys/stat.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 /// Compile diagnostic output messages?
 #define DEBUG 0
 
+/// Identification at the start of every migration plan file
+#define PLAN_FILE_MAGIC		"ELFMPLN"
+/// Plan file format revision, incremented on any incompatible change
+#define PLAN_FILE_VERSION	1
+/// Marker to detect files written on a host with different byte order
+#define PLAN_FILE_BYTE_ORDER	0x01020304U
+
+
+
+/// Types of operations in a migration plan
+enum transfer_step_kind {
+    stepMissing = 0,		///< Report field missing from the source
+    stepCopy,			///< Copy a byte range verbatim
+    stepCustom,			///< Call the field's custom copy function
+};
+
+/// Single operation of a migration plan
+typedef struct transfer_step {
+    /// Position of the data within the source blob
+    size_t		offset_src;
+    /// Position of the data within the destination blob
+    size_t		offset_dst;
+    /// Number of bytes available from the source
+    size_t		size_src;
+    /// Number of bytes to write at most to the destination
+    size_t		size_dst;
+    /// Blob to read from, counted along a migration chain
+    int			buffer_src;
+    /// Blob to write to, counted along a migration chain
+    int			buffer_dst;
+    /// Field descriptor for custom copy steps
+    const nvm_field*	field;
+    /// Field name for custom copy and missing field steps
+    const char*		name;
+    /// Type of operation
+    enum transfer_step_kind kind;
+    /// Position in destination symbol list while compiling
+    int			order;
+} transfer_step;
+
+/// Range of steps to migrate one section
+typedef struct plan_section {
+    /// Index of the section's first step
+    int			first_step;
+    /// Number of consecutive steps for the section
+    int			num_steps;
+} plan_section;
+
+/// Compiled migration between two layouts, possibly via intermediate ones
+struct transfer_plan {
+    /// Sections covered
+    plan_section*	sections;
+    /// Number of sections covered
+    int			num_sections;
+    /// Number of blobs per section, from source to final destination
+    int			num_buffers;
+    /// Blob sizes the plan was compiled for, num_buffers per section
+    size_t*		sizes;
+    /// Steps for all sections
+    transfer_step*	steps;
+    /// Number of steps for all sections
+    int			num_steps;
+    /// Allocated size of the steps list
+    int			steps_size;
+    /// File contents holding the names of a loaded plan, NULL if compiled
+    char*		file_data;
+};
+
+/// Origin of a byte range within an intermediate blob while composing plans
+typedef struct plan_segment {
+    /// Position of the range within the described blob
+    size_t		offset;
+    /// Number of bytes in the range
+    size_t		size;
+    /// Blob holding the data, counted along the migration chain
+    int			buffer;
+    /// Position of the data within the holding blob
+    size_t		offset_src;
+} plan_segment;
+
+/// Ordered, non-overlapping ranges describing one intermediate blob.
+/// Any bytes not covered are still held by the described blob itself.
+typedef struct segment_list {
+    /// Ranges sorted by offset
+    plan_segment*	list;
+    /// Number of ranges
+    int			count;
+    /// Allocated size of the list
+    int			size;
+} segment_list;
+
+/// Function pointer to process a piece of an intermediate blob's contents
+typedef int (*segment_piece_f)(
+    void *context,		///< [in,out] Custom data to control iteration
+    const plan_segment *piece	///< [in] Origin of the piece
+);
+
+/// File header of a stored migration plan, followed by the section
+/// records, the step records and the string table in that order
+typedef struct plan_file_header {
+    /// Identification string including NUL terminator
+    char		magic[8];
+    /// Byte order marker, must equal PLAN_FILE_BYTE_ORDER
+    uint32_t		byte_order;
+    /// Format revision, must equal PLAN_FILE_VERSION
+    uint32_t		version;
+    /// Number of section records
+    uint32_t		num_sections;
+    /// Number of step records
+    uint32_t		num_steps;
+    /// Number of known fields in the writing program
+    uint32_t		known_fields;
+    /// Size of the string table in bytes
+    uint32_t		strings_size;
+} plan_file_header;
+
+/// Record describing one section of a stored migration plan
+typedef struct plan_file_section {
+    /// Size of the source blob
+    uint64_t		size_src;
+    /// Size of the destination blob
+    uint64_t		size_dst;
+    /// Index of the section's first step record
+    uint32_t		first_step;
+    /// Number of consecutive step records
+    uint32_t		num_steps;
+} plan_file_section;
+
+/// Record describing one step of a stored migration plan
+typedef struct plan_file_step {
+    /// Position of the data within the source blob
+    uint64_t		offset_src;
+    /// Position of the data within the destination blob
+    uint64_t		offset_dst;
+    /// Number of bytes available from the source
+    uint64_t		size_src;
+    /// Number of bytes to write at most to the destination
+    uint64_t		size_dst;
+    /// Type of operation
+    uint32_t		kind;
+    /// String table index of the field name, for custom and missing steps
+    uint32_t		name;
+} plan_file_step;
+
 
 
 /// Structure of data passed to transfer iterator function
@@ -43,6 +191,8 @@ struct transfer_config {
     const nvm_symbol*	list_src;
     /// Number of symbols in source list
     int			num_src;
+    /// Index of the source list or NULL
+    const symbol_index*	index_src;
 };
 
 
@@ -59,7 +209,8 @@ transfer_field_iterator(
     size_t copied;
     field_copy_f copy_func = copy_field_verbatim;
 
-    symbol_src = symbol_list_find_field(conf->list_src, conf->num_src, symbol_dst->field);
+    symbol_src = symbol_list_find_field(conf->index_src, conf->list_src, conf->num_src,
+					symbol_dst->field);
     if (symbol_src) {
 	if (DEBUG) printf(_("%s: Target `%s' (%p) matches source symbol %p\n"), __func__,
 			  symbol_dst->field->symbol, symbol_dst, symbol_src);
@@ -80,14 +231,810 @@ transfer_field_iterator(
 
 
 void
-transfer_fields(const nvm_symbol *list_src, int num_src,
+transfer_fields(const nvm_symbol *list_src, int num_src, const symbol_index *index_src,
 		const nvm_symbol *list_dst, int num_dst)
 {
     struct transfer_config conf = {
 	.list_src	= list_src,
 	.num_src	= num_src,
+	.index_src	= index_src,
     };
 
     if (DEBUG) printf(_("%s: Copy %d symbols in to %d out\n"), __func__, num_src, num_dst);
     symbol_list_foreach(list_dst, num_dst, transfer_field_iterator, &conf);
 }
+
+
+
+transfer_plan*
+transfer_plan_new(void)
+{
+    transfer_plan *plan;
+
+    plan = calloc(1, sizeof(*plan));
+    if (plan) plan->num_buffers = 2;
+    return plan;
+}
+
+
+
+///@brief Make room for one more section in the plan
+///@return Address of the new section record or NULL on error
+static plan_section*
+append_section(
+    transfer_plan *plan)	///< [in,out] Plan to extend
+{
+    plan_section *sections;
+    size_t *sizes;
+
+    sections = realloc(plan->sections, (plan->num_sections + 1) * sizeof(*sections));
+    if (! sections) return NULL;
+    plan->sections = sections;
+    sizes = realloc(plan->sizes,
+		    (plan->num_sections + 1) * plan->num_buffers * sizeof(*sizes));
+    if (! sizes) return NULL;
+    plan->sizes = sizes;
+
+    sections[plan->num_sections].first_step = plan->num_steps;
+    sections[plan->num_sections].num_steps = 0;
+    return &sections[plan->num_sections];
+}
+
+
+
+///@brief Reserve room for a new step at the end of the plan
+///@return Address of the new step or NULL on error
+static transfer_step*
+append_step(
+    transfer_plan *plan)	///< [in,out] Plan to extend
+{
+    transfer_step *steps;
+    int new_size;
+
+    if (plan->num_steps >= plan->steps_size) {
+	new_size = plan->steps_size < 8 ? 16 : plan->steps_size * 2;
+	steps = realloc(plan->steps, new_size * sizeof(*steps));
+	if (! steps) return NULL;
+	plan->steps = steps;
+	plan->steps_size = new_size;
+    }
+    return memset(&plan->steps[plan->num_steps++], 0, sizeof(transfer_step));
+}
+
+
+
+/// Order steps by destination offset, reporting missing fields first
+static int
+compare_step_offset(const void *a, const void *b)
+{
+    const transfer_step *step_a = a, *step_b = b;
+
+    if ((step_a->kind == stepMissing) != (step_b->kind == stepMissing)) {
+	return step_a->kind == stepMissing ? -1 : 1;
+    }
+    if (step_a->offset_dst != step_b->offset_dst) {
+	return step_a->offset_dst < step_b->offset_dst ? -1 : 1;
+    }
+    return step_a->order - step_b->order;
+}
+
+
+
+/// Restore the order of the destination symbol list
+static int
+compare_step_order(const void *a, const void *b)
+{
+    return ((const transfer_step*) a)->order - ((const transfer_step*) b)->order;
+}
+
+
+
+///@brief Sort a section's steps by destination offset and merge adjacent copies
+///@details Overlapping destination ranges, as with aliased symbols, keep the
+///         original order, because then the last write matters.
+///@return New number of steps
+static int
+coalesce_steps(
+    transfer_step steps[],	///< [in,out] Steps of one section
+    int num_steps)		///< [in] Number of steps
+{
+    transfer_step *step, *last = NULL;
+    int merged = 0;
+
+    qsort(steps, num_steps, sizeof(*steps), compare_step_offset);
+    for (step = steps; step < steps + num_steps; ++step) {
+	if (step->kind == stepMissing) continue;
+	if (last && step->offset_dst < last->offset_dst + last->size_dst) {
+	    qsort(steps, num_steps, sizeof(*steps), compare_step_order);
+	    break;
+	}
+	last = step;
+    }
+
+    last = NULL;
+    for (step = steps; step < steps + num_steps; ++step) {
+	if (last && last->kind == stepCopy && step->kind == stepCopy
+	    && last->offset_src + last->size_src == step->offset_src
+	    && last->offset_dst + last->size_dst == step->offset_dst) {
+	    last->size_src += step->size_src;
+	    last->size_dst += step->size_dst;
+	    ++merged;
+	    continue;
+	}
+	last = last ? last + 1 : steps;
+	if (last != step) *last = *step;
+    }
+    if (DEBUG) printf("%s: %d steps merged into %d\n", __func__, num_steps, num_steps - merged);
+    return num_steps - merged;
+}
+
+
+
+int
+transfer_plan_add_section(transfer_plan *plan,
+			  const nvm_symbol *list_src, int num_src,
+			  const symbol_index *index_src, size_t size_src,
+			  const nvm_symbol *list_dst, int num_dst, size_t size_dst)
+{
+    const nvm_symbol *symbol_dst, *symbol_src;
+    plan_section *section;
+    transfer_step *step;
+    field_copy_f copy_func;
+
+    if (! plan || plan->num_buffers != 2 || num_src < 0 || num_dst < 0) return -1;
+
+    if (! (section = append_section(plan))) return -3;
+    plan->sizes[plan->num_sections * 2 + 0] = size_src;
+    plan->sizes[plan->num_sections * 2 + 1] = size_dst;
+
+    for (symbol_dst = list_dst; symbol_dst < list_dst + num_dst; ++symbol_dst) {
+	symbol_src = symbol_list_find_field(index_src, list_src, num_src, symbol_dst->field);
+	copy_func = symbol_src ? symbol_dst->field->copy_func : NULL;
+	if (copy_func == copy_field_noop) continue;
+	if (! (step = append_step(plan))) return -3;
+
+	step->order = symbol_dst - list_dst;
+	step->buffer_dst = 1;
+	step->offset_dst = symbol_dst->offset;
+	step->name = symbol_dst->field->symbol;
+	if (! symbol_src) {
+	    step->kind = stepMissing;
+	    continue;
+	}
+	step->offset_src = symbol_src->offset;
+	step->size_src = symbol_src->size;
+	step->size_dst = symbol_dst->size;
+	if (copy_func && copy_func != copy_field_verbatim) {
+	    step->kind = stepCustom;
+	    step->field = symbol_dst->field;
+	} else {
+	    // Limit copying to the smaller of the source and destination fields
+	    step->kind = stepCopy;
+	    if (step->size_src > step->size_dst) step->size_src = step->size_dst;
+	    else step->size_dst = step->size_src;
+	    if (! step->size_dst) --plan->num_steps;
+	}
+    }
+
+    section->num_steps = coalesce_steps(plan->steps + section->first_step,
+					plan->num_steps - section->first_step);
+    plan->num_steps = section->first_step + section->num_steps;
+    return plan->num_sections++;
+}
+
+
+
+int
+transfer_plan_add_identity(transfer_plan *plan,
+			   const nvm_symbol *list, int num_symbols, size_t size)
+{
+    const nvm_symbol *symbol;
+    plan_section *section;
+    transfer_step *step, *last;
+
+    if (! plan || plan->num_buffers != 2 || num_symbols < 0 || (num_symbols && ! list)) return -1;
+
+    if (! (section = append_section(plan))) return -3;
+    plan->sizes[plan->num_sections * 2 + 0] = size;
+    plan->sizes[plan->num_sections * 2 + 1] = size;
+
+    for (symbol = list; symbol < list + num_symbols; ++symbol) {
+	if (! symbol->size) continue;
+	if (! (step = append_step(plan))) return -3;
+	step->kind = stepCopy;
+	step->buffer_dst = 1;
+	step->offset_src = step->offset_dst = symbol->offset;
+	step->size_src = step->size_dst = symbol->size;
+	step->order = symbol - list;
+    }
+
+    // Every byte keeps its position, so overlapping ranges can be merged as well
+    step = plan->steps + section->first_step;
+    qsort(step, plan->num_steps - section->first_step, sizeof(*step), compare_step_offset);
+    for (last = NULL; step < plan->steps + plan->num_steps; ++step) {
+	if (last && step->offset_dst <= last->offset_dst + last->size_dst) {
+	    if (step->offset_dst + step->size_dst > last->offset_dst + last->size_dst) {
+		last->size_dst = last->size_src = step->offset_dst + step->size_dst
+		    - last->offset_dst;
+	    }
+	    continue;
+	}
+	last = last ? last + 1 : plan->steps + section->first_step;
+	if (last != step) *last = *step;
+    }
+    section->num_steps = last ? last + 1 - (plan->steps + section->first_step) : 0;
+    plan->num_steps = section->first_step + section->num_steps;
+    if (DEBUG) printf("%s: %d symbols in %d ranges\n", __func__,
+		      num_symbols, section->num_steps);
+    return plan->num_sections++;
+}
+
+
+
+int
+transfer_plan_sections(const transfer_plan *plan)
+{
+    if (! plan) return 0;
+    return plan->num_sections;
+}
+
+
+
+int
+transfer_plan_buffers(const transfer_plan *plan)
+{
+    if (! plan) return 0;
+    return plan->num_buffers;
+}
+
+
+
+int
+transfer_plan_matches(const transfer_plan *plan, int section,
+		      size_t size_src, size_t size_dst)
+{
+    const size_t *sizes;
+
+    if (! plan || section < 0 || section >= plan->num_sections) return 0;
+    sizes = plan->sizes + section * plan->num_buffers;
+    return sizes[0] == size_src && sizes[plan->num_buffers - 1] == size_dst;
+}
+
+
+
+int
+transfer_plan_apply(const transfer_plan *plan, int section,
+		    const char *blob_src, size_t size_src,
+		    char *blob_dst, size_t size_dst)
+{
+    char *blobs[2] = { (char*) blob_src, blob_dst };
+    const size_t sizes[2] = { size_src, size_dst };
+
+    if (! plan || plan->num_buffers != 2) return -1;
+    return transfer_plan_apply_chain(plan, section, blobs, sizes);
+}
+
+
+
+int
+transfer_plan_apply_chain(const transfer_plan *plan, int section,
+			  char *const blobs[], const size_t sizes[])
+{
+    const transfer_step *step, *end;
+    int i;
+
+    if (! plan || section < 0 || section >= plan->num_sections || ! blobs || ! sizes) return -1;
+    for (i = 0; i < plan->num_buffers; ++i) {
+	if (sizes[i] != plan->sizes[section * plan->num_buffers + i]) return -1;
+    }
+
+    step = plan->steps + plan->sections[section].first_step;
+    end = step + plan->sections[section].num_steps;
+    for (; step < end; ++step) {
+	switch (step->kind) {
+	case stepCopy:
+	    memcpy(blobs[step->buffer_dst] + step->offset_dst,
+		   blobs[step->buffer_src] + step->offset_src, step->size_dst);
+	    break;
+
+	case stepCustom:
+	    step->field->copy_func(step->field,
+				   blobs[step->buffer_dst] + step->offset_dst,
+				   blobs[step->buffer_src] + step->offset_src,
+				   step->size_dst, step->size_src);
+	    break;
+
+	case stepMissing:
+	    fprintf(stderr, _("Target map field %s not found in source.\n"), step->name);
+	    break;
+	}
+    }
+    return 0;
+}
+
+
+
+///@brief Output the plan contents to an open stream
+///@return Zero on success or negative error code
+static int
+write_plan(
+    FILE *out,			///< [in] Output file stream
+    const void *arg)		///< [in] Compiled migration plan
+{
+    const transfer_plan *plan = arg;
+    plan_file_header header = {
+	.magic		= PLAN_FILE_MAGIC,
+	.byte_order	= PLAN_FILE_BYTE_ORDER,
+	.version	= PLAN_FILE_VERSION,
+	.num_sections	= plan->num_sections,
+	.num_steps	= plan->num_steps,
+	.known_fields	= known_fields_expected(),
+    };
+    plan_file_section section = { 0 };
+    plan_file_step record = { 0 };
+    const transfer_step *step;
+    int i;
+
+    for (step = plan->steps; step < plan->steps + plan->num_steps; ++step) {
+	if (step->kind != stepCopy) header.strings_size += strlen(step->name) + 1;
+    }
+    if (fwrite(&header, sizeof(header), 1, out) != 1) return -2;
+
+    for (i = 0; i < plan->num_sections; ++i) {
+	section.size_src = plan->sizes[i * 2 + 0];
+	section.size_dst = plan->sizes[i * 2 + 1];
+	section.first_step = plan->sections[i].first_step;
+	section.num_steps = plan->sections[i].num_steps;
+	if (fwrite(&section, sizeof(section), 1, out) != 1) return -2;
+    }
+
+    for (step = plan->steps; step < plan->steps + plan->num_steps; ++step) {
+	record.offset_src = step->offset_src;
+	record.offset_dst = step->offset_dst;
+	record.size_src = step->size_src;
+	record.size_dst = step->size_dst;
+	record.kind = step->kind;
+	if (fwrite(&record, sizeof(record), 1, out) != 1) return -2;
+	if (step->kind != stepCopy) record.name += strlen(step->name) + 1;
+    }
+
+    for (step = plan->steps; step < plan->steps + plan->num_steps; ++step) {
+	if (step->kind != stepCopy
+	    && fwrite(step->name, strlen(step->name) + 1, 1, out) != 1) return -2;
+    }
+    return 0;
+}
+
+
+
+int
+transfer_plan_write(const transfer_plan *plan, const char *filename)
+{
+    int status;
+
+    // Composed chains refer to intermediate maps not known from the file name
+    if (! plan || ! filename || plan->num_buffers != 2) return -1;
+
+    status = atomic_file_write(filename, _("migration plan file"), write_plan, plan);
+    if (DEBUG) printf("%s: %d sections, %d steps -> %s (%d)\n", __func__,
+		      plan->num_sections, plan->num_steps, filename, status);
+    return status;
+}
+
+
+
+///@brief Validate a stored plan and set up the steps referring to it
+///@return NULL on success or reason why the plan is unusable
+static const char*
+load_plan(
+    transfer_plan *plan,	///< [in,out] Empty plan owning the file data
+    size_t size)		///< [in] Size of the file data in bytes
+{
+    const plan_file_header *header = (const plan_file_header*) plan->file_data;
+    const plan_file_section *section;
+    const plan_file_step *record;
+    const char *strings;
+    transfer_step *step;
+    size_t records;
+    int i;
+
+    if (size < sizeof(*header)
+	|| memcmp(header->magic, PLAN_FILE_MAGIC, sizeof(PLAN_FILE_MAGIC)) != 0) {
+	return "Not a migration plan file";
+    }
+    if (header->byte_order != PLAN_FILE_BYTE_ORDER) return "Incompatible byte order";
+    if (header->version != PLAN_FILE_VERSION) return "Unsupported format version";
+    if (header->known_fields != (uint32_t) known_fields_expected()) return "Known fields changed";
+
+    records = sizeof(*header) + (size_t) header->num_sections * sizeof(*section)
+	+ (size_t) header->num_steps * sizeof(*record);
+    if (records > size || size - records != header->strings_size) return "File truncated";
+    if (header->strings_size && plan->file_data[size - 1] != '\0') return "Corrupt string table";
+
+    section = (const plan_file_section*) (header + 1);
+    record = (const plan_file_step*) (section + header->num_sections);
+    strings = (const char*) (record + header->num_steps);
+
+    plan->sections = calloc(header->num_sections, sizeof(*plan->sections));
+    plan->sizes = calloc(header->num_sections, 2 * sizeof(*plan->sizes));
+    plan->steps = calloc(header->num_steps, sizeof(*plan->steps));
+    if ((header->num_sections && (! plan->sections || ! plan->sizes))
+	|| (header->num_steps && ! plan->steps)) {
+	return "Out of memory";
+    }
+    plan->steps_size = header->num_steps;
+
+    for (i = 0; i < (int) header->num_sections; ++i, ++section) {
+	if (section->first_step != (uint32_t) plan->num_steps
+	    || section->num_steps > header->num_steps - section->first_step) {
+	    return "Corrupt section record";
+	}
+	plan->sizes[i * 2 + 0] = section->size_src;
+	plan->sizes[i * 2 + 1] = section->size_dst;
+	plan->sections[i].first_step = section->first_step;
+	plan->sections[i].num_steps = section->num_steps;
+	plan->num_sections = i + 1;
+
+	for (; plan->num_steps < (int) (section->first_step + section->num_steps);
+	     ++record) {
+	    step = &plan->steps[plan->num_steps++];
+	    step->offset_src = record->offset_src;
+	    step->offset_dst = record->offset_dst;
+	    step->size_src = record->size_src;
+	    step->size_dst = record->size_dst;
+	    step->kind = record->kind;
+	    step->buffer_dst = 1;
+	    if (step->kind == stepMissing) step->size_src = step->size_dst = 0;
+	    else if (step->offset_src > section->size_src
+		     || step->size_src > section->size_src - step->offset_src
+		     || step->offset_dst > section->size_dst
+		     || step->size_dst > section->size_dst - step->offset_dst) {
+		return "Corrupt step record";
+	    }
+	    if (step->kind == stepCopy) continue;
+	    if (step->kind != stepMissing && step->kind != stepCustom) return "Corrupt step record";
+	    if (record->name >= header->strings_size) return "Corrupt string table";
+	    step->name = strings + record->name;
+
+	    // Custom copy functions must still be available in this program
+	    if (step->kind == stepCustom) {
+		step->field = find_known_field(step->name);
+		if (! step->field || ! step->field->copy_func) return "Known fields changed";
+	    }
+	}
+    }
+    if (plan->num_steps != (int) header->num_steps) return "Corrupt section record";
+    return NULL;
+}
+
+
+
+transfer_plan*
+transfer_plan_read(const char *filename)
+{
+    transfer_plan *plan;
+    const char *errmsg = NULL;
+    struct stat st;
+    FILE *in;
+
+    if (! filename) return NULL;
+
+    in = fopen(filename, "rb");
+    if (! in) return NULL;	//not stored yet
+    plan = transfer_plan_new();
+    if (plan && fstat(fileno(in), &st) == 0 && st.st_size > 0) {
+	plan->file_data = malloc(st.st_size);
+	if (! plan->file_data
+	    || fread(plan->file_data, st.st_size, 1, in) != 1) errmsg = "Read error";
+	else errmsg = load_plan(plan, st.st_size);
+    } else errmsg = "Read error";
+    fclose(in);
+
+    if (errmsg) {
+	if (DEBUG) printf("%s: ignoring \"%s\" (%s)\n", __func__, filename, errmsg);
+	transfer_plan_free(plan);
+	return NULL;
+    }
+    if (DEBUG) printf("%s: %d sections, %d steps <- %s\n", __func__,
+		      plan->num_sections, plan->num_steps, filename);
+    return plan;
+}
+
+
+
+void
+transfer_plan_free(transfer_plan *plan)
+{
+    if (! plan) return;
+    free(plan->sections);
+    free(plan->sizes);
+    free(plan->steps);
+    free(plan->file_data);
+    free(plan);
+}
+
+
+
+///@brief Find the first range ending after a position
+///@return Index of the range or number of ranges if none
+static int
+first_segment(
+    const segment_list *segments,	///< [in] Ranges describing a blob
+    size_t offset)			///< [in] Position within the blob
+{
+    int low = 0, high = segments->count, mid;
+
+    while (low < high) {
+	mid = (low + high) / 2;
+	if (segments->list[mid].offset + segments->list[mid].size > offset) high = mid;
+	else low = mid + 1;
+    }
+    return low;
+}
+
+
+
+///@brief Record the origin of a byte range, replacing any overlapped ranges
+///@return Zero on success or negative error code
+static int
+paint_segment(
+    segment_list *segments,	///< [in,out] Ranges describing a blob
+    size_t offset,		///< [in] Position of the range within the blob
+    size_t size,		///< [in] Number of bytes in the range
+    const plan_segment *origin)	///< [in] Origin of the data, NULL if held by the blob itself
+{
+    plan_segment left, right, *list;
+    int i, j, count, new_size;
+    size_t end = offset + size;
+
+    i = first_segment(segments, offset);
+    for (j = i; j < segments->count && segments->list[j].offset < end; ++j);
+
+    // Keep the parts of partially overlapped ranges
+    left.size = right.size = 0;
+    if (i < j && segments->list[i].offset < offset) {
+	left = segments->list[i];
+	left.size = offset - left.offset;
+    }
+    if (i < j && segments->list[j - 1].offset + segments->list[j - 1].size > end) {
+	right = segments->list[j - 1];
+	right.size -= end - right.offset;
+	right.offset_src += end - right.offset;
+	right.offset = end;
+    }
+    count = (left.size > 0) + (origin != NULL) + (right.size > 0);
+
+    if (segments->count + count - (j - i) > segments->size) {
+	new_size = segments->size < 8 ? 16 : segments->size * 2;
+	list = realloc(segments->list, new_size * sizeof(*list));
+	if (! list) return -3;
+	segments->list = list;
+	segments->size = new_size;
+    }
+    if (j < segments->count) {
+	memmove(segments->list + i + count, segments->list + j,
+		(segments->count - j) * sizeof(*segments->list));
+    }
+    segments->count += count - (j - i);
+
+    if (left.size) segments->list[i++] = left;
+    if (origin) {
+	segments->list[i] = *origin;
+	segments->list[i].offset = offset;
+	segments->list[i++].size = size;
+    }
+    if (right.size) segments->list[i] = right;
+    return 0;
+}
+
+
+
+///@brief Split a byte range of an intermediate blob into pieces by origin
+///@return Zero on success or the first non-zero return value of func
+static int
+foreach_piece(
+    const segment_list *segments,	///< [in] Ranges describing the blob
+    int buffer,				///< [in] The described blob itself
+    size_t offset,			///< [in] Position of the range within the blob
+    size_t size,			///< [in] Number of bytes in the range
+    segment_piece_f func,		///< [in] Function to call for each piece
+    void *context)			///< [in,out] Custom data passed to func
+{
+    const plan_segment *segment;
+    plan_segment piece;
+    size_t end = offset + size;
+    int i, ret;
+
+    i = first_segment(segments, offset);
+    for (piece.offset = offset; piece.offset < end; piece.offset += piece.size) {
+	segment = i < segments->count ? &segments->list[i] : NULL;
+	if (segment && segment->offset <= piece.offset) {
+	    // Data originating elsewhere
+	    piece.size = segment->offset + segment->size - piece.offset;
+	    piece.buffer = segment->buffer;
+	    piece.offset_src = segment->offset_src + (piece.offset - segment->offset);
+	    ++i;
+	} else {
+	    // Data held by the blob itself, up to the next range
+	    piece.size = (segment ? segment->offset : end) - piece.offset;
+	    piece.buffer = buffer;
+	    piece.offset_src = piece.offset;
+	}
+	if (piece.size > end - piece.offset) piece.size = end - piece.offset;
+	if ((ret = func(context, &piece))) return ret;
+    }
+    return 0;
+}
+
+
+
+/// Data passed to piece iterator functions while composing plans
+struct compose_context {
+    /// Composed plan being built
+    transfer_plan*	plan;
+    /// Ranges describing the destination blob of the current hop
+    segment_list*	segments;
+    /// Difference between destination and source position of the current step
+    size_t		shift;
+    /// Blob to write data to
+    int			buffer;
+};
+
+
+
+///@brief Iterator function to record the origin of copied data in the next blob
+///@see segment_piece_f
+static int
+compose_copy_piece(void *context, const plan_segment *piece)
+{
+    const struct compose_context *ctx = context;
+
+    return paint_segment(ctx->segments, piece->offset + ctx->shift, piece->size, piece);
+}
+
+
+
+///@brief Iterator function to place actual data in a blob before custom copying
+///@see segment_piece_f
+static int
+compose_fetch_piece(void *context, const plan_segment *piece)
+{
+    const struct compose_context *ctx = context;
+    transfer_step *step;
+
+    if (piece->buffer == ctx->buffer) return 0;	//already in place
+    if (! (step = append_step(ctx->plan))) return -3;
+    step->kind = stepCopy;
+    step->buffer_src = piece->buffer;
+    step->offset_src = piece->offset_src;
+    step->buffer_dst = ctx->buffer;
+    step->offset_dst = piece->offset;
+    step->size_src = step->size_dst = piece->size;
+    return 0;
+}
+
+
+
+///@brief Compose the steps of one section along all hops
+///@return Zero on success or negative error code
+static int
+compose_section(
+    transfer_plan *plan,		///< [in,out] Composed plan being built
+    transfer_plan *const hops[],	///< [in] Plans for each hop
+    int num_hops,			///< [in] Number of hops
+    int section)			///< [in] Section index
+{
+    segment_list current = { 0 }, next = { 0 };
+    struct compose_context ctx = { .plan = plan };
+    const transfer_step *hop_step, *end;
+    const plan_segment *segment;
+    transfer_step *step;
+    int hop, ret = 0;
+
+    for (hop = 0; hop < num_hops && ret == 0; ++hop) {
+	hop_step = hops[hop]->steps + hops[hop]->sections[section].first_step;
+	end = hop_step + hops[hop]->sections[section].num_steps;
+	for (; hop_step < end && ret == 0; ++hop_step) {
+	    switch (hop_step->kind) {
+	    case stepMissing:
+		if (! (step = append_step(plan))) ret = -3;
+		else *step = *hop_step;
+		break;
+
+	    case stepCopy:
+		// Follow the data back to where it originates
+		ctx.segments = &next;
+		ctx.shift = hop_step->offset_dst - hop_step->offset_src;
+		ret = foreach_piece(&current, hop, hop_step->offset_src, hop_step->size_src,
+				    compose_copy_piece, &ctx);
+		break;
+
+	    case stepCustom:
+		// The copy function needs the actual data in the intermediate blob
+		ctx.buffer = hop;
+		ret = foreach_piece(&current, hop, hop_step->offset_src, hop_step->size_src,
+				    compose_fetch_piece, &ctx);
+		if (ret == 0 && ! (step = append_step(plan))) ret = -3;
+		if (ret == 0) {
+		    *step = *hop_step;
+		    step->buffer_src = hop;
+		    step->buffer_dst = hop + 1;
+		    ret = paint_segment(&next, hop_step->offset_dst, hop_step->size_dst, NULL);
+		}
+		break;
+	    }
+	}
+	free(current.list);
+	current = next;
+	next.list = NULL;
+	next.count = next.size = 0;
+    }
+
+    // Copy everything originating elsewhere to the final blob, merging adjacent ranges
+    for (segment = current.list; ret == 0 && segment < current.list + current.count;
+	 ++segment) {
+	step = plan->num_steps > plan->sections[section].first_step
+	    ? &plan->steps[plan->num_steps - 1] : NULL;
+	if (step && step->kind == stepCopy && step->buffer_dst == num_hops
+	    && step->buffer_src == segment->buffer
+	    && step->offset_src + step->size_src == segment->offset_src
+	    && step->offset_dst + step->size_dst == segment->offset) {
+	    step->size_src += segment->size;
+	    step->size_dst += segment->size;
+	} else if (! (step = append_step(plan))) ret = -3;
+	else {
+	    step->kind = stepCopy;
+	    step->buffer_src = segment->buffer;
+	    step->offset_src = segment->offset_src;
+	    step->buffer_dst = num_hops;
+	    step->offset_dst = segment->offset;
+	    step->size_src = step->size_dst = segment->size;
+	}
+    }
+    free(current.list);
+    return ret;
+}
+
+
+
+transfer_plan*
+transfer_plan_compose(transfer_plan *const hops[], int num_hops)
+{
+    transfer_plan *plan;
+    plan_section *section;
+    int i, hop;
+
+    if (! hops || num_hops <= 0) return NULL;
+    for (hop = 0; hop < num_hops; ++hop) {
+	if (! hops[hop] || hops[hop]->num_buffers != 2
+	    || hops[hop]->num_sections != hops[0]->num_sections) return NULL;
+	// Each hop must start from the previous hop's destination
+	for (i = 0; hop > 0 && i < hops[0]->num_sections; ++i) {
+	    if (hops[hop]->sizes[i * 2 + 0] != hops[hop - 1]->sizes[i * 2 + 1]) return NULL;
+	}
+    }
+
+    plan = transfer_plan_new();
+    if (! plan) return NULL;
+    plan->num_buffers = num_hops + 1;
+
+    for (i = 0; i < hops[0]->num_sections; ++i) {
+	if (! (section = append_section(plan))) break;
+	for (hop = 0; hop < num_hops; ++hop) {
+	    plan->sizes[i * plan->num_buffers + hop] = hops[hop]->sizes[i * 2 + 0];
+	}
+	plan->sizes[i * plan->num_buffers + num_hops] = hops[num_hops - 1]->sizes[i * 2 + 1];
+	++plan->num_sections;
+
+	if (compose_section(plan, hops, num_hops, i) != 0) break;
+	plan->sections[i].num_steps = plan->num_steps - plan->sections[i].first_step;
+	if (DEBUG) printf("%s: section %d, %d hops composed into %d steps\n", __func__,
+			  i, num_hops, plan->sections[i].num_steps);
+    }
+
+    if (i < hops[0]->num_sections) {
+	transfer_plan_free(plan);
+	return NULL;
+    }
+    return plan;
+}
@@ -1,6 +1,6 @@
 ///@file
 ///@brief	Copy symbol data between different lists
-///@copyright	Copyright (C) 2014  Andre Colomb
+///@copyright	Copyright (C) 2014, 2026  Andre Colomb
 ///
 /// This file is part of elf-mangle.
 ///
@@ -24,9 +24,15 @@
 #ifndef TRANSFORM_H_
 #define TRANSFORM_H_
 
+#include <stddef.h>
+
 
 // Forward declaration
 typedef struct nvm_symbol nvm_symbol;
+typedef struct symbol_index symbol_index;
+
+/// Opaque type of a compiled list of copy operations between two layouts
+typedef struct transfer_plan transfer_plan;
 
 
 ///@brief Copy data for each symbol in destination list from corresponding symbol in source list
@@ -34,8 +40,121 @@ typedef struct nvm_symbol nvm_symbol;
 void transfer_fields(
     const nvm_symbol *list_src,	///< [in] Source list of symbols to copy from
     int num_src,		///< [in] Number of symbols in source list
+    const symbol_index *index_src,	///< [in] Index of the source list or NULL
     const nvm_symbol *list_dst,	///< [in] Destination list of symbols to copy to
     int num_dst			///< [in] Number of symbols in destination list
 );
 
+///@brief Create an empty migration plan
+///@return Address of the new plan or NULL on error
+transfer_plan* transfer_plan_new(void);
+
+///@brief Compile the transfer of one section into a migration plan
+///@details Each destination symbol is matched with its source symbol once,
+///         as in transfer_fields().  Verbatim copies of adjacent fields are
+///         merged into single byte ranges, while fields with a custom copy
+///         function remain separate steps.  Fields missing from the source
+///         are reported when applying the plan.
+///@return Index of the added section or negative error code
+int transfer_plan_add_section(
+    transfer_plan *plan,	///< [in,out] Plan to extend
+    const nvm_symbol *list_src,	///< [in] Source list of symbols to copy from
+    int num_src,		///< [in] Number of symbols in source list
+    const symbol_index *index_src,	///< [in] Index of the source list or NULL
+    size_t size_src,		///< [in] Size of the source section blob
+    const nvm_symbol *list_dst,	///< [in] Destination list of symbols to copy to
+    int num_dst,		///< [in] Number of symbols in destination list
+    size_t size_dst		///< [in] Size of the destination section blob
+);
+
+///@brief Add the migration of one section between identical layouts to a plan
+///@details Used when both layouts have equal fingerprints and all fields are
+///         copied verbatim.  No symbols need to be matched, the byte ranges
+///         covered by any symbol are copied in place.  When the symbols cover
+///         the whole blob, this collapses into a single copy.
+///@see symbol_map_fingerprint(), symbol_map_plain_copy()
+///@return Index of the added section or negative error code
+int transfer_plan_add_identity(
+    transfer_plan *plan,	///< [in,out] Plan to extend
+    const nvm_symbol *list,	///< [in] List of symbols in either layout
+    int num_symbols,		///< [in] Number of symbols in the list
+    size_t size			///< [in] Size of the section blob in both layouts
+);
+
+///@brief Check how many sections a migration plan covers
+///@return Number of sections or zero on error
+int transfer_plan_sections(
+    const transfer_plan *plan	///< [in] Compiled migration plan
+);
+
+///@brief Check how many blobs per section a migration plan works on
+///@return Two for a single hop, one more for each intermediate layout
+int transfer_plan_buffers(
+    const transfer_plan *plan	///< [in] Compiled migration plan
+);
+
+///@brief Check whether a plan fits the given section blob sizes
+///@return Non-zero if the sizes match those the section was compiled for
+int transfer_plan_matches(
+    const transfer_plan *plan,	///< [in] Compiled migration plan
+    int section,		///< [in] Section index within the plan
+    size_t size_src,		///< [in] Size of the source section blob
+    size_t size_dst		///< [in] Size of the destination section blob
+);
+
+///@brief Copy data for one section according to a migration plan
+///@return Zero on success or negative error code if the blob sizes do not match
+int transfer_plan_apply(
+    const transfer_plan *plan,	///< [in] Compiled migration plan
+    int section,		///< [in] Section index within the plan
+    const char *blob_src,	///< [in] Source section blob
+    size_t size_src,		///< [in] Size of the source section blob
+    char *blob_dst,		///< [in,out] Destination section blob
+    size_t size_dst		///< [in] Size of the destination section blob
+);
+
+///@brief Copy data for one section along a chain of layouts
+///@details Intermediate blobs are used as scratch space where custom copy
+///         functions need their actual content, so they must hold the
+///         intermediate layouts' default data and are modified.
+///@return Zero on success or negative error code if the blob sizes do not match
+int transfer_plan_apply_chain(
+    const transfer_plan *plan,	///< [in] Compiled or composed migration plan
+    int section,		///< [in] Section index within the plan
+    char *const blobs[],	///< [in,out] Section blobs from source to final destination
+    const size_t sizes[]	///< [in] Sizes of the section blobs
+);
+
+///@brief Compose consecutive single hop plans into one migration chain
+///@details Data not touched by custom copy functions is copied directly from
+///         its origin to the final destination.  Custom copy functions and
+///         missing field reports still happen in the order of the hops.
+///@note The hop plans must be kept until the composed plan is released.
+///@return Address of the composed plan or NULL on error
+transfer_plan* transfer_plan_compose(
+    transfer_plan *const hops[],///< [in] Plans for each hop, in order
+    int num_hops		///< [in] Number of hops
+);
+
+///@brief Store a migration plan in a file
+///@details The file is replaced atomically.  Custom copy steps refer to their
+///         fields by name, so the plan is only valid for the same known fields.
+///         Composed plans cannot be stored.
+///@return Zero on success or negative error code
+int transfer_plan_write(
+    const transfer_plan *plan,	///< [in] Compiled migration plan
+    const char *filename	///< [in] Output file path
+);
+
+///@brief Load a migration plan from a file
+///@return Address of the loaded plan or NULL if missing, invalid or outdated
+transfer_plan* transfer_plan_read(
+    const char *filename	///< [in] Input file path
+);
+
+///@brief Release all memory of a migration plan
+void transfer_plan_free(
+    transfer_plan *plan		///< [in] Plan to release, may be NULL
+);
+
 #endif //TRANSFORM_H_